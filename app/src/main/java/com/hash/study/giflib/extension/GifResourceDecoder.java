@@ -28,8 +28,8 @@ public class GifResourceDecoder implements ResourceDecoder<InputStream, FrameSeq
     GifResourceDecoder(final BitmapPool bitmapPool) {
         this.mProvider = new FrameSequenceDrawable.BitmapProvider() {
             @Override
-            public Bitmap acquireBitmap(int minWidth, int minHeight) {
-                return bitmapPool.getDirty(minWidth, minHeight, Bitmap.Config.ARGB_8888);
+            public Bitmap acquireBitmap(int minWidth, int minHeight, Bitmap.Config config) {
+                return bitmapPool.getDirty(minWidth, minHeight, config);
             }
 
             @Override
@@ -53,28 +53,39 @@ public class GifResourceDecoder implements ResourceDecoder<InputStream, FrameSeq
         if (decoder == null) {
             return null;
         }
-        int inSampleSize = calcSampleSize(decoder.getWidth(), decoder.getHeight(), width, height);
-        FrameSequenceDrawable drawable = new FrameSequenceDrawable(decoder, mProvider, inSampleSize);
+        float scale = calcScale(decoder.getWidth(), decoder.getHeight(), width, height);
+        FrameSequenceDrawable drawable;
+        if (scale < 1) {
+            // 按目标尺寸缩放, 不再限于 2 的幂次采样
+            int scaledWidth = Math.max(1, Math.round(decoder.getWidth() * scale));
+            int scaledHeight = Math.max(1, Math.round(decoder.getHeight() * scale));
+            drawable = new FrameSequenceDrawable(decoder, mProvider, scaledWidth, scaledHeight);
+        } else {
+            drawable = new FrameSequenceDrawable(decoder, mProvider, 1);
+        }
         // 圆形Gif显示开关
         drawable.setCircleMaskEnabled(false);
         return new GifDrawableResource(drawable);
     }
 
-    private int calcSampleSize(int sourceWidth, int sourceHeight, int requestedWidth, int requestedHeight) {
-        int exactSampleSize = Math.min(sourceWidth / requestedWidth,
-                sourceHeight / requestedHeight);
-        int powerOfTwoSampleSize = exactSampleSize == 0 ? 0 : Integer.highestOneBit(exactSampleSize);
-        // Although functionally equivalent to 0 for BitmapFactory, 1 is a safer default for our code
-        // than 0.
-        int sampleSize = Math.max(1, powerOfTwoSampleSize);
+    /**
+     * 缩放后两边都不小于目标尺寸的最小比例, 与之前的采样规则一样铺满目标, centerCrop 时不会再被放大;
+     * 目标尺寸无效 (如 Target.SIZE_ORIGINAL) 或不小于原图时为 1
+     */
+    private float calcScale(int sourceWidth, int sourceHeight, int requestedWidth, int requestedHeight) {
+        float scale = 1;
+        if (requestedWidth > 0 && requestedHeight > 0) {
+            scale = Math.min(1f, Math.max((float) requestedWidth / sourceWidth,
+                    (float) requestedHeight / sourceHeight));
+        }
         if (BuildConfig.DEBUG) {
             Log.i(TAG, "Downsampling GIF"
-                    + ", sampleSize: " + sampleSize
+                    + ", scale: " + scale
                     + ", target dimens: [" + requestedWidth + "x" + requestedHeight + "]"
                     + ", actual dimens: [" + sourceWidth + "x" + sourceHeight + "]"
             );
         }
-        return sampleSize;
+        return scale;
     }
 
     /**
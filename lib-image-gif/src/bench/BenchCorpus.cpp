@@ -0,0 +1,183 @@
+#include "BenchCorpus.h"
+
+#include "giflib/gif_lib.h"
+
+const std::vector<CorpusSpec> &getCorpusSpecs() {
+    static const std::vector<CorpusSpec> specs = {
+            // name                 width height frames colors interlaced local  transp subRects disposal
+            {"small_opaque",        64,   64,    24,    16,    false,     false, false, false,   DISPOSE_DO_NOT},
+            {"sticker_transparent", 240,  240,   48,    64,    false,     false, true,  true,    -1},
+            {"screen_interlaced",   480,  270,   12,    256,   true,      false, false, false,   DISPOSE_DO_NOT},
+            {"local_palettes",      320,  240,   24,    256,   false,     true,  false, true,    DISPOSE_DO_NOT},
+            {"dispose_background",  320,  320,   30,    32,    false,     false, true,  true,    DISPOSE_BACKGROUND},
+            {"dispose_previous",    320,  320,   30,    32,    false,     false, true,  true,    DISPOSE_PREVIOUS},
+            {"long_animation",      200,  200,   150,   128,   false,     false, true,  true,    -1},
+            {"large_mixed",         1024, 768,   8,     256,   true,      true,  true,  true,    -1},
+    };
+    return specs;
+}
+
+namespace {
+
+    // xorshift32, 固定种子保证语料可复现
+    class Random {
+    public:
+        explicit Random(uint32_t seed) : mState(seed ? seed : 1) {}
+
+        uint32_t next() {
+            mState ^= mState << 13;
+            mState ^= mState >> 17;
+            mState ^= mState << 5;
+            return mState;
+        }
+
+        int nextInt(int bound) {
+            return (int) (next() % (uint32_t) bound);
+        }
+
+    private:
+        uint32_t mState;
+    };
+
+    int writeToVector(GifFileType *gif, const GifByteType *buffer, int size) {
+        std::vector<uint8_t> *out = (std::vector<uint8_t> *) gif->UserData;
+        out->insert(out->end(), buffer, buffer + size);
+        return size;
+    }
+
+    ColorMapObject *makeColorMap(int colorCount, Random &random) {
+        GifColorType colors[256];
+        int r = random.nextInt(256), g = random.nextInt(256), b = random.nextInt(256);
+        for (int i = 0; i < colorCount; i++) {
+            colors[i].Red = (GifByteType) (r + i * 7);
+            colors[i].Green = (GifByteType) (g + i * 13);
+            colors[i].Blue = (GifByteType) (b + i * 29);
+        }
+        return GifMakeMapObject(colorCount, colors);
+    }
+
+    // 平滑的渐变背景, 一块噪声区域, 透明帧中按棋盘格挖空
+    void fillRaster(std::vector<GifPixelType> &raster, const GifImageDesc &desc,
+                    const CorpusSpec &spec, int frameNr, int transparentColor, Random &random) {
+        const int noiseLeft = random.nextInt(desc.Width);
+        const int noiseTop = random.nextInt(desc.Height);
+        const int noiseSize = desc.Width / 4 + 1;
+        for (int y = 0; y < desc.Height; y++) {
+            for (int x = 0; x < desc.Width; x++) {
+                int color;
+                if (x >= noiseLeft && x < noiseLeft + noiseSize
+                    && y >= noiseTop && y < noiseTop + noiseSize) {
+                    color = random.nextInt(spec.colorCount);
+                } else {
+                    color = ((desc.Left + x + desc.Top + y) / 4 + frameNr * 3) % spec.colorCount;
+                }
+                if (transparentColor != NO_TRANSPARENT_COLOR && ((x / 8 + y / 8) % 3) == 0) {
+                    color = transparentColor;
+                }
+                raster[y * desc.Width + x] = (GifPixelType) color;
+            }
+        }
+    }
+
+    bool putRaster(GifFileType *gif, std::vector<GifPixelType> &raster,
+                   const GifImageDesc &desc) {
+        if (!desc.Interlace) {
+            for (int y = 0; y < desc.Height; y++) {
+                if (EGifPutLine(gif, &raster[y * desc.Width], desc.Width) == GIF_ERROR) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        static const int kInterlacedOffset[] = {0, 4, 2, 1};
+        static const int kInterlacedJumps[] = {8, 8, 4, 2};
+        for (int pass = 0; pass < 4; pass++) {
+            for (int y = kInterlacedOffset[pass]; y < desc.Height; y += kInterlacedJumps[pass]) {
+                if (EGifPutLine(gif, &raster[y * desc.Width], desc.Width) == GIF_ERROR) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    bool writeGif(GifFileType *gif, const CorpusSpec &spec, Random &random) {
+        static const int kDisposalCycle[] = {DISPOSE_DO_NOT, DISPOSE_BACKGROUND,
+                                             DISPOSE_PREVIOUS};
+
+        ColorMapObject *globalMap = makeColorMap(spec.colorCount, random);
+        if (!globalMap) {
+            return false;
+        }
+        EGifSetGifVersion(gif, true);
+        bool ok = EGifPutScreenDesc(gif, spec.width, spec.height, 8, 0, globalMap) != GIF_ERROR;
+        GifFreeMapObject(globalMap);
+
+        // 无限循环
+        GifByteType netscape[] = "NETSCAPE2.0";
+        GifByteType loop[] = {1, 0, 0};
+        ok = ok && EGifPutExtensionLeader(gif, APPLICATION_EXT_FUNC_CODE) != GIF_ERROR
+             && EGifPutExtensionBlock(gif, 11, netscape) != GIF_ERROR
+             && EGifPutExtensionBlock(gif, sizeof(loop), loop) != GIF_ERROR
+             && EGifPutExtensionTrailer(gif) != GIF_ERROR;
+
+        std::vector<GifPixelType> raster;
+        for (int i = 0; ok && i < spec.frameCount; i++) {
+            GraphicsControlBlock gcb;
+            gcb.DisposalMode = spec.disposalMode >= 0 ? spec.disposalMode : kDisposalCycle[i % 3];
+            gcb.UserInputFlag = false;
+            gcb.DelayTime = 4;
+            gcb.TransparentColor = spec.transparency && i % 2 ? spec.colorCount - 1
+                                                               : NO_TRANSPARENT_COLOR;
+            GifByteType extension[4];
+            size_t extensionLength = EGifGCBToExtension(&gcb, extension);
+            ok = EGifPutExtension(gif, GRAPHICS_EXT_FUNC_CODE, (int) extensionLength,
+                                  extension) != GIF_ERROR;
+
+            GifImageDesc desc = {0, 0, spec.width, spec.height, spec.interlaced, NULL};
+            if (spec.subRects && i % 6 != 0) {
+                desc.Width = spec.width / 4 + random.nextInt(spec.width / 2);
+                desc.Height = spec.height / 4 + random.nextInt(spec.height / 2);
+                desc.Left = random.nextInt(spec.width - desc.Width + 1);
+                desc.Top = random.nextInt(spec.height - desc.Height + 1);
+            }
+            ColorMapObject *localMap = NULL;
+            if (spec.localPalettes && i % 2) {
+                localMap = makeColorMap(spec.colorCount, random);
+                ok = ok && localMap;
+            }
+            ok = ok && EGifPutImageDesc(gif, desc.Left, desc.Top, desc.Width, desc.Height,
+                                        desc.Interlace, localMap) != GIF_ERROR;
+            GifFreeMapObject(localMap);
+
+            raster.resize((size_t) desc.Width * desc.Height);
+            fillRaster(raster, desc, spec, i, gcb.TransparentColor, random);
+            ok = ok && putRaster(gif, raster, desc);
+        }
+        return ok;
+    }
+
+}
+
+CorpusEntry generateCorpusEntry(const CorpusSpec &spec) {
+    CorpusEntry entry;
+    entry.spec = spec;
+
+    uint32_t seed = 2166136261u;
+    for (const char *c = spec.name; *c; c++) {
+        seed = (seed ^ (uint8_t) *c) * 16777619u;
+    }
+    Random random(seed);
+
+    int error;
+    GifFileType *gif = EGifOpen(&entry.data, writeToVector, &error);
+    if (!gif) {
+        entry.data.clear();
+        return entry;
+    }
+    bool ok = writeGif(gif, spec, random);
+    if (EGifCloseFile(gif, &error) == GIF_ERROR || !ok) {
+        entry.data.clear();
+    }
+    return entry;
+}
@@ -0,0 +1,38 @@
+/**
+ * 基准测试使用的 GIF 语料, 由 egif_lib 按固定种子生成, 每次运行内容完全相同.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct CorpusSpec {
+    const char *name;
+    int width;
+    int height;
+    int frameCount;
+    // 调色板颜色数, 2 的幂
+    int colorCount;
+    bool interlaced;
+    // 奇数帧使用局部色表
+    bool localPalettes;
+    // 部分帧带透明色
+    bool transparency;
+    // 除关键位置外的帧只覆盖画布的一部分
+    bool subRects;
+    // 所有帧的处置方式, -1 表示依次轮换 DISPOSE_DO_NOT / BACKGROUND / PREVIOUS
+    int disposalMode;
+};
+
+struct CorpusEntry {
+    CorpusSpec spec;
+    std::vector<uint8_t> data;
+};
+
+// 内置语料的描述
+const std::vector<CorpusSpec> &getCorpusSpecs();
+
+// 生成一个 GIF, 失败时 data 为空
+CorpusEntry generateCorpusEntry(const CorpusSpec &spec);
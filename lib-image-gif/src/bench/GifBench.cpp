@@ -0,0 +1,567 @@
+/**
+ * 解码基准测试: 在内置语料上测量打开, DGifSlurp, 各采样率下逐帧 drawFrame 和整轮播放的耗时,
+ * 以及峰值 RSS. 结果以 JSON 输出, 便于按提交跟踪回归.
+ *
+ * gifbench [--repetitions=N] [--filter=name] [--out=file.json] [--dump-corpus=dir]
+ *          [--lzw=table|classic] [--kernel=scalar|sse41|avx2|neon] [--budget=bytes]
+ *          [--storage=decoded|lazy|compressed] [--composite=buffered|direct]
+ *          [--sampling=point|box] [--scale=f] [--format=8888|565|a8] [--threads=N]
+ *          [--decode-threads=N] [--prefetch=N]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BenchCorpus.h"
+#include "Compositor.h"
+#include "DecoderPool.h"
+#include "GifDecoder.h"
+#include "WorkerPool.h"
+#include "utils/log.h"
+
+namespace {
+
+    const int kSampleSizes[] = {1, 2, 4};
+
+    struct BenchOptions {
+        int repetitions = 5;
+        std::string filter;
+        std::string outPath;
+        std::string corpusDir;
+        int lzwEngine = GIF_LZW_TABLE;
+        long memoryBudgetBytes = 0;
+        // 帧像素的保存方式, 对应 DecodeOptions 的 lazyDecode 和 compressedFrames
+        std::string storage = "decoded";
+        // lazy 和 compressed 模式下是否逐行解压直接合成, 对应 DecodeOptions.directComposite
+        bool directComposite = false;
+        // inSampleSize 大于 1 时的采样方式, 对应 DecodeOptions.boxFilter
+        bool boxFilter = false;
+        // 大于 0 时另外测量 drawScaledFrame 缩放到原尺寸的 scale 倍
+        double scale = 0;
+        // drawFrame 输出的像素格式
+        PixelFormat format = PIXEL_FORMAT_8888;
+        // 分带合成的线程数, 对应 DecodeOptions.compositeThreads
+        int compositeThreads = 1;
+        // 打开时解压所有帧的线程数, 对应 DecodeOptions.decodeThreads
+        int decodeThreads = 1;
+        // 大于 0 时另外测量 startPrefetch 预取 N 帧后 takeNextFrame 的耗时
+        int prefetch = 0;
+    };
+
+    struct DrawResult {
+        // drawScaledFrame 和预取时为 0
+        int sampleSize;
+        // 预取的帧数, 其他时候为 0
+        int prefetch;
+        int width;
+        int height;
+        double frameUsP50;
+        double frameUsP95;
+        double frameUsMax;
+        double loopUs;
+    };
+
+    struct BenchResult {
+        CorpusSpec spec;
+        size_t bytes;
+        double openUs;
+        double slurpUs;
+        std::vector<DrawResult> draws;
+        // 播放结束时解码器持有的内存
+        MemoryUsage memory;
+        long peakRssKb;
+    };
+
+    typedef std::chrono::steady_clock Clock;
+
+    double elapsedUs(Clock::time_point start) {
+        return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    }
+
+    double percentile(std::vector<double> values, double p) {
+        if (values.empty()) {
+            return 0;
+        }
+        std::sort(values.begin(), values.end());
+        size_t index = (size_t) (p * (values.size() - 1) + 0.5);
+        return values[index];
+    }
+
+    // 重置 VmHWM, 使每个语料的峰值 RSS 单独统计; 内核不支持时返回 false
+    bool resetPeakRss() {
+        FILE *file = fopen("/proc/self/clear_refs", "w");
+        if (!file) {
+            return false;
+        }
+        bool ok = fputs("5", file) >= 0;
+        return fclose(file) == 0 && ok;
+    }
+
+    long readPeakRssKb() {
+        FILE *file = fopen("/proc/self/status", "r");
+        if (file) {
+            char line[256];
+            long kb = -1;
+            while (fgets(line, sizeof(line), file)) {
+                if (sscanf(line, "VmHWM: %ld kB", &kb) == 1) {
+                    break;
+                }
+            }
+            fclose(file);
+            if (kb >= 0) {
+                return kb;
+            }
+        }
+        return -1;
+    }
+
+    // 进程启动以来的峰值 RSS, 不受 resetPeakRss 影响
+    long readProcessPeakRssKb() {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    struct MemorySource {
+        const uint8_t *data;
+        size_t size;
+        size_t position;
+    };
+
+    int readMemory(GifFileType *gif, GifByteType *out, int size) {
+        MemorySource *source = (MemorySource *) gif->UserData;
+        size_t count = std::min((size_t) size, source->size - source->position);
+        memcpy(out, source->data + source->position, count);
+        source->position += count;
+        return (int) count;
+    }
+
+    double benchOpen(const CorpusEntry &entry, const DecodeOptions &options) {
+        MemoryStream stream((void *) entry.data.data(), entry.data.size(), NULL);
+        Clock::time_point start = Clock::now();
+        GifDecoder decoder(&stream, options);
+        return decoder.hasInit() ? elapsedUs(start) : -1;
+    }
+
+    double benchSlurp(const CorpusEntry &entry, int lzwEngine) {
+        MemorySource source = {entry.data.data(), entry.data.size(), 0};
+        Clock::time_point start = Clock::now();
+        int error;
+        GifFileType *gif = DGifOpen(&source, readMemory, &error);
+        if (!gif) {
+            return -1;
+        }
+        DGifSetLZWEngine(gif, lzwEngine);
+        bool ok = DGifSlurp(gif) == GIF_OK;
+        DGifCloseFile(gif, &error);
+        return ok ? elapsedUs(start) : -1;
+    }
+
+    // 按顺序播放 repetitions 轮, 每一帧都在上一帧的基础上合成.
+    // sampleSize 为 0 时用 drawScaledFrame 输出 width x height, 否则忽略 width 和 height
+    DrawResult benchDraw(GifDecoder &decoder, int sampleSize, int width, int height,
+                         PixelFormat format, int repetitions) {
+        if (sampleSize > 0) {
+            width = decoder.getWidth() / sampleSize;
+            height = decoder.getHeight() / sampleSize;
+        }
+        const int frameCount = decoder.getFrameCount();
+        std::vector<uint8_t> canvas((size_t) width * height * getBytesPerPixel(format));
+        std::vector<double> frameUs;
+        std::vector<double> loopUs;
+        for (int r = 0; r < repetitions; r++) {
+            double loop = 0;
+            for (int i = 0; i < frameCount; i++) {
+                Clock::time_point start = Clock::now();
+                if (sampleSize > 0) {
+                    decoder.drawFrame(i, canvas.data(), format, width, i - 1, sampleSize);
+                } else {
+                    decoder.drawScaledFrame(i, canvas.data(), format, width, width, height,
+                                            i - 1);
+                }
+                double us = elapsedUs(start);
+                frameUs.push_back(us);
+                loop += us;
+            }
+            loopUs.push_back(loop);
+        }
+        DrawResult result;
+        result.sampleSize = sampleSize;
+        result.prefetch = 0;
+        result.width = width;
+        result.height = height;
+        result.frameUsP50 = percentile(frameUs, 0.5);
+        result.frameUsP95 = percentile(frameUs, 0.95);
+        result.frameUsMax = percentile(frameUs, 1);
+        result.loopUs = percentile(loopUs, 0.5);
+        return result;
+    }
+
+    // 预取 ringSize 帧, 按顺序取出 repetitions 轮. frame_us 为帧已就绪时 takeNextFrame 的耗时,
+    // 即播放线程的开销; loop_us 为连续取出一轮 (含等待合成) 的耗时, 即预取线程的吞吐
+    DrawResult benchPrefetch(GifDecoder &decoder, int ringSize, PixelFormat format,
+                             int repetitions) {
+        const int width = decoder.getWidth(), height = decoder.getHeight();
+        const int frameCount = decoder.getFrameCount();
+        std::vector<uint8_t> canvas((size_t) width * height * getBytesPerPixel(format));
+        std::vector<double> frameUs;
+        std::vector<double> loopUs;
+        PrefetchOptions prefetchOptions = {ringSize, 0, format, 1, 0, 0};
+        const bool started = decoder.startPrefetch(prefetchOptions);
+        for (int r = 0; started && r < repetitions; r++) {
+            Clock::time_point loopStart = Clock::now();
+            for (int i = 0; i < frameCount; i++) {
+                while (true) {
+                    Clock::time_point start = Clock::now();
+                    if (decoder.takeNextFrame(canvas.data(), format, width, width, height,
+                                              NULL) >= 0) {
+                        frameUs.push_back(elapsedUs(start));
+                        break;
+                    }
+                    std::this_thread::yield();
+                }
+            }
+            loopUs.push_back(elapsedUs(loopStart));
+        }
+        decoder.stopPrefetch();
+        DrawResult result;
+        result.sampleSize = 0;
+        result.prefetch = ringSize;
+        result.width = width;
+        result.height = height;
+        result.frameUsP50 = percentile(frameUs, 0.5);
+        result.frameUsP95 = percentile(frameUs, 0.95);
+        result.frameUsMax = percentile(frameUs, 1);
+        result.loopUs = percentile(loopUs, 0.5);
+        return result;
+    }
+
+    bool runEntry(const CorpusEntry &entry, const BenchOptions &options, BenchResult &result) {
+        DecodeOptions decodeOptions;
+        decodeOptions.lzwEngine = options.lzwEngine;
+        decodeOptions.memoryBudgetBytes = options.memoryBudgetBytes;
+        decodeOptions.lazyDecode = options.storage == "lazy";
+        decodeOptions.compressedFrames = options.storage == "compressed";
+        decodeOptions.directComposite = options.directComposite;
+        decodeOptions.boxFilter = options.boxFilter;
+        decodeOptions.compositeThreads = options.compositeThreads;
+        decodeOptions.decodeThreads = options.decodeThreads;
+
+        result.spec = entry.spec;
+        result.bytes = entry.data.size();
+        bool peakRssIsolated = resetPeakRss();
+
+        std::vector<double> openUs, slurpUs;
+        for (int r = 0; r < options.repetitions; r++) {
+            openUs.push_back(benchOpen(entry, decodeOptions));
+            slurpUs.push_back(benchSlurp(entry, options.lzwEngine));
+            if (openUs.back() < 0 || slurpUs.back() < 0) {
+                return false;
+            }
+        }
+        result.openUs = percentile(openUs, 0.5);
+        result.slurpUs = percentile(slurpUs, 0.5);
+
+        MemoryStream stream((void *) entry.data.data(), entry.data.size(), NULL);
+        GifDecoder decoder(&stream, decodeOptions);
+        if (!decoder.hasInit()) {
+            return false;
+        }
+        for (size_t i = 0; i < sizeof(kSampleSizes) / sizeof(kSampleSizes[0]); i++) {
+            if (decoder.getWidth() / kSampleSizes[i] > 0
+                && decoder.getHeight() / kSampleSizes[i] > 0) {
+                result.draws.push_back(benchDraw(decoder, kSampleSizes[i], 0, 0,
+                                                 options.format, options.repetitions));
+            }
+        }
+        const int scaledWidth = (int) (decoder.getWidth() * options.scale);
+        const int scaledHeight = (int) (decoder.getHeight() * options.scale);
+        if (scaledWidth > 0 && scaledHeight > 0) {
+            result.draws.push_back(benchDraw(decoder, 0, scaledWidth, scaledHeight,
+                                             options.format, options.repetitions));
+        }
+        if (options.prefetch > 0) {
+            result.draws.push_back(benchPrefetch(decoder, options.prefetch, options.format,
+                                                 options.repetitions));
+        }
+        result.memory = decoder.getMemoryUsage();
+        result.peakRssKb = peakRssIsolated ? readPeakRssKb() : -1;
+        return true;
+    }
+
+    const char *kernelName(CompositeKernel kernel) {
+        switch (kernel) {
+            case COMPOSITE_SSE41:
+                return "sse41";
+            case COMPOSITE_AVX2:
+                return "avx2";
+            case COMPOSITE_NEON:
+                return "neon";
+            default:
+                return "scalar";
+        }
+    }
+
+    const char *formatName(PixelFormat format) {
+        switch (format) {
+            case PIXEL_FORMAT_565:
+                return "565";
+            case PIXEL_FORMAT_A8:
+                return "a8";
+            default:
+                return "8888";
+        }
+    }
+
+    void writeJson(FILE *out, const BenchOptions &options,
+                   const std::vector<BenchResult> &results) {
+        fprintf(out, "{\n");
+        fprintf(out, "  \"context\": {\n");
+        fprintf(out, "    \"compositor\": \"%s\",\n", kernelName(getCompositeKernel()));
+        fprintf(out, "    \"lzw_engine\": \"%s\",\n",
+                options.lzwEngine == GIF_LZW_CLASSIC ? "classic" : "table");
+        fprintf(out, "    \"repetitions\": %d,\n", options.repetitions);
+        fprintf(out, "    \"memory_budget_bytes\": %ld,\n", options.memoryBudgetBytes);
+        fprintf(out, "    \"storage\": \"%s\",\n", options.storage.c_str());
+        fprintf(out, "    \"composite\": \"%s\",\n",
+                options.directComposite ? "direct" : "buffered");
+        fprintf(out, "    \"sampling\": \"%s\",\n", options.boxFilter ? "box" : "point");
+        fprintf(out, "    \"format\": \"%s\",\n", formatName(options.format));
+        fprintf(out, "    \"composite_threads\": %d,\n", options.compositeThreads);
+        fprintf(out, "    \"decode_threads\": %d,\n", options.decodeThreads);
+        fprintf(out, "    \"cpu_count\": %d,\n", WorkerPool::getCpuCount());
+        fprintf(out, "    \"process_peak_rss_kb\": %ld,\n", readProcessPeakRssKb());
+        // 整个运行期间解码器池避免的分配次数
+        DecoderPoolStats pool = DecoderPool::get().getStats();
+        fprintf(out, "    \"pool\": {\"state_allocs\": %ld, \"state_reuses\": %ld, "
+                     "\"buffer_allocs\": %ld, \"buffer_reuses\": %ld, "
+                     "\"retained_bytes\": %zu}\n",
+                pool.stateAllocs, pool.stateReuses, pool.bufferAllocs, pool.bufferReuses,
+                pool.retainedBytes);
+        fprintf(out, "  },\n");
+        fprintf(out, "  \"benchmarks\": [");
+        for (size_t i = 0; i < results.size(); i++) {
+            const BenchResult &result = results[i];
+            fprintf(out, "%s\n    {\n", i ? "," : "");
+            fprintf(out, "      \"name\": \"%s\",\n", result.spec.name);
+            fprintf(out, "      \"width\": %d,\n", result.spec.width);
+            fprintf(out, "      \"height\": %d,\n", result.spec.height);
+            fprintf(out, "      \"frames\": %d,\n", result.spec.frameCount);
+            fprintf(out, "      \"bytes\": %zu,\n", result.bytes);
+            fprintf(out, "      \"open_us\": %.1f,\n", result.openUs);
+            fprintf(out, "      \"slurp_us\": %.1f,\n", result.slurpUs);
+            fprintf(out, "      \"peak_rss_kb\": %ld,\n", result.peakRssKb);
+            const MemoryUsage &memory = result.memory;
+            fprintf(out, "      \"memory\": {\"rasters\": %zu, \"source_copy\": %zu, "
+                         "\"compressed_frames\": %zu, \"mapped_source\": %zu, \"preserve_buffer\": %zu, "
+                         "\"keyframes\": %zu, \"palette_luts\": %zu, \"metadata\": %zu, "
+                         "\"scaled_canvas\": %zu, \"prefetch\": %zu},\n",
+                    memory.rasters, memory.sourceCopy, memory.compressedFrames,
+                    memory.mappedSource,
+                    memory.preserveBuffer, memory.keyframes, memory.paletteLuts,
+                    memory.metadata, memory.scaledCanvas, memory.prefetch);
+            fprintf(out, "      \"draw\": [");
+            for (size_t j = 0; j < result.draws.size(); j++) {
+                const DrawResult &draw = result.draws[j];
+                fprintf(out, "%s\n        {", j ? "," : "");
+                if (draw.sampleSize > 0) {
+                    fprintf(out, "\"sample_size\": %d, ", draw.sampleSize);
+                } else if (draw.prefetch > 0) {
+                    fprintf(out, "\"prefetch\": %d, ", draw.prefetch);
+                } else {
+                    fprintf(out, "\"scale\": %.3f, \"output\": \"%dx%d\", ", options.scale,
+                            draw.width, draw.height);
+                }
+                fprintf(out, "\"frame_us_p50\": %.2f, \"frame_us_p95\": %.2f, "
+                             "\"frame_us_max\": %.2f, \"loop_us\": %.1f}",
+                        draw.frameUsP50, draw.frameUsP95, draw.frameUsMax, draw.loopUs);
+            }
+            fprintf(out, "\n      ]\n    }");
+        }
+        fprintf(out, "\n  ]\n}\n");
+    }
+
+    // 计时期间不输出解码器日志, 失败由返回值报告
+    void discardLog(int, const char *, const char *, va_list) {
+    }
+
+    bool dumpCorpus(const std::string &dir, const CorpusEntry &entry) {
+        std::string path = dir + "/" + entry.spec.name + ".gif";
+        FILE *file = fopen(path.c_str(), "wb");
+        if (!file) {
+            return false;
+        }
+        bool ok = fwrite(entry.data.data(), 1, entry.data.size(), file) == entry.data.size();
+        return fclose(file) == 0 && ok;
+    }
+
+    bool parseKernel(const char *name) {
+        static const CompositeKernel kKernels[] = {COMPOSITE_SCALAR, COMPOSITE_SSE41,
+                                                   COMPOSITE_AVX2, COMPOSITE_NEON};
+        for (size_t i = 0; i < sizeof(kKernels) / sizeof(kKernels[0]); i++) {
+            if (!strcmp(name, kernelName(kKernels[i]))) {
+                return setCompositeKernel(kKernels[i]);
+            }
+        }
+        return false;
+    }
+
+    bool parseArgs(int argc, char **argv, BenchOptions &options) {
+        for (int i = 1; i < argc; i++) {
+            const char *arg = argv[i];
+            const char *value = strchr(arg, '=');
+            if (!value) {
+                return false;
+            }
+            std::string key(arg, value - arg);
+            value++;
+            if (key == "--repetitions") {
+                options.repetitions = atoi(value);
+                if (options.repetitions <= 0) {
+                    return false;
+                }
+            } else if (key == "--filter") {
+                options.filter = value;
+            } else if (key == "--out") {
+                options.outPath = value;
+            } else if (key == "--dump-corpus") {
+                options.corpusDir = value;
+            } else if (key == "--lzw") {
+                if (!strcmp(value, "table")) {
+                    options.lzwEngine = GIF_LZW_TABLE;
+                } else if (!strcmp(value, "classic")) {
+                    options.lzwEngine = GIF_LZW_CLASSIC;
+                } else {
+                    return false;
+                }
+            } else if (key == "--budget") {
+                options.memoryBudgetBytes = atol(value);
+                if (options.memoryBudgetBytes < 0) {
+                    return false;
+                }
+            } else if (key == "--storage") {
+                options.storage = value;
+                if (options.storage != "decoded" && options.storage != "lazy"
+                    && options.storage != "compressed") {
+                    return false;
+                }
+            } else if (key == "--composite") {
+                if (!strcmp(value, "buffered")) {
+                    options.directComposite = false;
+                } else if (!strcmp(value, "direct")) {
+                    options.directComposite = true;
+                } else {
+                    return false;
+                }
+            } else if (key == "--sampling") {
+                if (!strcmp(value, "point")) {
+                    options.boxFilter = false;
+                } else if (!strcmp(value, "box")) {
+                    options.boxFilter = true;
+                } else {
+                    return false;
+                }
+            } else if (key == "--scale") {
+                options.scale = atof(value);
+                if (options.scale <= 0) {
+                    return false;
+                }
+            } else if (key == "--format") {
+                if (!strcmp(value, "8888")) {
+                    options.format = PIXEL_FORMAT_8888;
+                } else if (!strcmp(value, "565")) {
+                    options.format = PIXEL_FORMAT_565;
+                } else if (!strcmp(value, "a8")) {
+                    options.format = PIXEL_FORMAT_A8;
+                } else {
+                    return false;
+                }
+            } else if (key == "--threads") {
+                options.compositeThreads = atoi(value);
+                if (options.compositeThreads < 0) {
+                    return false;
+                }
+            } else if (key == "--decode-threads") {
+                options.decodeThreads = atoi(value);
+                if (options.decodeThreads < 0) {
+                    return false;
+                }
+            } else if (key == "--prefetch") {
+                options.prefetch = atoi(value);
+                if (options.prefetch < 0) {
+                    return false;
+                }
+            } else if (key == "--kernel") {
+                if (!parseKernel(value)) {
+                    fprintf(stderr, "compositor kernel %s is not supported\n", value);
+                    return false;
+                }
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+}
+
+int main(int argc, char **argv) {
+    BenchOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        fprintf(stderr, "usage: %s [--repetitions=N] [--filter=name] [--out=file.json] "
+                        "[--dump-corpus=dir] [--lzw=table|classic] "
+                        "[--kernel=scalar|sse41|avx2|neon] [--budget=bytes] "
+                        "[--storage=decoded|lazy|compressed] "
+                        "[--composite=buffered|direct] [--sampling=point|box] "
+                        "[--scale=f] [--format=8888|565|a8] [--threads=N] "
+                        "[--decode-threads=N] [--prefetch=N]\n", argv[0]);
+        return 2;
+    }
+
+    gif_set_log_sink(discardLog);
+
+    std::vector<BenchResult> results;
+    const std::vector<CorpusSpec> &specs = getCorpusSpecs();
+    for (size_t i = 0; i < specs.size(); i++) {
+        if (!options.filter.empty() && !strstr(specs[i].name, options.filter.c_str())) {
+            continue;
+        }
+        CorpusEntry entry = generateCorpusEntry(specs[i]);
+        if (entry.data.empty()) {
+            fprintf(stderr, "failed to generate %s\n", specs[i].name);
+            return 1;
+        }
+        if (!options.corpusDir.empty() && !dumpCorpus(options.corpusDir, entry)) {
+            fprintf(stderr, "failed to write %s to %s\n", specs[i].name,
+                    options.corpusDir.c_str());
+            return 1;
+        }
+        BenchResult result;
+        if (!runEntry(entry, options, result)) {
+            fprintf(stderr, "failed to decode %s\n", specs[i].name);
+            return 1;
+        }
+        results.push_back(result);
+    }
+
+    FILE *out = stdout;
+    if (!options.outPath.empty()) {
+        out = fopen(options.outPath.c_str(), "w");
+        if (!out) {
+            fprintf(stderr, "failed to open %s\n", options.outPath.c_str());
+            return 1;
+        }
+    }
+    writeJson(out, options, results);
+    if (out != stdout) {
+        fclose(out);
+    }
+    return 0;
+}
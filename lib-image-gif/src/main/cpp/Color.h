@@ -3,7 +3,9 @@
  * http://androidxref.com/9.0.0_r3/xref/frameworks/ex/framesequence/jni/Color.h#24
  */
 
-#pragma
+#pragma once
+
+#include <stdint.h>
 
 typedef uint32_t Color8888;
 
@@ -11,3 +13,27 @@ static const Color8888 COLOR_8888_ALPHA_MASK = 0xff000000; // TODO: handle endia
 static const Color8888 TRANSPARENT = 0x0;// TODO: handle endianness
 #define ARGB_TO_COLOR8888(a, r, g, b) \
    ((a) << 24 | (b) << 16 | (g) << 8 | (r))
+
+typedef uint16_t Color565;
+
+// drawFrame 输出的像素格式, 依次对应 Android Bitmap 的 ARGB_8888, RGB_565 和 ALPHA_8
+enum PixelFormat {
+    PIXEL_FORMAT_8888,
+    PIXEL_FORMAT_565,
+    PIXEL_FORMAT_A8,
+};
+
+static inline int getBytesPerPixel(PixelFormat format) {
+    return format == PIXEL_FORMAT_8888 ? 4 : format == PIXEL_FORMAT_565 ? 2 : 1;
+}
+
+// 截断低位, 丢弃 alpha; 只用于不透明的画布
+static inline Color565 color8888To565(Color8888 color) {
+    return (Color565) (((color & 0xf8) << 8) | ((color >> 5) & 0x7e0) | ((color >> 19) & 0x1f));
+}
+
+// 高位复制到低位, 再转换回 565 时不变
+static inline Color8888 color565To8888(Color565 color) {
+    const uint32_t r = color >> 11, g = (color >> 5) & 0x3f, b = color & 0x1f;
+    return ARGB_TO_COLOR8888(0xffu, (r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+}
@@ -0,0 +1,777 @@
+#include <string.h>
+#include "Compositor.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define COMPOSITE_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define COMPOSITE_ARM_NEON 1
+#include <arm_neon.h>
+#endif
+
+typedef void (*CompositeLineFunc)(Color8888 *dst, const uint8_t *src, const Color8888 *lut,
+                                  int width);
+
+typedef void (*FillLineFunc)(Color8888 *dst, Color8888 color, int width);
+
+typedef void (*ScaleLineFunc)(Color8888 *dst, const Color8888 *src, const int *starts,
+                              const int16_t *weights, int taps, int width);
+
+typedef void (*BlendLinesFunc)(Color8888 *dst, const Color8888 *const *rows,
+                               const int16_t *weights, int taps, int width);
+
+// 盒式滤波的纵向累加: 一行索引像素经查找表展开后, 按字节通道加到 sums 中每列的 4 个计数上
+typedef void (*AccumulateColumnsFunc)(uint32_t *sums, const uint8_t *src, const Color8888 *lut,
+                                      int width);
+
+// 盒式滤波的横向合并: 每 inSampleSize 列的计数合成一个块, 取平均后叠加到 dst, 块都是完整的
+typedef void (*BlendBlocksFunc)(Color8888 *dst, const uint32_t *sums, int width, int inSampleSize,
+                                uint32_t reciprocal);
+
+// 通道和乘以 blockReciprocal(count) 再右移 BLOCK_SHIFT 位, 即除以 count 并四舍五入.
+// count 不超过 BOX_FILTER_MAX_SAMPLE_SIZE 的平方时结果精确且不会溢出 32 位
+static const int BLOCK_SHIFT = 23;
+
+////////////////////////////////////////////////////////////////////////////////
+// scalar
+////////////////////////////////////////////////////////////////////////////////
+
+static inline void compositePixel(Color8888 *dst, const uint8_t *src, const Color8888 *lut) {
+    Color8888 color = lut[*src];
+    *dst = color != TRANSPARENT ? color : *dst;
+}
+
+static void compositeLineScalar(Color8888 *dst, const uint8_t *src, const Color8888 *lut,
+                                int width) {
+    for (; width > 0; width--, src++, dst++) {
+        compositePixel(dst, src, lut);
+    }
+}
+
+static void fillLineScalar(Color8888 *dst, Color8888 color, int width) {
+    for (; width > 0; width--, dst++) {
+        *dst = color;
+    }
+}
+
+static void accumulateColumnsScalar(uint32_t *sums, const uint8_t *src, const Color8888 *lut,
+                                    int width) {
+    for (; width > 0; width--, src++, sums += 4) {
+        const Color8888 color = lut[*src];
+        sums[0] += color & 0xff;
+        sums[1] += (color >> 8) & 0xff;
+        sums[2] += (color >> 16) & 0xff;
+        sums[3] += color >> 24;
+    }
+}
+
+static inline uint32_t blockReciprocal(int count) {
+    return ((1u << BLOCK_SHIFT) + count / 2) / count;
+}
+
+// 块的平均颜色 (预乘) 叠加到 dst 上
+static inline void blendBlock(Color8888 *dst, Color8888 color) {
+    const uint32_t alpha = color >> 24;
+    if (alpha == 0xff || color == TRANSPARENT) {
+        // 整块不透明时直接覆盖, 整块透明时保留 dst
+        *dst = color != TRANSPARENT ? color : *dst;
+        return;
+    }
+    // src-over: out = src + dst * (255 - alpha) / 255
+    const Color8888 under = *dst;
+    Color8888 result = 0;
+    for (int c = 0; c < 32; c += 8) {
+        const uint32_t value = ((under >> c) & 0xff) * (0xff - alpha) + 128;
+        result |= (((color >> c) & 0xff) + ((value + (value >> 8)) >> 8)) << c;
+    }
+    *dst = result;
+}
+
+// columns 列的计数取平均后叠加到 dst 上
+static inline void blendColumns(Color8888 *dst, const uint32_t *sums, int columns,
+                                uint32_t reciprocal) {
+    uint32_t block[4] = {0, 0, 0, 0};
+    for (; columns > 0; columns--, sums += 4) {
+        block[0] += sums[0];
+        block[1] += sums[1];
+        block[2] += sums[2];
+        block[3] += sums[3];
+    }
+    Color8888 color = 0;
+    for (int c = 0; c < 4; c++) {
+        color |= ((block[c] * reciprocal + (1u << (BLOCK_SHIFT - 1))) >> BLOCK_SHIFT) << (c * 8);
+    }
+    blendBlock(dst, color);
+}
+
+static void blendBlocksScalar(Color8888 *dst, const uint32_t *sums, int width, int inSampleSize,
+                              uint32_t reciprocal) {
+    for (; width > 0; width--, dst++, sums += 4 * inSampleSize) {
+        blendColumns(dst, sums, inSampleSize, reciprocal);
+    }
+}
+
+// 加权和四舍五入后的颜色; 权重非负且和为 1 << SCALE_WEIGHT_BITS, 结果不会超过 255
+static inline Color8888 packWeighted(const uint32_t *sums) {
+    Color8888 color = 0;
+    for (int c = 0; c < 4; c++) {
+        color |= ((sums[c] + (1u << (SCALE_WEIGHT_BITS - 1))) >> SCALE_WEIGHT_BITS) << (c * 8);
+    }
+    return color;
+}
+
+static void scaleLineScalar(Color8888 *dst, const Color8888 *src, const int *starts,
+                            const int16_t *weights, int taps, int width) {
+    for (int x = 0; x < width; x++, weights += taps) {
+        const Color8888 *pixels = src + starts[x];
+        uint32_t sums[4] = {0, 0, 0, 0};
+        for (int t = 0; t < taps; t++) {
+            const uint32_t weight = (uint32_t) weights[t];
+            sums[0] += (pixels[t] & 0xff) * weight;
+            sums[1] += ((pixels[t] >> 8) & 0xff) * weight;
+            sums[2] += ((pixels[t] >> 16) & 0xff) * weight;
+            sums[3] += (pixels[t] >> 24) * weight;
+        }
+        dst[x] = packWeighted(sums);
+    }
+}
+
+// 处理 [from, width) 列, 供 SIMD 实现处理余下的列
+static void blendLinesFrom(Color8888 *dst, const Color8888 *const *rows, const int16_t *weights,
+                           int taps, int from, int width) {
+    for (int x = from; x < width; x++) {
+        uint32_t sums[4] = {0, 0, 0, 0};
+        for (int t = 0; t < taps; t++) {
+            const uint32_t weight = (uint32_t) weights[t];
+            const Color8888 color = rows[t][x];
+            sums[0] += (color & 0xff) * weight;
+            sums[1] += ((color >> 8) & 0xff) * weight;
+            sums[2] += ((color >> 16) & 0xff) * weight;
+            sums[3] += (color >> 24) * weight;
+        }
+        dst[x] = packWeighted(sums);
+    }
+}
+
+static void blendLinesScalar(Color8888 *dst, const Color8888 *const *rows,
+                             const int16_t *weights, int taps, int width) {
+    blendLinesFrom(dst, rows, weights, taps, 0, width);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// x86: SSE4.1 / AVX2, 以 target 属性单独编译, 运行时选择
+////////////////////////////////////////////////////////////////////////////////
+
+#if COMPOSITE_X86
+
+__attribute__((target("sse4.1")))
+static inline __m128i lookup4Sse(const uint8_t *src, const Color8888 *lut) {
+    return _mm_setr_epi32((int) lut[src[0]], (int) lut[src[1]], (int) lut[src[2]],
+                          (int) lut[src[3]]);
+}
+
+__attribute__((target("sse4.1")))
+static inline void store4Sse(Color8888 *dst, __m128i color) {
+    __m128i transparent = _mm_cmpeq_epi32(color, _mm_setzero_si128());
+    // 整组不透明时不必读取 dst
+    if (!_mm_testz_si128(transparent, transparent)) {
+        color = _mm_blendv_epi8(color, _mm_loadu_si128((const __m128i *) dst), transparent);
+    }
+    _mm_storeu_si128((__m128i *) dst, color);
+}
+
+__attribute__((target("sse4.1")))
+static void compositeLineSse41(Color8888 *dst, const uint8_t *src, const Color8888 *lut,
+                               int width) {
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i lo = lookup4Sse(src + x, lut);
+        __m128i hi = lookup4Sse(src + x + 4, lut);
+        store4Sse(dst + x, lo);
+        store4Sse(dst + x + 4, hi);
+    }
+    compositeLineScalar(dst + x, src + x, lut, width - x);
+}
+
+__attribute__((target("sse4.1")))
+static void fillLineSse41(Color8888 *dst, Color8888 color, int width) {
+    __m128i value = _mm_set1_epi32((int) color);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        _mm_storeu_si128((__m128i *) (dst + x), value);
+        _mm_storeu_si128((__m128i *) (dst + x + 4), value);
+    }
+    fillLineScalar(dst + x, color, width - x);
+}
+
+__attribute__((target("sse4.1")))
+static inline void accumulate1Sse(uint32_t *sums, __m128i color) {
+    __m128i *p = (__m128i *) sums;
+    _mm_storeu_si128(p, _mm_add_epi32(_mm_loadu_si128(p), _mm_cvtepu8_epi32(color)));
+}
+
+__attribute__((target("sse4.1")))
+static void accumulateColumnsSse41(uint32_t *sums, const uint8_t *src, const Color8888 *lut,
+                                   int width) {
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i colors = lookup4Sse(src + x, lut);
+        accumulate1Sse(sums + x * 4, colors);
+        accumulate1Sse(sums + x * 4 + 4, _mm_srli_si128(colors, 4));
+        accumulate1Sse(sums + x * 4 + 8, _mm_srli_si128(colors, 8));
+        accumulate1Sse(sums + x * 4 + 12, _mm_srli_si128(colors, 12));
+    }
+    accumulateColumnsScalar(sums + x * 4, src + x, lut, width - x);
+}
+
+__attribute__((target("sse4.1")))
+static void blendBlocksSse41(Color8888 *dst, const uint32_t *sums, int width, int inSampleSize,
+                             uint32_t reciprocal) {
+    const __m128i factor = _mm_set1_epi32((int) reciprocal);
+    const __m128i half = _mm_set1_epi32(1 << (BLOCK_SHIFT - 1));
+    for (; width > 0; width--, dst++) {
+        __m128i block = _mm_loadu_si128((const __m128i *) sums);
+        sums += 4;
+        for (int i = 1; i < inSampleSize; i++, sums += 4) {
+            block = _mm_add_epi32(block, _mm_loadu_si128((const __m128i *) sums));
+        }
+        __m128i average = _mm_srli_epi32(_mm_add_epi32(_mm_mullo_epi32(block, factor), half),
+                                         BLOCK_SHIFT);
+        average = _mm_packus_epi32(average, average);
+        blendBlock(dst, (Color8888) _mm_cvtsi128_si32(_mm_packus_epi16(average, average)));
+    }
+}
+
+// 一个输出像素 4 个通道的加权和 (含舍入偏置). 相邻像素的通道交错为 16 位
+// (p0c0, p1c0, p0c1, p1c1 ...), 与成对的权重做 madd, 每次读入 4 个像素
+__attribute__((target("sse4.1"), always_inline))
+static inline __m128i weightPixelsSse41(const Color8888 *pixels, const int16_t *weights,
+                                        int taps) {
+    const __m128i interleave = _mm_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7,
+                                             8, 12, 9, 13, 10, 14, 11, 15);
+    __m128i sums = _mm_set1_epi32(1 << (SCALE_WEIGHT_BITS - 1));
+    int t = 0;
+    for (; t + 4 <= taps; t += 4) {
+        __m128i quad = _mm_loadu_si128((const __m128i *) (pixels + t));
+        quad = _mm_shuffle_epi8(quad, interleave);
+        int pair0, pair1;
+        memcpy(&pair0, weights + t, sizeof(pair0));
+        memcpy(&pair1, weights + t + 2, sizeof(pair1));
+        sums = _mm_add_epi32(sums, _mm_madd_epi16(_mm_cvtepu8_epi16(quad),
+                                                  _mm_set1_epi32(pair0)));
+        sums = _mm_add_epi32(sums, _mm_madd_epi16(_mm_unpackhi_epi8(quad, _mm_setzero_si128()),
+                                                  _mm_set1_epi32(pair1)));
+    }
+    for (; t + 2 <= taps; t += 2) {
+        __m128i pair = _mm_loadl_epi64((const __m128i *) (pixels + t));
+        pair = _mm_cvtepu8_epi16(_mm_shuffle_epi8(pair, interleave));
+        int weight;
+        memcpy(&weight, weights + t, sizeof(weight));
+        sums = _mm_add_epi32(sums, _mm_madd_epi16(pair, _mm_set1_epi32(weight)));
+    }
+    if (t < taps) {
+        __m128i pixel = _mm_cvtepu8_epi32(_mm_cvtsi32_si128((int) pixels[t]));
+        sums = _mm_add_epi32(sums, _mm_madd_epi16(pixel, _mm_set1_epi32(weights[t])));
+    }
+    return _mm_srli_epi32(sums, SCALE_WEIGHT_BITS);
+}
+
+// 每 4 个输出像素合并为一次写入
+__attribute__((target("sse4.1"), always_inline))
+static inline void scaleLineTapsSse41(Color8888 *dst, const Color8888 *src, const int *starts,
+                                      const int16_t *weights, int taps, int width) {
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i sums[4];
+        for (int i = 0; i < 4; i++) {
+            sums[i] = weightPixelsSse41(src + starts[x + i], weights + (x + i) * taps, taps);
+        }
+        const __m128i packed = _mm_packus_epi16(_mm_packus_epi32(sums[0], sums[1]),
+                                                _mm_packus_epi32(sums[2], sums[3]));
+        _mm_storeu_si128((__m128i *) (dst + x), packed);
+    }
+    for (; x < width; x++) {
+        __m128i sums = weightPixelsSse41(src + starts[x], weights + x * taps, taps);
+        sums = _mm_packus_epi32(sums, sums);
+        dst[x] = (Color8888) _mm_cvtsi128_si32(_mm_packus_epi16(sums, sums));
+    }
+}
+
+// 常见的 2 到 4 个权重展开为常量, 省去逐像素的循环控制
+__attribute__((target("sse4.1")))
+static void scaleLineSse41(Color8888 *dst, const Color8888 *src, const int *starts,
+                           const int16_t *weights, int taps, int width) {
+    switch (taps) {
+        case 2:
+            scaleLineTapsSse41(dst, src, starts, weights, 2, width);
+            break;
+        case 3:
+            scaleLineTapsSse41(dst, src, starts, weights, 3, width);
+            break;
+        case 4:
+            scaleLineTapsSse41(dst, src, starts, weights, 4, width);
+            break;
+        default:
+            scaleLineTapsSse41(dst, src, starts, weights, taps, width);
+            break;
+    }
+}
+
+// 一次处理 4 个像素, 两行的字节交错后与成对的权重做 madd
+__attribute__((target("sse4.1"), always_inline))
+static inline void blendLinesTapsSse41(Color8888 *dst, const Color8888 *const *rows,
+                                       const int16_t *weights, int taps, int width) {
+    const __m128i half = _mm_set1_epi32(1 << (SCALE_WEIGHT_BITS - 1));
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i sums[4] = {half, half, half, half};
+        int t = 0;
+        for (; t + 2 <= taps; t += 2) {
+            const __m128i a = _mm_loadu_si128((const __m128i *) (rows[t] + x));
+            const __m128i b = _mm_loadu_si128((const __m128i *) (rows[t + 1] + x));
+            const __m128i weight = _mm_set1_epi32(
+                    (uint16_t) weights[t] | (int) weights[t + 1] << 16);
+            const __m128i lo = _mm_unpacklo_epi8(a, b);
+            const __m128i hi = _mm_unpackhi_epi8(a, b);
+            sums[0] = _mm_add_epi32(sums[0], _mm_madd_epi16(_mm_cvtepu8_epi16(lo), weight));
+            sums[1] = _mm_add_epi32(sums[1], _mm_madd_epi16(
+                    _mm_cvtepu8_epi16(_mm_srli_si128(lo, 8)), weight));
+            sums[2] = _mm_add_epi32(sums[2], _mm_madd_epi16(_mm_cvtepu8_epi16(hi), weight));
+            sums[3] = _mm_add_epi32(sums[3], _mm_madd_epi16(
+                    _mm_cvtepu8_epi16(_mm_srli_si128(hi, 8)), weight));
+        }
+        if (t < taps) {
+            const __m128i a = _mm_loadu_si128((const __m128i *) (rows[t] + x));
+            const __m128i weight = _mm_set1_epi32(weights[t]);
+            sums[0] = _mm_add_epi32(sums[0], _mm_madd_epi16(_mm_cvtepu8_epi32(a), weight));
+            sums[1] = _mm_add_epi32(sums[1], _mm_madd_epi16(
+                    _mm_cvtepu8_epi32(_mm_srli_si128(a, 4)), weight));
+            sums[2] = _mm_add_epi32(sums[2], _mm_madd_epi16(
+                    _mm_cvtepu8_epi32(_mm_srli_si128(a, 8)), weight));
+            sums[3] = _mm_add_epi32(sums[3], _mm_madd_epi16(
+                    _mm_cvtepu8_epi32(_mm_srli_si128(a, 12)), weight));
+        }
+        for (int i = 0; i < 4; i++) {
+            sums[i] = _mm_srli_epi32(sums[i], SCALE_WEIGHT_BITS);
+        }
+        const __m128i packed = _mm_packus_epi16(_mm_packus_epi32(sums[0], sums[1]),
+                                                _mm_packus_epi32(sums[2], sums[3]));
+        _mm_storeu_si128((__m128i *) (dst + x), packed);
+    }
+    blendLinesFrom(dst, rows, weights, taps, x, width);
+}
+
+__attribute__((target("sse4.1")))
+static void blendLinesSse41(Color8888 *dst, const Color8888 *const *rows,
+                            const int16_t *weights, int taps, int width) {
+    switch (taps) {
+        case 2:
+            blendLinesTapsSse41(dst, rows, weights, 2, width);
+            break;
+        case 3:
+            blendLinesTapsSse41(dst, rows, weights, 3, width);
+            break;
+        case 4:
+            blendLinesTapsSse41(dst, rows, weights, 4, width);
+            break;
+        default:
+            blendLinesTapsSse41(dst, rows, weights, taps, width);
+            break;
+    }
+}
+
+__attribute__((target("avx2")))
+static inline void store8Avx2(Color8888 *dst, __m256i color) {
+    __m256i transparent = _mm256_cmpeq_epi32(color, _mm256_setzero_si256());
+    if (!_mm256_testz_si256(transparent, transparent)) {
+        color = _mm256_blendv_epi8(color, _mm256_loadu_si256((const __m256i *) dst),
+                                   transparent);
+    }
+    _mm256_storeu_si256((__m256i *) dst, color);
+}
+
+__attribute__((target("avx2")))
+static void compositeLineAvx2(Color8888 *dst, const uint8_t *src, const Color8888 *lut,
+                              int width) {
+    const int *table = (const int *) lut;
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i indices = _mm_loadu_si128((const __m128i *) (src + x));
+        __m256i lo = _mm256_i32gather_epi32(table, _mm256_cvtepu8_epi32(indices), 4);
+        __m256i hi = _mm256_i32gather_epi32(table,
+                                            _mm256_cvtepu8_epi32(_mm_srli_si128(indices, 8)), 4);
+        store8Avx2(dst + x, lo);
+        store8Avx2(dst + x + 8, hi);
+    }
+    if (x + 8 <= width) {
+        __m128i indices = _mm_loadl_epi64((const __m128i *) (src + x));
+        store8Avx2(dst + x, _mm256_i32gather_epi32(table, _mm256_cvtepu8_epi32(indices), 4));
+        x += 8;
+    }
+    compositeLineScalar(dst + x, src + x, lut, width - x);
+}
+
+__attribute__((target("avx2")))
+static void fillLineAvx2(Color8888 *dst, Color8888 color, int width) {
+    __m256i value = _mm256_set1_epi32((int) color);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        _mm256_storeu_si256((__m256i *) (dst + x), value);
+        _mm256_storeu_si256((__m256i *) (dst + x + 8), value);
+    }
+    fillLineScalar(dst + x, color, width - x);
+}
+
+// 低 8 字节的两个像素展开为 8 个 32 位通道后累加
+__attribute__((target("avx2")))
+static inline void accumulate2Avx2(uint32_t *sums, __m128i colors) {
+    __m256i *p = (__m256i *) sums;
+    _mm256_storeu_si256(p, _mm256_add_epi32(_mm256_loadu_si256(p), _mm256_cvtepu8_epi32(colors)));
+}
+
+__attribute__((target("avx2")))
+static void accumulateColumnsAvx2(uint32_t *sums, const uint8_t *src, const Color8888 *lut,
+                                  int width) {
+    const int *table = (const int *) lut;
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i indices = _mm_loadl_epi64((const __m128i *) (src + x));
+        __m256i colors = _mm256_i32gather_epi32(table, _mm256_cvtepu8_epi32(indices), 4);
+        __m128i lo = _mm256_castsi256_si128(colors);
+        __m128i hi = _mm256_extracti128_si256(colors, 1);
+        accumulate2Avx2(sums + x * 4, lo);
+        accumulate2Avx2(sums + x * 4 + 8, _mm_srli_si128(lo, 8));
+        accumulate2Avx2(sums + x * 4 + 16, hi);
+        accumulate2Avx2(sums + x * 4 + 24, _mm_srli_si128(hi, 8));
+    }
+    accumulateColumnsScalar(sums + x * 4, src + x, lut, width - x);
+}
+
+#endif // COMPOSITE_X86
+
+////////////////////////////////////////////////////////////////////////////////
+// NEON: 没有 gather, 查表仍逐个进行, 透明色的选择和写入按向量完成
+////////////////////////////////////////////////////////////////////////////////
+
+#if COMPOSITE_ARM_NEON
+
+static inline void store4Neon(Color8888 *dst, const uint8_t *src, const Color8888 *lut) {
+    uint32_t colors[4] = {lut[src[0]], lut[src[1]], lut[src[2]], lut[src[3]]};
+    uint32x4_t color = vld1q_u32(colors);
+    uint32x4_t transparent = vceqq_u32(color, vdupq_n_u32(TRANSPARENT));
+    vst1q_u32(dst, vbslq_u32(transparent, vld1q_u32(dst), color));
+}
+
+static void compositeLineNeon(Color8888 *dst, const uint8_t *src, const Color8888 *lut,
+                              int width) {
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        store4Neon(dst + x, src + x, lut);
+        store4Neon(dst + x + 4, src + x + 4, lut);
+    }
+    compositeLineScalar(dst + x, src + x, lut, width - x);
+}
+
+static void fillLineNeon(Color8888 *dst, Color8888 color, int width) {
+    uint32x4_t value = vdupq_n_u32(color);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        vst1q_u32(dst + x, value);
+        vst1q_u32(dst + x + 4, value);
+    }
+    fillLineScalar(dst + x, color, width - x);
+}
+
+static void accumulateColumnsNeon(uint32_t *sums, const uint8_t *src, const Color8888 *lut,
+                                  int width) {
+    int x = 0;
+    for (; x + 2 <= width; x += 2) {
+        uint32_t colors[2] = {lut[src[x]], lut[src[x + 1]]};
+        uint16x8_t wide = vmovl_u8(vreinterpret_u8_u32(vld1_u32(colors)));
+        uint32_t *p = sums + x * 4;
+        vst1q_u32(p, vaddw_u16(vld1q_u32(p), vget_low_u16(wide)));
+        vst1q_u32(p + 4, vaddw_u16(vld1q_u32(p + 4), vget_high_u16(wide)));
+    }
+    accumulateColumnsScalar(sums + x * 4, src + x, lut, width - x);
+}
+
+static void blendBlocksNeon(Color8888 *dst, const uint32_t *sums, int width, int inSampleSize,
+                            uint32_t reciprocal) {
+    for (; width > 0; width--, dst++) {
+        uint32x4_t block = vld1q_u32(sums);
+        sums += 4;
+        for (int i = 1; i < inSampleSize; i++, sums += 4) {
+            block = vaddq_u32(block, vld1q_u32(sums));
+        }
+        // vrshrq 即加上 2^(BLOCK_SHIFT - 1) 后右移
+        uint16x4_t average = vmovn_u32(vrshrq_n_u32(vmulq_n_u32(block, reciprocal), BLOCK_SHIFT));
+        uint8x8_t packed = vmovn_u16(vcombine_u16(average, average));
+        blendBlock(dst, vget_lane_u32(vreinterpret_u32_u8(packed), 0));
+    }
+}
+
+static inline Color8888 packWeightedNeon(uint32x4_t sums) {
+    uint16x4_t narrow = vqrshrn_n_u32(sums, SCALE_WEIGHT_BITS);
+    uint8x8_t packed = vqmovn_u16(vcombine_u16(narrow, narrow));
+    return vget_lane_u32(vreinterpret_u32_u8(packed), 0);
+}
+
+static void scaleLineNeon(Color8888 *dst, const Color8888 *src, const int *starts,
+                          const int16_t *weights, int taps, int width) {
+    for (int x = 0; x < width; x++, weights += taps) {
+        const Color8888 *pixels = src + starts[x];
+        uint32x4_t sums = vdupq_n_u32(0);
+        int t = 0;
+        for (; t + 2 <= taps; t += 2) {
+            uint16x8_t pair = vmovl_u8(vreinterpret_u8_u32(vld1_u32(pixels + t)));
+            sums = vmlal_n_u16(sums, vget_low_u16(pair), (uint16_t) weights[t]);
+            sums = vmlal_n_u16(sums, vget_high_u16(pair), (uint16_t) weights[t + 1]);
+        }
+        if (t < taps) {
+            uint16x8_t pixel = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(pixels[t])));
+            sums = vmlal_n_u16(sums, vget_low_u16(pixel), (uint16_t) weights[t]);
+        }
+        dst[x] = packWeightedNeon(sums);
+    }
+}
+
+static void blendLinesNeon(Color8888 *dst, const Color8888 *const *rows,
+                           const int16_t *weights, int taps, int width) {
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        uint32x4_t sums[4] = {vdupq_n_u32(0), vdupq_n_u32(0), vdupq_n_u32(0), vdupq_n_u32(0)};
+        for (int t = 0; t < taps; t++) {
+            const uint8x16_t pixels = vreinterpretq_u8_u32(vld1q_u32(rows[t] + x));
+            const uint16x8_t lo = vmovl_u8(vget_low_u8(pixels));
+            const uint16x8_t hi = vmovl_u8(vget_high_u8(pixels));
+            const uint16_t weight = (uint16_t) weights[t];
+            sums[0] = vmlal_n_u16(sums[0], vget_low_u16(lo), weight);
+            sums[1] = vmlal_n_u16(sums[1], vget_high_u16(lo), weight);
+            sums[2] = vmlal_n_u16(sums[2], vget_low_u16(hi), weight);
+            sums[3] = vmlal_n_u16(sums[3], vget_high_u16(hi), weight);
+        }
+        for (int i = 0; i < 4; i++) {
+            dst[x + i] = packWeightedNeon(sums[i]);
+        }
+    }
+    blendLinesFrom(dst, rows, weights, taps, x, width);
+}
+
+#endif // COMPOSITE_ARM_NEON
+
+////////////////////////////////////////////////////////////////////////////////
+// dispatch
+////////////////////////////////////////////////////////////////////////////////
+
+static struct {
+    CompositeKernel kernel;
+    CompositeLineFunc compositeLine;
+    FillLineFunc fillLine;
+    AccumulateColumnsFunc accumulateColumns;
+    BlendBlocksFunc blendBlocks;
+    ScaleLineFunc scaleLine;
+    BlendLinesFunc blendLines;
+} gKernel = {COMPOSITE_SCALAR, compositeLineScalar, fillLineScalar, accumulateColumnsScalar,
+             blendBlocksScalar, scaleLineScalar, blendLinesScalar};
+
+static bool isKernelSupported(CompositeKernel kernel) {
+    switch (kernel) {
+        case COMPOSITE_SCALAR:
+            return true;
+#if COMPOSITE_X86
+        case COMPOSITE_SSE41:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse4.1");
+        case COMPOSITE_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+#if COMPOSITE_ARM_NEON
+        case COMPOSITE_NEON:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+bool setCompositeKernel(CompositeKernel kernel) {
+    if (!isKernelSupported(kernel)) {
+        return false;
+    }
+    gKernel.kernel = kernel;
+    switch (kernel) {
+#if COMPOSITE_X86
+        case COMPOSITE_SSE41:
+            gKernel.compositeLine = compositeLineSse41;
+            gKernel.fillLine = fillLineSse41;
+            gKernel.accumulateColumns = accumulateColumnsSse41;
+            gKernel.blendBlocks = blendBlocksSse41;
+            gKernel.scaleLine = scaleLineSse41;
+            gKernel.blendLines = blendLinesSse41;
+            break;
+        case COMPOSITE_AVX2:
+            gKernel.compositeLine = compositeLineAvx2;
+            gKernel.fillLine = fillLineAvx2;
+            gKernel.accumulateColumns = accumulateColumnsAvx2;
+            // 每个块 (像素) 只有 4 个通道, 横向合并和缩放沿用 SSE4.1
+            gKernel.blendBlocks = blendBlocksSse41;
+            gKernel.scaleLine = scaleLineSse41;
+            gKernel.blendLines = blendLinesSse41;
+            break;
+#endif
+#if COMPOSITE_ARM_NEON
+        case COMPOSITE_NEON:
+            gKernel.compositeLine = compositeLineNeon;
+            gKernel.fillLine = fillLineNeon;
+            gKernel.accumulateColumns = accumulateColumnsNeon;
+            gKernel.blendBlocks = blendBlocksNeon;
+            gKernel.scaleLine = scaleLineNeon;
+            gKernel.blendLines = blendLinesNeon;
+            break;
+#endif
+        default:
+            gKernel.compositeLine = compositeLineScalar;
+            gKernel.fillLine = fillLineScalar;
+            gKernel.accumulateColumns = accumulateColumnsScalar;
+            gKernel.blendBlocks = blendBlocksScalar;
+            gKernel.scaleLine = scaleLineScalar;
+            gKernel.blendLines = blendLinesScalar;
+            break;
+    }
+    return true;
+}
+
+// 加载时选择 CPU 支持的最快实现
+__attribute__((unused)) static bool gKernelSelected = setCompositeKernel(COMPOSITE_AVX2)
+                              || setCompositeKernel(COMPOSITE_SSE41)
+                              || setCompositeKernel(COMPOSITE_NEON);
+
+CompositeKernel getCompositeKernel() {
+    return gKernel.kernel;
+}
+
+void compositeLine(Color8888 *dst, const uint8_t *src, const Color8888 *lut, int width,
+                   int inSampleSize) {
+    if (inSampleSize == 1) {
+        gKernel.compositeLine(dst, src, lut, width);
+        return;
+    }
+    // 采样时索引不连续, 逐个处理
+    for (; width > 0; width--, src += inSampleSize, dst++) {
+        compositePixel(dst, src, lut);
+    }
+}
+
+void compositeBoxLine(Color8888 *dst, const uint8_t *src, int srcStride, int rows,
+                      const Color8888 *lut, int width, int srcWidth, int inSampleSize,
+                      uint32_t *sums) {
+    memset(sums, 0, sizeof(uint32_t) * 4 * srcWidth);
+    for (int y = 0; y < rows; y++, src += srcStride) {
+        gKernel.accumulateColumns(sums, src, lut, srcWidth);
+    }
+    // 最后一块可能不足 inSampleSize 列
+    const int blocks = srcWidth / inSampleSize < width ? srcWidth / inSampleSize : width;
+    gKernel.blendBlocks(dst, sums, blocks, inSampleSize, blockReciprocal(rows * inSampleSize));
+    if (blocks < width) {
+        const int columns = srcWidth - blocks * inSampleSize;
+        blendColumns(dst + blocks, sums + blocks * inSampleSize * 4, columns,
+                     blockReciprocal(rows * columns));
+    }
+}
+
+void scaleLine(Color8888 *dst, const Color8888 *src, const int *starts, const int16_t *weights,
+               int taps, int width) {
+    gKernel.scaleLine(dst, src, starts, weights, taps, width);
+}
+
+void blendLines(Color8888 *dst, const Color8888 *const *rows, const int16_t *weights, int taps,
+                int width) {
+    gKernel.blendLines(dst, rows, weights, taps, width);
+}
+
+void fillLine(Color8888 *dst, Color8888 color, int width) {
+    gKernel.fillLine(dst, color, width);
+}
+
+void compositeLine565(Color565 *dst, const uint8_t *src, const Color8888 *lut,
+                      const Color565 *lut565, int width, int inSampleSize) {
+    for (; width > 0; width--, src += inSampleSize, dst++) {
+        if (lut[*src] != TRANSPARENT) {
+            *dst = lut565[*src];
+        }
+    }
+}
+
+void compositeLineA8(uint8_t *dst, const uint8_t *src, const Color8888 *lut, int width,
+                     int inSampleSize) {
+    for (; width > 0; width--, src += inSampleSize, dst++) {
+        const Color8888 color = lut[*src];
+        if (color != TRANSPARENT) {
+            *dst = (uint8_t) (color >> 24);
+        }
+    }
+}
+
+void fillLine(void *dst, PixelFormat format, Color8888 color, int width) {
+    switch (format) {
+        case PIXEL_FORMAT_565: {
+            Color565 *pixels = (Color565 *) dst;
+            const Color565 value = color8888To565(color);
+            for (int x = 0; x < width; x++) {
+                pixels[x] = value;
+            }
+            break;
+        }
+        case PIXEL_FORMAT_A8:
+            memset(dst, color >> 24, (size_t) width);
+            break;
+        default:
+            gKernel.fillLine((Color8888 *) dst, color, width);
+            break;
+    }
+}
+
+void packLine(void *dst, PixelFormat format, const Color8888 *src, int width) {
+    switch (format) {
+        case PIXEL_FORMAT_565: {
+            Color565 *pixels = (Color565 *) dst;
+            for (int x = 0; x < width; x++) {
+                pixels[x] = color8888To565(src[x]);
+            }
+            break;
+        }
+        case PIXEL_FORMAT_A8: {
+            uint8_t *pixels = (uint8_t *) dst;
+            for (int x = 0; x < width; x++) {
+                pixels[x] = (uint8_t) (src[x] >> 24);
+            }
+            break;
+        }
+        default:
+            memcpy(dst, src, sizeof(Color8888) * width);
+            break;
+    }
+}
+
+void unpackLine(Color8888 *dst, const void *src, PixelFormat format, int width) {
+    switch (format) {
+        case PIXEL_FORMAT_565: {
+            const Color565 *pixels = (const Color565 *) src;
+            for (int x = 0; x < width; x++) {
+                dst[x] = color565To8888(pixels[x]);
+            }
+            break;
+        }
+        case PIXEL_FORMAT_A8: {
+            const uint8_t *pixels = (const uint8_t *) src;
+            for (int x = 0; x < width; x++) {
+                dst[x] = (Color8888) pixels[x] << 24;
+            }
+            break;
+        }
+        default:
+            memcpy(dst, src, sizeof(Color8888) * width);
+            break;
+    }
+}
@@ -0,0 +1,83 @@
+/**
+ * 帧合成的逐行内核: 调色板索引经查找表展开为 Color8888 并处理透明色.
+ * 提供标量实现以及 SSE4.1 / AVX2 / NEON 版本, 加载时按 CPU 能力选择.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "Color.h"
+
+enum CompositeKernel {
+    COMPOSITE_SCALAR,
+    COMPOSITE_SSE41,
+    COMPOSITE_AVX2,
+    COMPOSITE_NEON,
+};
+
+/**
+ * 将一行索引像素经查找表写入 dst, 查找表中为 TRANSPARENT 的索引保留 dst 原有像素.
+ * @param src 索引像素, 每隔 inSampleSize 取一个
+ * @param lut 256 项的调色板查找表
+ * @param width 写入的像素个数
+ */
+void compositeLine(Color8888 *dst, const uint8_t *src, const Color8888 *lut, int width,
+                   int inSampleSize);
+
+/**
+ * 与 compositeLine 相同, 写入 RGB_565 的一行: lut 中为 TRANSPARENT 的索引保留 dst 原有像素,
+ * 其余索引取 lut565 中的颜色
+ */
+void compositeLine565(Color565 *dst, const uint8_t *src, const Color8888 *lut,
+                      const Color565 *lut565, int width, int inSampleSize);
+
+// 与 compositeLine 相同, 写入 ALPHA_8 的一行, 取 lut 中颜色的 alpha
+void compositeLineA8(uint8_t *dst, const uint8_t *src, const Color8888 *lut, int width,
+                     int inSampleSize);
+
+// compositeBoxLine 支持的最大 inSampleSize
+static const int BOX_FILTER_MAX_SAMPLE_SIZE = 128;
+
+/**
+ * 按 inSampleSize x inSampleSize 的块对索引像素做盒式滤波后写入 dst 的一行: 块内颜色按预乘 ARGB
+ * 取平均, 透明像素计为全透明, 结果按其不透明度叠加在 dst 原有像素之上.
+ * @param src 块的第一行索引像素, 共 rows 行, 行距 srcStride
+ * @param width 写入的像素个数
+ * @param srcWidth src 每行可用的像素个数, 不足一个块的部分按实际像素取平均
+ * @param sums 至少 srcWidth * 4 个元素的临时缓冲
+ */
+void compositeBoxLine(Color8888 *dst, const uint8_t *src, int srcStride, int rows,
+                      const Color8888 *lut, int width, int srcWidth, int inSampleSize,
+                      uint32_t *sums);
+
+// scaleLine 和 blendLines 的定点权重位数, 每个输出像素的权重之和为 1 << SCALE_WEIGHT_BITS
+static const int SCALE_WEIGHT_BITS = 14;
+
+/**
+ * 水平缩放一行: 第 x 个输出像素为 src[starts[x]] 起 taps 个像素按 weights[x * taps] 起的权重加权
+ * @param width 写入的像素个数
+ */
+void scaleLine(Color8888 *dst, const Color8888 *src, const int *starts, const int16_t *weights,
+               int taps, int width);
+
+// 垂直缩放一行: 每个输出像素为 rows[0..taps) 同一列按 weights 加权
+void blendLines(Color8888 *dst, const Color8888 *const *rows, const int16_t *weights, int taps,
+                int width);
+
+// 用同一颜色填充一行
+void fillLine(Color8888 *dst, Color8888 color, int width);
+
+// 用同一颜色填充 format 格式的一行
+void fillLine(void *dst, PixelFormat format, Color8888 color, int width);
+
+// 将 Color8888 的一行转换为 format 格式
+void packLine(void *dst, PixelFormat format, const Color8888 *src, int width);
+
+// 将 format 格式的一行展开为 Color8888, ALPHA_8 展开为预乘的黑色
+void unpackLine(Color8888 *dst, const void *src, PixelFormat format, int width);
+
+// 当前使用的实现
+CompositeKernel getCompositeKernel();
+
+// 强制使用指定实现, CPU 不支持时返回 false; 仅用于对比结果和性能, 非线程安全
+bool setCompositeKernel(CompositeKernel kernel);
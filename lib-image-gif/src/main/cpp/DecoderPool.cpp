@@ -0,0 +1,141 @@
+#include <malloc.h>
+#include "DecoderPool.h"
+#include "giflib/gif_lib.h"
+
+static void *takeGifState(size_t size) {
+    return DecoderPool::get().takeState(size);
+}
+
+static int giveGifState(void *state, size_t size) {
+    return DecoderPool::get().recycleState(state, size);
+}
+
+static void *takeGifRaster(size_t size) {
+    return DecoderPool::get().takeBuffer(size);
+}
+
+static int giveGifRaster(void *raster, size_t size) {
+    DecoderPool::get().recycleBuffer(raster, size);
+    return true;
+}
+
+DecoderPool &DecoderPool::get() {
+    static DecoderPool pool;
+    return pool;
+}
+
+DecoderPool::DecoderPool() {
+    GifRecycler recycler = {takeGifState, giveGifState, takeGifRaster, giveGifRaster};
+    DGifSetRecycler(&recycler);
+}
+
+DecoderPool::~DecoderPool() {
+    // 进程退出时之后关闭的 GIF 不再经过池
+    DGifSetRecycler(NULL);
+    trim();
+}
+
+size_t DecoderPool::getBufferClass(size_t size) {
+    // 每个 2 的幂区间分为 8 档, 取整浪费的内存不超过 12.5%
+    if (size <= 256) {
+        return 256;
+    }
+    size_t step = 256;
+    while (step * 2 <= size) {
+        step *= 2;
+    }
+    step /= 8;
+    return (size + step - 1) / step * step;
+}
+
+void DecoderPool::setLimits(int maxStates, size_t maxBufferBytes) {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mMaxStates = maxStates;
+        mMaxBufferBytes = maxBufferBytes;
+    }
+    // 已保留的内存可能超出新的上限, 全部释放
+    trim();
+}
+
+void *DecoderPool::takeBuffer(size_t size) {
+    const size_t bytes = getBufferClass(size);
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        for (size_t i = 0; i < mBuffers.size(); i++) {
+            if (mBuffers[i].bytes == bytes) {
+                void *data = mBuffers[i].data;
+                mBuffers[i] = mBuffers.back();
+                mBuffers.pop_back();
+                mBufferBytes -= bytes;
+                mStats.bufferReuses++;
+                return data;
+            }
+        }
+        mStats.bufferAllocs++;
+    }
+    return malloc(bytes);
+}
+
+void DecoderPool::recycleBuffer(void *buffer, size_t size) {
+    if (!buffer) {
+        return;
+    }
+    const size_t bytes = getBufferClass(size);
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mBufferBytes + bytes <= mMaxBufferBytes) {
+            Buffer entry = {buffer, bytes};
+            mBuffers.push_back(entry);
+            mBufferBytes += bytes;
+            return;
+        }
+    }
+    free(buffer);
+}
+
+void *DecoderPool::takeState(size_t size) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (!mStates.empty() && mStateSize == size) {
+        void *state = mStates.back();
+        mStates.pop_back();
+        mStats.stateReuses++;
+        return state;
+    }
+    mStats.stateAllocs++;
+    return NULL;
+}
+
+bool DecoderPool::recycleState(void *state, size_t size) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if ((int) mStates.size() >= mMaxStates) {
+        return false;
+    }
+    mStateSize = size;
+    mStates.push_back(state);
+    return true;
+}
+
+DecoderPoolStats DecoderPool::getStats() {
+    std::lock_guard<std::mutex> lock(mLock);
+    DecoderPoolStats stats = mStats;
+    stats.retainedBytes = mBufferBytes + mStates.size() * mStateSize;
+    return stats;
+}
+
+void DecoderPool::trim() {
+    std::vector<void *> states;
+    std::vector<Buffer> buffers;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        states.swap(mStates);
+        buffers.swap(mBuffers);
+        mBufferBytes = 0;
+    }
+    for (size_t i = 0; i < states.size(); i++) {
+        DGifFreeState(states[i]);
+    }
+    for (size_t i = 0; i < buffers.size(); i++) {
+        free(buffers[i].data);
+    }
+}
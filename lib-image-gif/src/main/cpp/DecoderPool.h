@@ -0,0 +1,70 @@
+/**
+ * 在解码器之间复用的内存: giflib 的解码状态 (GifFileType, LZW 表和 SavedImages 数组),
+ * 帧像素 RasterBits, 以及 GifDecoder 的保留缓冲, 关键帧和 lazyDecode 的帧缓存.
+ * 列表中短时间内反复创建和销毁解码器时, 省去这些大块内存的分配, 释放和清零.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <mutex>
+#include <vector>
+
+struct DecoderPoolStats {
+    // 新分配 / 从池中复用的解码状态个数
+    long stateAllocs;
+    long stateReuses;
+    // 新分配 / 从池中复用的缓冲个数
+    long bufferAllocs;
+    long bufferReuses;
+    // 池中当前保留的内存 (字节)
+    size_t retainedBytes;
+};
+
+class DecoderPool {
+public:
+    // 进程内唯一的池, 第一次调用时向 giflib 注册回收函数; GifDecoder 打开 GIF 之前会调用
+    static DecoderPool &get();
+
+    // 最多保留 maxStates 个解码状态和 maxBufferBytes 字节的缓冲, 超出的部分直接释放; 0 表示不保留
+    void setLimits(int maxStates, size_t maxBufferBytes);
+
+    // 取一块至少 size 字节的缓冲, 内容未初始化, 内存不足时返回 NULL
+    void *takeBuffer(size_t size);
+
+    // 归还 takeBuffer 得到的缓冲, size 须与取出时相同; buffer 为 NULL 时忽略
+    void recycleBuffer(void *buffer, size_t size);
+
+    // 取一个 giflib 解码状态, 没有时返回 NULL 由 giflib 分配
+    void *takeState(size_t size);
+
+    // 归还 giflib 解码状态, 池满时返回 false 由 giflib 释放
+    bool recycleState(void *state, size_t size);
+
+    DecoderPoolStats getStats();
+
+    // 释放池中保留的全部内存, 例如系统内存紧张时
+    void trim();
+
+private:
+    struct Buffer {
+        void *data;
+        size_t bytes;
+    };
+
+    DecoderPool();
+
+    ~DecoderPool();
+
+    // 缓冲按档位分配, 同一档位的缓冲可以互相复用
+    static size_t getBufferClass(size_t size);
+
+    std::mutex mLock;
+    std::vector<void *> mStates;
+    size_t mStateSize = 0;
+    std::vector<Buffer> mBuffers;
+    size_t mBufferBytes = 0;
+    int mMaxStates = 4;
+    size_t mMaxBufferBytes = 4 * 1024 * 1024;
+    DecoderPoolStats mStats = {};
+};
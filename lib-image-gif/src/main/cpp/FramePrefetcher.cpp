@@ -0,0 +1,116 @@
+#include <string.h>
+#include "FramePrefetcher.h"
+#include "GifDecoder.h"
+#include "utils/log.h"
+
+FramePrefetcher::FramePrefetcher(GifDecoder *decoder, const PrefetchOptions &options, int width,
+                                 int height)
+        : mDecoder(decoder), mOptions(options), mWidth(width), mHeight(height),
+          mRowBytes((size_t) width * getBytesPerPixel(options.format)),
+          mFrameBytes(mRowBytes * height), mCanvas(mFrameBytes),
+          mPixels(mFrameBytes * options.ringSize), mSlots(options.ringSize) {
+    mThread = std::thread(&FramePrefetcher::run, this);
+}
+
+FramePrefetcher::~FramePrefetcher() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mStopping = true;
+    }
+    mSpaceAvailable.notify_all();
+    mFramesPublished.notify_all();
+    mThread.join();
+}
+
+void FramePrefetcher::onFramesPublished() {
+    // 在锁内通知, 合成线程检查帧数之后、开始等待之前不会错过
+    std::lock_guard<std::mutex> lock(mLock);
+    mFramesPublished.notify_all();
+}
+
+int FramePrefetcher::takeNextFrame(void *outputPtr, PixelFormat format, int outputPixelStride,
+                                   int outputWidth, int outputHeight, long *delayMs) {
+    if (format != mOptions.format || outputWidth < mWidth || outputHeight < mHeight
+        || outputPixelStride < mWidth) {
+        return -1;
+    }
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mReady == 0) {
+        return -1;
+    }
+    const uint8_t *src = &mPixels[mHead * mFrameBytes];
+    uint8_t *dst = (uint8_t *) outputPtr;
+    const size_t outputRowBytes = (size_t) outputPixelStride * getBytesPerPixel(format);
+    for (int y = 0; y < mHeight; y++) {
+        memcpy(dst + outputRowBytes * y, src + mRowBytes * y, mRowBytes);
+    }
+    const Slot &slot = mSlots[mHead];
+    if (delayMs) {
+        *delayMs = slot.delayMs;
+    }
+    const int frameNr = slot.frameNr;
+    mHead = (mHead + 1) % mOptions.ringSize;
+    mReady--;
+    mSpaceAvailable.notify_one();
+    return frameNr;
+}
+
+int FramePrefetcher::nextFrame(int frameNr) {
+    frameNr++;
+    // 渐进解码时等待调用方读到这一帧, 读完或出错时回到第 0 帧
+    std::unique_lock<std::mutex> lock(mLock);
+    mFramesPublished.wait(lock, [this, frameNr] {
+        return mStopping || frameNr < mDecoder->getFrameCount() || mDecoder->isComplete();
+    });
+    if (mStopping) {
+        return -1;
+    }
+    if (frameNr < mDecoder->getFrameCount()) {
+        return frameNr;
+    }
+    return mDecoder->getFrameCount() > 0 ? 0 : -1;
+}
+
+void FramePrefetcher::run() {
+    int frameNr = mOptions.firstFrame;
+    int previousFrameNr = -1;
+    while (frameNr >= 0) {
+        int slot;
+        {
+            std::unique_lock<std::mutex> lock(mLock);
+            mSpaceAvailable.wait(lock, [this] {
+                return mStopping || mReady < mOptions.ringSize;
+            });
+            if (mStopping) {
+                return;
+            }
+            // 取出只移动 mHead 并减少 mReady, 这个空槽在合成期间不变
+            slot = (mHead + mReady) % mOptions.ringSize;
+        }
+        // 画布中始终是上一次合成的帧, 顺序播放时每次只合成一帧; 回到第 0 帧时从头合成
+        if (frameNr <= previousFrameNr) {
+            previousFrameNr = -1;
+        }
+        long delayMs;
+        if (mOptions.inSampleSize > 0) {
+            delayMs = mDecoder->drawFrame(frameNr, mCanvas.data(), mOptions.format, mWidth,
+                                          previousFrameNr, mOptions.inSampleSize);
+        } else {
+            delayMs = mDecoder->drawScaledFrame(frameNr, mCanvas.data(), mOptions.format, mWidth,
+                                                mWidth, mHeight, previousFrameNr);
+        }
+        if (delayMs < 0) {
+            ALOGW("Gif prefetch frame %d failed", frameNr);
+            return;
+        }
+        previousFrameNr = frameNr;
+        memcpy(&mPixels[slot * mFrameBytes], mCanvas.data(), mFrameBytes);
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mSlots[slot].frameNr = frameNr;
+            mSlots[slot].delayMs = delayMs;
+            mReady++;
+        }
+        frameNr = nextFrame(frameNr);
+    }
+}
@@ -0,0 +1,93 @@
+/**
+ * 预取: 后台线程按播放顺序在自己的画布上依次合成, 每一帧只依赖上一帧, 处置方式和保留缓冲与顺序播放相同;
+ * 合成好的帧复制到最多 ringSize 帧的环形缓冲, 播放时 takeNextFrame 取出最早的一帧, 不等待合成.
+ * 环满时线程阻塞等待, 不占用 CPU. 由 GifDecoder 持有, 通过其 drawFrame 和 drawScaledFrame 合成.
+ * 线程不读取数据源 (JavaInputStream 只能在附加到 JVM 的线程上读取), 渐进解码时等待调用方读出后续的帧
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Color.h"
+
+class GifDecoder;
+
+// 预取的输出参数
+struct PrefetchOptions {
+    // 最多提前合成的帧数
+    int ringSize;
+    // 第一帧
+    int firstFrame;
+    PixelFormat format;
+    // 大于 0 时以 drawFrame 合成, 输出尺寸为 GIF 尺寸除以 inSampleSize; 0 时以 drawScaledFrame 缩放
+    int inSampleSize;
+    // inSampleSize 为 0 时的输出尺寸
+    int outputWidth;
+    int outputHeight;
+};
+
+class FramePrefetcher {
+public:
+    /**
+     * 分配环形缓冲并启动合成线程, options 的尺寸已由 decoder 校验
+     * @param width,height 每一帧的输出尺寸
+     */
+    FramePrefetcher(GifDecoder *decoder, const PrefetchOptions &options, int width, int height);
+
+    // 停止合成线程, 等待正在合成的一帧完成
+    ~FramePrefetcher();
+
+    /**
+     * 取出最早合成好的一帧, 复制到 outputPtr (行距 outputPixelStride 个像素), 不等待合成
+     * @param delayMs 不为 NULL 时返回帧的时长
+     * @return 帧号, 还没有合成好的帧, 或格式与尺寸不符时返回 -1
+     */
+    int takeNextFrame(void *outputPtr, PixelFormat format, int outputPixelStride,
+                      int outputWidth, int outputHeight, long *delayMs);
+
+    // 渐进解码读出了新的帧或已读完, 唤醒等待后续帧的合成线程
+    void onFramesPublished();
+
+    // 环形缓冲和合成画布占用的内存
+    size_t getBytes() const {
+        return mPixels.size() + mCanvas.size();
+    }
+
+private:
+    struct Slot {
+        int frameNr;
+        long delayMs;
+    };
+
+    void run();
+
+    // 播放顺序中 frameNr 之后的一帧, 渐进解码时等待读出; 停止或没有可以合成的帧时返回 -1
+    int nextFrame(int frameNr);
+
+    GifDecoder *mDecoder;
+    const PrefetchOptions mOptions;
+    const int mWidth;
+    const int mHeight;
+    const size_t mRowBytes;
+    const size_t mFrameBytes;
+    // 合成线程的画布, 始终为上一次合成的帧
+    std::vector<uint8_t> mCanvas;
+    // 环形缓冲, 第 i 个槽位于 mPixels[i * mFrameBytes]
+    std::vector<uint8_t> mPixels;
+    std::vector<Slot> mSlots;
+
+    // 保护以下状态; 合成和复制到空槽时不持有
+    std::mutex mLock;
+    std::condition_variable mSpaceAvailable;
+    std::condition_variable mFramesPublished;
+    // 最早合成好的槽, 以及合成好的帧数
+    int mHead = 0;
+    int mReady = 0;
+    bool mStopping = false;
+    std::thread mThread;
+};
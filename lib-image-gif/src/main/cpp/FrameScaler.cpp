@@ -0,0 +1,134 @@
+#include <math.h>
+#include "FrameScaler.h"
+#include "Compositor.h"
+#include "utils/math.h"
+
+void FrameScaler::buildFilter(Filter &filter, int srcSize, int dstSize) {
+    filter.srcSize = srcSize;
+    filter.dstSize = dstSize;
+    filter.starts.resize(dstSize);
+    if (srcSize == dstSize) {
+        // 尺寸相同时逐点复制, 结果与源完全一致
+        filter.taps = 1;
+        filter.weights.assign(dstSize, 1 << SCALE_WEIGHT_BITS);
+        for (int i = 0; i < dstSize; i++) {
+            filter.starts[i] = i;
+        }
+        return;
+    }
+    const double scale = (double) srcSize / dstSize;
+    const double support = max(scale, 1.0);
+    const int taps = min((int) ceil(support * 2), srcSize);
+    filter.taps = taps;
+    filter.weights.resize((size_t) dstSize * taps);
+
+    std::vector<double> weights(taps);
+    for (int i = 0; i < dstSize; i++) {
+        // 目标像素中心在源中的位置, 窗口从 center - support 之后的第一个像素开始
+        const double center = (i + 0.5) * scale - 0.5;
+        const int start = max(0, min((int) floor(center - support) + 1, srcSize - taps));
+        filter.starts[i] = start;
+
+        double total = 0;
+        for (int t = 0; t < taps; t++) {
+            weights[t] = max(0.0, 1.0 - fabs(start + t - center) / support);
+            total += weights[t];
+        }
+        // 权重归一化后量化, 舍入误差计入最大的权重, 保证总和恰好为 1 << SCALE_WEIGHT_BITS
+        int16_t *quantized = &filter.weights[(size_t) i * taps];
+        int sum = 0;
+        int largest = 0;
+        for (int t = 0; t < taps; t++) {
+            quantized[t] = total > 0 ? (int16_t) lround(weights[t] / total
+                                                        * (1 << SCALE_WEIGHT_BITS)) : 0;
+            sum += quantized[t];
+            if (quantized[t] > quantized[largest]) {
+                largest = t;
+            }
+        }
+        quantized[largest] += (1 << SCALE_WEIGHT_BITS) - sum;
+    }
+}
+
+void FrameScaler::setSize(int srcWidth, int srcHeight, int dstWidth, int dstHeight) {
+    if (mHorizontal.srcSize != srcWidth || mHorizontal.dstSize != dstWidth) {
+        buildFilter(mHorizontal, srcWidth, dstWidth);
+    }
+    if (mVertical.srcSize != srcHeight || mVertical.dstSize != dstHeight) {
+        buildFilter(mVertical, srcHeight, dstHeight);
+    }
+    mRows.resize((size_t) mVertical.taps * dstWidth);
+    mRowTags.resize(mVertical.taps);
+    mRowPointers.resize(mVertical.taps);
+}
+
+void FrameScaler::mapRange(const Filter &filter, int srcBegin, int srcEnd, int &begin,
+                           int &end) {
+    // starts 单调不减, 受影响的目标像素是连续的一段
+    begin = 0;
+    while (begin < filter.dstSize && filter.starts[begin] + filter.taps <= srcBegin) {
+        begin++;
+    }
+    end = begin;
+    while (end < filter.dstSize && filter.starts[end] < srcEnd) {
+        end++;
+    }
+}
+
+void FrameScaler::mapRect(int &left, int &top, int &right, int &bottom) const {
+    if (left >= right || top >= bottom) {
+        left = top = right = bottom = 0;
+        return;
+    }
+    mapRange(mHorizontal, left, right, left, right);
+    mapRange(mVertical, top, bottom, top, bottom);
+}
+
+void FrameScaler::scale(const Color8888 *src, int srcStride, void *dst, PixelFormat format,
+                        int dstStride, int left, int top, int right, int bottom) {
+    if (left >= right || top >= bottom) {
+        return;
+    }
+    const int width = right - left;
+    const int taps = mVertical.taps;
+    const size_t bytesPerPixel = getBytesPerPixel(format);
+    if (format != PIXEL_FORMAT_8888 && mPackRow.size() < (size_t) width) {
+        mPackRow.resize(width);
+    }
+    // 源画布已改动, 之前缓存的行全部失效
+    for (int t = 0; t < taps; t++) {
+        mRowTags[t] = -1;
+    }
+    for (int y = top; y < bottom; y++) {
+        const int start = mVertical.starts[y];
+        for (int t = 0; t < taps; t++) {
+            const int srcY = start + t;
+            const int slot = srcY % taps;
+            Color8888 *row = &mRows[(size_t) slot * mHorizontal.dstSize];
+            if (mRowTags[slot] != srcY) {
+                scaleLine(row + left, src + (size_t) srcY * srcStride,
+                          &mHorizontal.starts[left],
+                          &mHorizontal.weights[(size_t) left * mHorizontal.taps],
+                          mHorizontal.taps, width);
+                mRowTags[slot] = srcY;
+            }
+            mRowPointers[t] = row + left;
+        }
+        uint8_t *out = (uint8_t *) dst + ((size_t) y * dstStride + left) * bytesPerPixel;
+        if (format == PIXEL_FORMAT_8888) {
+            blendLines((Color8888 *) out, mRowPointers.data(),
+                       &mVertical.weights[(size_t) y * taps], taps, width);
+        } else {
+            blendLines(mPackRow.data(), mRowPointers.data(),
+                       &mVertical.weights[(size_t) y * taps], taps, width);
+            packLine(out, format, mPackRow.data(), width);
+        }
+    }
+}
+
+size_t FrameScaler::getMemoryBytes() const {
+    return (mRows.size() + mPackRow.size()) * sizeof(Color8888)
+           + mRowTags.size() * sizeof(int) + mRowPointers.size() * sizeof(Color8888 *)
+           + (mHorizontal.starts.size() + mVertical.starts.size()) * sizeof(int)
+           + (mHorizontal.weights.size() + mVertical.weights.size()) * sizeof(int16_t);
+}
@@ -0,0 +1,59 @@
+/**
+ * 将合成后的画布缩放到任意尺寸: 先水平后垂直的可分离三角 (tent) 滤波, 缩小时滤波半径随比例增大,
+ * 相当于按面积取平均; 放大时为双线性插值. 权重在 setSize 时预先计算, 逐行由 Compositor 的内核完成.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "Color.h"
+
+class FrameScaler {
+public:
+    // 设置源和目标尺寸, 尺寸不变时不重新计算权重
+    void setSize(int srcWidth, int srcHeight, int dstWidth, int dstHeight);
+
+    /**
+     * 源中 [left, right) x [top, bottom) 改动后, 目标中受影响的区域, 结果写回同样的参数.
+     * 源区域为空时目标区域也为空
+     */
+    void mapRect(int &left, int &top, int &right, int &bottom) const;
+
+    /**
+     * 重新计算目标中 [left, right) x [top, bottom) 的像素, 区域为 mapRect 的结果
+     * @param src 源画布, 行距 srcStride 个像素
+     * @param dst 目标, 像素格式为 format, 行距 dstStride 个像素
+     */
+    void scale(const Color8888 *src, int srcStride, void *dst, PixelFormat format, int dstStride,
+               int left, int top, int right, int bottom);
+
+    // 权重表和中间行缓冲占用的内存 (字节)
+    size_t getMemoryBytes() const;
+
+private:
+    // 一个方向上的滤波: 第 i 个目标像素取源中 [starts[i], starts[i] + taps) 加权
+    struct Filter {
+        int srcSize = 0;
+        int dstSize = 0;
+        int taps = 0;
+        std::vector<int> starts;
+        std::vector<int16_t> weights;
+    };
+
+    static void buildFilter(Filter &filter, int srcSize, int dstSize);
+
+    // 目标 [begin, end) 依赖的源范围与 [srcBegin, srcEnd) 相交时, 收缩到相交的目标范围
+    static void mapRange(const Filter &filter, int srcBegin, int srcEnd, int &begin, int &end);
+
+    Filter mHorizontal;
+    Filter mVertical;
+    // 水平滤波后的源行, 共 mVertical.taps 行, 源第 y 行放在 y % taps
+    std::vector<Color8888> mRows;
+    // 每个槽位当前存放的源行号, -1 表示空
+    std::vector<int> mRowTags;
+    std::vector<const Color8888 *> mRowPointers;
+    // 目标不是 8888 时, 垂直滤波的结果先写到这一行再打包
+    std::vector<Color8888> mPackRow;
+};
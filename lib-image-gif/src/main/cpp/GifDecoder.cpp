@@ -6,8 +6,11 @@
 
 #include <malloc.h>
 #include <string.h>
-#include <android/bitmap.h>
+#include <limits.h>
 #include "GifDecoder.h"
+#include "Compositor.h"
+#include "DecoderPool.h"
+#include "WorkerPool.h"
 #include "utils/math.h"
 #include "utils/log.h"
 
@@ -16,7 +19,7 @@
 // draw helpers
 ////////////////////////////////////////////////////////////////////////////////
 
-static long getDelayMs(GraphicsControlBlock &gcb) {
+static int getDelayMs(const GraphicsControlBlock &gcb) {
     return gcb.DelayTime * 10;
 }
 
@@ -24,8 +27,8 @@ static Color8888 gifColorToColor8888(const GifColorType &color) {
     return ARGB_TO_COLOR8888(0xff, color.Red, color.Green, color.Blue);
 }
 
-static bool willBeCleared(const GraphicsControlBlock &gcb) {
-    return gcb.DisposalMode == DISPOSE_BACKGROUND || gcb.DisposalMode == DISPOSE_PREVIOUS;
+static bool willBeCleared(int disposalMode) {
+    return disposalMode == DISPOSE_BACKGROUND || disposalMode == DISPOSE_PREVIOUS;
 }
 
 // return true if area of 'target' is completely covers area of 'covered'
@@ -36,32 +39,74 @@ static bool checkIfCover(const GifImageDesc &target, const GifImageDesc &covered
            && covered.Top + covered.Height <= target.Top + target.Height;
 }
 
-static void
-copyLine(Color8888 *dst, const unsigned char *src, const ColorMapObject *cmap, int transparent,
-         int width, int inSampleSize) {
-    for (; width > 0; width--, src += inSampleSize, dst++) {
-        if (*src != transparent && *src < cmap->ColorCount) {
-            *dst = gifColorToColor8888(cmap->Colors[*src]);
-        }
+// 计算采样后的拷贝区域, maxWidth/maxHeight 为采样后的画布尺寸
+static void getCopySize(const GifImageDesc &imageDesc, int maxWidth, int maxHeight,
+                        int inSampleSize, GifWord &copyWidth, GifWord &copyHeight) {
+    copyWidth = (imageDesc.Width + inSampleSize - 1) / inSampleSize;
+    if (imageDesc.Left / inSampleSize + copyWidth > maxWidth) {
+        copyWidth = maxWidth - imageDesc.Left / inSampleSize;
+    }
+    copyHeight = (imageDesc.Height + inSampleSize - 1) / inSampleSize;
+    if (imageDesc.Top / inSampleSize + copyHeight > maxHeight) {
+        copyHeight = maxHeight - imageDesc.Top / inSampleSize;
     }
 }
 
-static void setLineColor(Color8888 *dst, Color8888 color, int width) {
-    for (; width > 0; width--, dst++) {
-        *dst = color;
+// 按 format 将一行索引像素经查找表合成到 dst
+static void compositeFormatLine(uint8_t *dst, PixelFormat format, const uint8_t *src,
+                                const Color8888 *lut, const Color565 *lut565, int width,
+                                int inSampleSize) {
+    switch (format) {
+        case PIXEL_FORMAT_565:
+            compositeLine565((Color565 *) dst, src, lut, lut565, width, inSampleSize);
+            break;
+        case PIXEL_FORMAT_A8:
+            compositeLineA8(dst, src, lut, width, inSampleSize);
+            break;
+        default:
+            compositeLine((Color8888 *) dst, src, lut, width, inSampleSize);
+            break;
     }
 }
 
-static void getCopySize(const GifImageDesc &imageDesc, int maxWidth, int maxHeight,
-                        GifWord &copyWidth, GifWord &copyHeight) {
-    copyWidth = imageDesc.Width;
-    if (imageDesc.Left + copyWidth > maxWidth) {
-        copyWidth = maxWidth - imageDesc.Left;
+// 将一帧在采样后画布上的区域合并到 dirtyRect
+static void addDirtyRect(DirtyRect *dirtyRect, const GifImageDesc &imageDesc, int maxWidth,
+                         int maxHeight, int inSampleSize) {
+    if (!dirtyRect) {
+        return;
+    }
+    GifWord copyWidth, copyHeight;
+    getCopySize(imageDesc, maxWidth, maxHeight, inSampleSize, copyWidth, copyHeight);
+    if (copyWidth <= 0 || copyHeight <= 0) {
+        return;
     }
-    copyHeight = imageDesc.Height;
-    if (imageDesc.Top + copyHeight > maxHeight) {
-        copyHeight = maxHeight - imageDesc.Top;
+    const int left = imageDesc.Left / inSampleSize;
+    const int top = imageDesc.Top / inSampleSize;
+    if (dirtyRect->left >= dirtyRect->right || dirtyRect->top >= dirtyRect->bottom) {
+        dirtyRect->left = left;
+        dirtyRect->top = top;
+        dirtyRect->right = left + copyWidth;
+        dirtyRect->bottom = top + copyHeight;
+        return;
     }
+    dirtyRect->left = min(dirtyRect->left, left);
+    dirtyRect->top = min(dirtyRect->top, top);
+    dirtyRect->right = max(dirtyRect->right, left + copyWidth);
+    dirtyRect->bottom = max(dirtyRect->bottom, top + copyHeight);
+}
+
+static void unionDirtyRect(DirtyRect &dirtyRect, const DirtyRect &other) {
+    if (other.left >= other.right || other.top >= other.bottom) {
+        return;
+    }
+    if (dirtyRect.left >= dirtyRect.right || dirtyRect.top >= dirtyRect.bottom) {
+        dirtyRect = other;
+        return;
+    }
+    dirtyRect.left = min(dirtyRect.left, other.left);
+    dirtyRect.top = min(dirtyRect.top, other.top);
+    dirtyRect.right = max(dirtyRect.right, other.right);
+    dirtyRect.bottom = max(dirtyRect.bottom, other.bottom);
 }
 
 static int streamReader(GifFileType *fileType, GifByteType *out, int size) {
@@ -69,112 +114,1044 @@ static int streamReader(GifFileType *fileType, GifByteType *out, int size) {
     return (int) stream->read(out, size);
 }
 
+// compositeThreads 和 decodeThreads 实际使用的线程数, 0 表示与 CPU 核数相同
+static int resolveThreadCount(int threads) {
+    return threads > 0 ? threads : WorkerPool::getCpuCount();
+}
+
 
 
-GifDecoder::GifDecoder(char *filePath) {
-    mGif = DGifOpenFileName(filePath, NULL);
+GifDecoder::GifDecoder(char *filePath, const DecodeOptions &options) : mOptions(options) {
+    // 打开 GIF 之前确保 giflib 已经使用解码器池
+    DecoderPool::get();
+    // 优先映射整个文件, giflib 直接在映射上解压, 省去 fread 的拷贝和系统调用
+    MmapStream *stream = new MmapStream(filePath);
+    if (stream->getRawBufferAddr()) {
+        mSourceStream = stream;
+        mGif = DGifOpenMemory(stream->getRawBufferAddr(),
+                              (size_t) stream->getRawBufferSize(), NULL);
+    } else {
+        delete stream;
+        // 无法映射 (空文件, 管道等), 退回按块读取
+        if (mOptions.lazyDecode || mOptions.compressedFrames || hasMemoryBudget()
+            || decodesInParallel()) {
+            FILE *file = fopen(filePath, "rb");
+            if (file) {
+                FileStream fileStream(file);
+                openSource(&fileStream);
+                fclose(file);
+            }
+        } else {
+            mGif = DGifOpenFileName(filePath, NULL);
+        }
+    }
     init();
 }
 
-GifDecoder::GifDecoder(Stream *stream) {
-    mGif = DGifOpen(stream, streamReader, NULL);
+GifDecoder::GifDecoder(Stream *stream, const DecodeOptions &options) : mOptions(options) {
+    DecoderPool::get();
+    if (mOptions.lazyDecode || hasMemoryBudget()) {
+        // 有预算时先扫描再决定表示方式, 需要可以回读的数据源
+        openSource(stream);
+    } else if (mOptions.progressive && !mOptions.justDecodeInfo) {
+        mProgressiveStream = stream;
+        mGif = DGifOpen(stream, streamReader, NULL);
+    } else if (stream->getRawBufferAddr() && stream->getRawBufferSize() > 0) {
+        // direct ByteBuffer 等内存数据在构造期间有效, init 直接在其上解压, 之后不再读取
+        mGif = DGifOpenMemory(stream->getRawBufferAddr(),
+                              (size_t) stream->getRawBufferSize(), NULL);
+    } else if (mOptions.compressedFrames || decodesInParallel()) {
+        // 扫描之后按帧索引截取或并行解压 LZW 数据, 需要可以回读的数据源, 之后释放
+        openSource(stream);
+    } else {
+        mGif = DGifOpen(stream, streamReader, NULL);
+    }
     init();
 }
 
-void GifDecoder::init() {
-    if (!mGif) {
-        ALOGW("Gif load failed");
-        DGifCloseFile(mGif, NULL);
-        return;
+bool GifDecoder::openSource(Stream *stream) {
+    size_t size = 0;
+    GifByteType *data = NULL;
+    if (stream->getRawBufferAddr() && stream->getRawBufferSize() > 0) {
+        // 内存数据只在构造期间有效, 一次拷贝出来
+        size = (size_t) stream->getRawBufferSize();
+        data = (GifByteType *) malloc(size);
+        if (data) {
+            memcpy(data, stream->getRawBufferAddr(), size);
+        }
+    } else {
+        size_t capacity = 64 * 1024;
+        data = (GifByteType *) malloc(capacity);
+        while (data) {
+            if (size == capacity) {
+                capacity *= 2;
+                GifByteType *newData = (GifByteType *) realloc(data, capacity);
+                if (!newData) {
+                    free(data);
+                    data = NULL;
+                    break;
+                }
+                data = newData;
+            }
+            size_t read = stream->read(data + size, capacity - size);
+            if (read == 0) {
+                break;
+            }
+            size += read;
+        }
     }
-    if (DGifSlurp(mGif) != GIF_OK) {
-        ALOGW("Gif slurp failed");
-        DGifCloseFile(mGif, NULL);
-        mGif = NULL;
-        return;
+    if (!data) {
+        ALOGE("Out of memory while reading gif source");
+        return false;
     }
+    mSourceCopy = data;
+    mSourceCopySize = size;
+    mGif = DGifOpenMemory(mSourceCopy, size, NULL);
+    return mGif != NULL;
+}
 
-    int lastUnclearedFrame = -1;
-    mPreservedFrames = new bool[mGif->ImageCount];
-    mRestoringFrames = new int[mGif->ImageCount];
+bool GifDecoder::decodeFrameRaster(int frameNr, GifByteType *raster) {
+    if (mCompressedFrames) {
+        const size_t offset = mCompressedOffsets[frameNr];
+        return DGifDecompressCode(mGif, &mGif->SavedImages[frameNr].ImageDesc,
+                                  mCompressedFrames + offset,
+                                  mCompressedOffsets[frameNr + 1] - offset, raster) == GIF_OK;
+    }
+    // 回到该帧的图像描述符, 重新建立 LZW 解压状态
+    if (DGifSeek(mGif, mFrameIndex[frameNr].ImageOffset) == GIF_ERROR
+        || DGifGetImageHeader(mGif) == GIF_ERROR) {
+        return false;
+    }
+    return DGifGetImage(mGif, raster) == GIF_OK;
+}
 
-    GraphicsControlBlock gcb;
+// compositeFrameRows 逐行合成的目标, 采样后的区域
+struct RowTarget {
+    uint8_t *dst;
+    size_t rowBytes;
+    PixelFormat format;
+    const Color8888 *lut;
+    const Color565 *lut565;
+    int copyWidth;
+    int copyHeight;
+    int inSampleSize;
+};
+
+// giflib 每解压一行调用一次, 隔行扫描的帧按存储顺序传入
+static void compositeRow(void *userData, int row, const GifPixelType *line) {
+    const RowTarget *target = (const RowTarget *) userData;
+    const int y = row / target->inSampleSize;
+    if (row % target->inSampleSize == 0 && y < target->copyHeight) {
+        compositeFormatLine(target->dst + y * target->rowBytes, target->format, line,
+                            target->lut, target->lut565, target->copyWidth,
+                            target->inSampleSize);
+    }
+}
+
+bool GifDecoder::compositeFrameRows(int frameNr, const OutputCanvas &canvas, int left, int top,
+                                    const PaletteLut *lut, int copyWidth, int copyHeight,
+                                    int inSampleSize) {
+    const GifImageDesc &imageDesc = mGif->SavedImages[frameNr].ImageDesc;
+    if (mLineBuffer.size() < (size_t) imageDesc.Width) {
+        mLineBuffer.resize(imageDesc.Width);
+    }
+    RowTarget target = {canvas.at(left, top), canvas.rowBytes, canvas.format, lut->colors,
+                        lut->colors565, copyWidth, copyHeight, inSampleSize};
+    bool ok;
+    if (mCompressedFrames) {
+        const size_t offset = mCompressedOffsets[frameNr];
+        ok = DGifDecompressCodeRows(mGif, &imageDesc, mCompressedFrames + offset,
+                                    mCompressedOffsets[frameNr + 1] - offset,
+                                    mLineBuffer.data(), compositeRow, &target) == GIF_OK;
+    } else {
+        ok = DGifSeek(mGif, mFrameIndex[frameNr].ImageOffset) != GIF_ERROR
+             && DGifGetImageHeader(mGif) != GIF_ERROR
+             && DGifGetImageRows(mGif, mLineBuffer.data(), compositeRow, &target) == GIF_OK;
+    }
+    if (!ok) {
+        ALOGW("Gif decode frame %d failed, error %d", frameNr, mGif->Error);
+    }
+    return ok;
+}
+
+bool GifDecoder::applyMemoryBudget() {
+    const size_t budget = (size_t) mOptions.memoryBudgetBytes;
+    const size_t canvasBytes = (size_t) mGif->SWidth * mGif->SHeight * sizeof(Color8888);
+    size_t rasterBytes = 0;
+    size_t maxRasterBytes = 1;
+    size_t compressedBytes = (size_t) (mGif->ImageCount + 1) * sizeof(size_t);
+    // 此时还没有发布帧, 按帧索引中的 GCB 推算是否需要保留缓冲, 与 addFrameInfo 相同
+    bool needPreserve = false;
+    bool hasUnclearedFrame = false;
+    for (int i = 0; i < mGif->ImageCount; i++) {
+        const GifImageDesc &imageDesc = mGif->SavedImages[i].ImageDesc;
+        const size_t size = (size_t) imageDesc.Width * imageDesc.Height;
+        rasterBytes += size;
+        compressedBytes += (size_t) mFrameIndex[i].CodeLength;
+        maxRasterBytes = max(maxRasterBytes, size);
+        const int disposalMode = mFrameIndex[i].GCB.DisposalMode;
+        needPreserve = needPreserve || (disposalMode == DISPOSE_PREVIOUS && hasUnclearedFrame);
+        hasUnclearedFrame = hasUnclearedFrame || !willBeCleared(disposalMode);
+    }
+    // 与表示方式无关的部分
+    const size_t fixedBytes = (needPreserve ? canvasBytes : 0) + getMetadataBytes()
+                              + getFrameArrayBytes(mGif->ImageCount);
+    size_t keyframeBytes = 0;
+    if (mOptions.keyframeInterval > 0) {
+        keyframeBytes = min((size_t) max(mOptions.keyframeCacheBytes, 0l),
+                            canvasBytes * (mGif->ImageCount / mOptions.keyframeInterval));
+    }
+
+    // 文件映射由页缓存承担, 按需解压时不计入; 否则只保留 LZW 数据比保留数据源副本更省
+    const bool useCompressed = mOptions.compressedFrames
+                               || (!mOptions.lazyDecode && mSourceCopySize > 0);
+    const size_t residentBytes = useCompressed ? compressedBytes : mSourceCopySize;
+
+    // 数据压缩率很低时, 按需解压常驻的数据反而比完整解压占用更多
+    const size_t decodedBytes = fixedBytes + rasterBytes + keyframeBytes;
+    const bool requestedLazy = mOptions.lazyDecode || mOptions.compressedFrames;
+    if (!requestedLazy
+        && (decodedBytes <= budget || rasterBytes <= residentBytes + maxRasterBytes)) {
+        return decodeAllFrames();
+    }
+
+    // 超出预算: 按需解压, 剩余预算分给关键帧和缓存
+    if (useCompressed) {
+        mOptions.compressedFrames = true;
+    } else {
+        mOptions.lazyDecode = true;
+    }
+    size_t remaining = budget > fixedBytes + residentBytes
+                       ? budget - fixedBytes - residentBytes : 0;
+    if (keyframeBytes > remaining / 2) {
+        keyframeBytes = remaining / 2;
+        if (keyframeBytes < canvasBytes) {
+            keyframeBytes = 0;
+            mOptions.keyframeInterval = 0;
+        }
+        mOptions.keyframeCacheBytes = (long) keyframeBytes;
+    }
+    remaining -= keyframeBytes;
+    const int affordable = (int) min(remaining / maxRasterBytes, (size_t) mGif->ImageCount);
+    mOptions.rasterCacheSize = requestedLazy ? min(mOptions.rasterCacheSize, affordable)
+                                             : affordable;
+    ALOGI("Gif needs %zu bytes decoded, budget %zu: %s with %d cached frames",
+          decodedBytes, budget, useCompressed ? "compressed frames" : "lazy decode",
+          mOptions.rasterCacheSize);
+    return true;
+}
+
+bool GifDecoder::decodesInParallel() const {
+    return resolveThreadCount(mOptions.decodeThreads) > 1 && !mOptions.lazyDecode
+           && !mOptions.justDecodeInfo && !mOptions.progressive && !mOptions.compressedFrames;
+}
+
+bool GifDecoder::decodeAllFrames() {
+    // 先分配所有帧的像素, 按文件分配的大块内存不能在解压线程中并发切分
+    for (int i = 0; i < mGif->ImageCount; i++) {
+        SavedImage &image = mGif->SavedImages[i];
+        image.RasterBits = DGifAllocRaster(
+                mGif, (size_t) image.ImageDesc.Width * image.ImageDesc.Height);
+        if (!image.RasterBits) {
+            return false;
+        }
+    }
+    size_t size;
+    const GifByteType *data = DGifGetMemory(mGif, &size);
+    const int threads = min(resolveThreadCount(mOptions.decodeThreads), mGif->ImageCount);
+    if (data && threads > 1) {
+        if (!decodeFramesInParallel(data, size, threads)) {
+            return false;
+        }
+    } else {
+        for (int i = 0; i < mGif->ImageCount; i++) {
+            if (!decodeFrameRaster(i, mGif->SavedImages[i].RasterBits)) {
+                return false;
+            }
+        }
+    }
+    // 帧索引只在按需解压时使用
+    free(mFrameIndex);
+    mFrameIndex = NULL;
+    return true;
+}
+
+bool GifDecoder::decodeFramesInParallel(const GifByteType *data, size_t size, int threads) {
+    std::atomic<int> nextFrame(0);
+    std::atomic<bool> failed(false);
+    WorkerPool::get().run(threads, threads, [&](int worker) {
+        // LZW 解压状态不能共用, 第 0 个线程使用 mGif, 其余各自打开同一份数据
+        GifFileType *gif = worker == 0 ? mGif : DGifOpenMemory(data, size, NULL);
+        if (!gif) {
+            failed = true;
+            return;
+        }
+        if (gif != mGif) {
+            DGifSetLZWEngine(gif, mOptions.lzwEngine);
+        }
+        // 空闲的线程领取下一个尚未解压的帧, 大小不一的帧自然均衡到各线程
+        int frameNr;
+        while (!failed && (frameNr = nextFrame++) < mGif->ImageCount) {
+            const GifFrameIndex &index = mFrameIndex[frameNr];
+            SavedImage &image = mGif->SavedImages[frameNr];
+            if (DGifDecompressCode(gif, &image.ImageDesc, data + index.CodeOffset,
+                                   (size_t) index.CodeLength, image.RasterBits) == GIF_ERROR) {
+                ALOGW("Gif decode frame %d failed, error %d", frameNr, gif->Error);
+                failed = true;
+            }
+        }
+        if (gif != mGif) {
+            DGifCloseFile(gif, NULL);
+        }
+    });
+    return !failed;
+}
+
+bool GifDecoder::captureCompressedFrames() {
+    const int frameCount = mGif->ImageCount;
+    mCompressedOffsets = new size_t[frameCount + 1];
+    size_t size = 0;
+    for (int i = 0; i < frameCount; i++) {
+        mCompressedOffsets[i] = size;
+        size += (size_t) mFrameIndex[i].CodeLength;
+    }
+    mCompressedOffsets[frameCount] = size;
+    mCompressedFrames = (GifByteType *) malloc(max(size, (size_t) 1));
+    if (!mCompressedFrames) {
+        ALOGE("Out of memory while keeping compressed frames");
+        return false;
+    }
+
+    // 按 code size, 子块, 结束块的顺序还原, 与 DGifScan 记录的 CodeLength 一致
+    for (int i = 0; i < frameCount; i++) {
+        GifByteType *dst = mCompressedFrames + mCompressedOffsets[i];
+        const GifByteType *end = mCompressedFrames + mCompressedOffsets[i + 1];
+        int codeSize;
+        GifByteType *block;
+        if (end - dst < 2
+            || DGifSeek(mGif, mFrameIndex[i].ImageOffset) == GIF_ERROR
+            || DGifGetImageHeader(mGif) == GIF_ERROR
+            || DGifGetCode(mGif, &codeSize, &block) == GIF_ERROR) {
+            return false;
+        }
+        *dst++ = (GifByteType) codeSize;
+        while (block) {
+            if (end - dst < block[0] + 2) {
+                return false;
+            }
+            memcpy(dst, block, (size_t) block[0] + 1);
+            dst += block[0] + 1;
+            if (DGifGetCodeNext(mGif, &block) == GIF_ERROR) {
+                return false;
+            }
+        }
+        *dst = 0;
+    }
+    // 之后只从 mCompressedFrames 解压
+    free(mFrameIndex);
+    mFrameIndex = NULL;
+    return true;
+}
+
+static size_t getColorMapBytes(const ColorMapObject *cmap) {
+    return cmap ? sizeof(ColorMapObject) + cmap->ColorCount * sizeof(GifColorType) : 0;
+}
+
+size_t GifDecoder::getMetadataBytes() const {
+    size_t bytes = getColorMapBytes(mGif->SColorMap)
+                   + (size_t) mGif->ImageCount * sizeof(SavedImage);
     for (int i = 0; i < mGif->ImageCount; i++) {
         const SavedImage &image = mGif->SavedImages[i];
+        bytes += getColorMapBytes(image.ImageDesc.ColorMap)
+                 + image.ExtensionBlockCount * sizeof(ExtensionBlock);
+        for (int j = 0; j < image.ExtensionBlockCount; j++) {
+            bytes += image.ExtensionBlocks[j].ByteCount;
+        }
+    }
+    if (mFrameIndex) {
+        bytes += (size_t) mGif->ImageCount * sizeof(GifFrameIndex);
+    }
+    return bytes + getFrameArrayBytes(mFrameCapacity);
+}
 
-        // find the loop extension pair
-        for (int j = 0; (j + 1) < image.ExtensionBlockCount; j++) {
-            ExtensionBlock *eb1 = image.ExtensionBlocks + j;
-            ExtensionBlock *eb2 = image.ExtensionBlocks + j + 1;
-            if (eb1->Function == APPLICATION_EXT_FUNC_CODE
-                // look for "NETSCAPE2.0" app extension
-                && eb1->ByteCount == 11
-                && !memcmp((const char *) (eb1->Bytes), "NETSCAPE2.0", 11)
-                // verify extension contents and get loop count
-                && eb2->Function == CONTINUE_EXT_FUNC_CODE
-                && eb2->ByteCount == 3
-                && eb2->Bytes[0] == 1) {
-                mLoopCount = (int) (eb2->Bytes[2] << 8) + (int) (eb2->Bytes[1]);
+size_t GifDecoder::getFrameArrayBytes(int capacity) const {
+    return (size_t) capacity
+           * (sizeof(*mPreservedFrames) + sizeof(*mRestoringFrames) + sizeof(*mFrameLuts)
+              + sizeof(*mCarriedPreserves) + sizeof(*mIndependentFrames)
+              + sizeof(*mLastIndependentFrames) + sizeof(*mFrameDelays)
+              + sizeof(*mFrameDisposals) + sizeof(*mFrameTransparents) + sizeof(*mFrameFlags));
+}
+
+MemoryUsage GifDecoder::getMemoryUsage() {
+    std::lock_guard<std::mutex> lock(mLock);
+    MemoryUsage usage = {};
+    if (!mHasInit) {
+        return usage;
+    }
+    if (mOptions.lazyDecode || mCompressedFrames) {
+        for (size_t i = 0; i < mRasterCache.size(); i++) {
+            usage.rasters += mRasterCache[i].capacity;
+        }
+    } else {
+        for (int i = 0; i < mFrameCount; i++) {
+            const SavedImage &image = mGif->SavedImages[i];
+            if (image.RasterBits) {
+                usage.rasters += (size_t) image.ImageDesc.Width * image.ImageDesc.Height;
             }
         }
+    }
+    usage.rasters += DGifGetScratchSize(mGif);
+    usage.sourceCopy = mSourceCopySize;
+    if (mCompressedFrames) {
+        usage.compressedFrames = mCompressedOffsets[mGif->ImageCount]
+                                 + (size_t) (mGif->ImageCount + 1) * sizeof(size_t);
+    }
+    usage.mappedSource = mSourceStream ? (size_t) mSourceStream->getRawBufferSize() : 0;
+    usage.preserveBuffer = mPreserveBufferBytes;
+    usage.keyframes = mKeyframeBytes;
+    usage.paletteLuts = mPaletteLuts.size() * sizeof(PaletteLut);
+    usage.metadata = getMetadataBytes();
+    usage.scaledCanvas = mScaledBytes;
+    usage.prefetch = mPrefetchBytes;
+    return usage;
+}
 
-        DGifSavedExtensionToGCB(mGif, i, &gcb);
+const GifByteType *GifDecoder::getFrameRaster(int frameNr) {
+    if (!mOptions.lazyDecode && !mCompressedFrames) {
+        return mGif->SavedImages[frameNr].RasterBits;
+    }
 
-        // timing
-        mDurationMs += getDelayMs(gcb);
+    // 命中缓存直接返回, 否则淘汰最久未使用的一项
+    RasterCacheEntry *victim = NULL;
+    for (size_t i = 0; i < mRasterCache.size(); i++) {
+        RasterCacheEntry &entry = mRasterCache[i];
+        if (entry.frameNr == frameNr) {
+            entry.lastUse = ++mRasterCacheClock;
+            return entry.raster;
+        }
+        if (!victim || entry.lastUse < victim->lastUse) {
+            victim = &entry;
+        }
+    }
+    if (mRasterCache.size() < (size_t) max(mOptions.rasterCacheSize, 1)) {
+        RasterCacheEntry entry = {-1, 0, NULL, 0};
+        mRasterCache.push_back(entry);
+        victim = &mRasterCache.back();
+    }
 
-        // preserve logic
-        mPreservedFrames[i] = false;
-        mRestoringFrames[i] = -1;
-        if (gcb.DisposalMode == DISPOSE_PREVIOUS && lastUnclearedFrame >= 0) {
-            mPreservedFrames[lastUnclearedFrame] = true;
-            mRestoringFrames[i] = lastUnclearedFrame;
+    const GifImageDesc &imageDesc = mGif->SavedImages[frameNr].ImageDesc;
+    size_t size = (size_t) imageDesc.Width * imageDesc.Height;
+    victim->frameNr = -1;
+    if (victim->capacity < size) {
+        DecoderPool::get().recycleBuffer(victim->raster, victim->capacity);
+        victim->raster = (GifByteType *) DecoderPool::get().takeBuffer(size);
+        victim->capacity = victim->raster ? size : 0;
+        if (!victim->raster) {
+            ALOGE("Out of memory while decoding frame %d", frameNr);
+            return NULL;
         }
-        if (!willBeCleared(gcb)) {
-            lastUnclearedFrame = i;
+    }
+    victim->lastUse = ++mRasterCacheClock;
+    if (!decodeFrameRaster(frameNr, victim->raster)) {
+        ALOGW("Gif decode frame %d failed, error %d", frameNr, mGif->Error);
+        return NULL;
+    }
+    victim->frameNr = frameNr;
+    return victim->raster;
+}
+
+const GifDecoder::PaletteLut *GifDecoder::getFrameLut(int frameNr, const ColorMapObject *cmap,
+                                                      int transparent) {
+    int index = mFrameLuts[frameNr];
+    if (index >= 0) {
+        return mPaletteLuts[index];
+    }
+    // 多帧共用全局色表时, 只建立一次查找表
+    for (size_t i = 0; i < mPaletteLuts.size(); i++) {
+        if (mPaletteLuts[i]->cmap == cmap && mPaletteLuts[i]->transparent == transparent) {
+            mFrameLuts[frameNr] = (int) i;
+            return mPaletteLuts[i];
+        }
+    }
+    PaletteLut *lut = new PaletteLut;
+    lut->cmap = cmap;
+    lut->transparent = transparent;
+    for (int i = 0; i < 256; i++) {
+        lut->colors[i] = i != transparent && i < cmap->ColorCount
+                         ? gifColorToColor8888(cmap->Colors[i]) : TRANSPARENT;
+        lut->colors565[i] = color8888To565(lut->colors[i]);
+    }
+    mFrameLuts[frameNr] = (int) mPaletteLuts.size();
+    mPaletteLuts.push_back(lut);
+    return lut;
+}
+
+void GifDecoder::init() {
+    if (!mGif) {
+        ALOGW("Gif load failed");
+        DGifCloseFile(mGif, NULL);
+        releaseProgressiveStream();
+        return;
+    }
+    DGifSetLZWEngine(mGif, mOptions.lzwEngine);
+    DGifSetArena(mGif, mOptions.arena);
+    if (mProgressiveStream) {
+        // 渐进解码只读到第一帧, 其余帧由 decodeMoreFrames 读取
+        mComplete = false;
+        mGif->ExtensionBlocks = NULL;
+        mGif->ExtensionBlockCount = 0;
+        if (readFrames(1) <= 0) {
+            ALOGW("Gif read first frame failed");
+            DGifCloseFile(mGif, NULL);
+            mGif = NULL;
+            return;
+        }
+    } else {
+        // lazyDecode 和 justDecodeInfo 模式只扫描记录结构, 不解压任何一帧;
+        // compressedFrames 模式和有预算时也先扫描, 之后再截取或解压.
+        // 并行解压需要回到每一帧的 LZW 数据, 只用于内存中的数据源
+        const bool parallel = decodesInParallel() && !hasMemoryBudget()
+                              && DGifGetMemory(mGif, NULL);
+        int result = mOptions.lazyDecode || mOptions.justDecodeInfo || mOptions.compressedFrames
+                     || hasMemoryBudget() || parallel ? DGifScan(mGif, &mFrameIndex)
+                                                      : DGifSlurp(mGif);
+        if (result != GIF_OK || (parallel && !decodeAllFrames())) {
+            ALOGW("Gif slurp failed");
+            DGifCloseFile(mGif, NULL);
+            mGif = NULL;
+            return;
+        }
+        if (hasMemoryBudget() && !applyMemoryBudget()) {
+            ALOGW("Gif decode frames failed");
+            DGifCloseFile(mGif, NULL);
+            mGif = NULL;
+            return;
+        }
+        // 在解压之后发布, 帧的透明度与不设预算时一样按像素判断
+        publishFrames(mGif->ImageCount);
+        if (mOptions.compressedFrames && !mOptions.lazyDecode && !mOptions.justDecodeInfo
+            && !captureCompressedFrames()) {
+            ALOGW("Gif keep compressed frames failed");
+            DGifCloseFile(mGif, NULL);
+            mGif = NULL;
+            return;
+        }
+        if (!mOptions.lazyDecode) {
+            // 像素已全部解压到 SavedImages 或截取了 LZW 数据, 之后不再读取数据源
+            if (!mOptions.compressedFrames) {
+                DGifFreeScratch(mGif);
+            }
+            delete mSourceStream;
+            mSourceStream = NULL;
+            free(mSourceCopy);
+            mSourceCopy = NULL;
+            mSourceCopySize = 0;
         }
     }
 
 #if GIF_DEBUG
     ALOGI("GifDecoder created with size [%d, %d], frames is %d, duration is %ld",
-          mGif->SWidth, mGif->SHeight, mGif->ImageCount, mDurationMs);
-    for (int i = 0; i < mGif->ImageCount; i++) {
-        DGifSavedExtensionToGCB(mGif, i, &gcb);
+          mGif->SWidth, mGif->SHeight, mGif->ImageCount, mDurationMs.load());
+    for (int i = 0; i < mFrameCount; i++) {
         LOGE("Frame %d - must preserve %d, restore point %d, trans color %d",
-             i, mPreservedFrames[i], mRestoringFrames[i], gcb.TransparentColor);
+             i, mPreservedFrames[i], mRestoringFrames[i], mFrameTransparents[i]);
     }
 #endif
 
+    // 有帧时背景色在发布第 0 帧时解析
+    if (mFrameCount == 0) {
+        initBackgroundColor(true);
+    }
+
+    // mark init success
+    mHasInit = true;
+}
+
+void GifDecoder::initBackgroundColor(bool firstFrameOpaque) {
     // 解析 GIF 的背景色
     const ColorMapObject *cmap = mGif->SColorMap;
     if (cmap) {
         // calculate bg color
-        GraphicsControlBlock gcb;
-        DGifSavedExtensionToGCB(mGif, 0, &gcb);
-        if (gcb.TransparentColor == NO_TRANSPARENT_COLOR
-            && mGif->SBackGroundColor < cmap->ColorCount) {
+        if (firstFrameOpaque && mGif->SBackGroundColor < cmap->ColorCount) {
             // 获取 GIF 的背景颜色
             mBgColor = gifColorToColor8888(cmap->Colors[mGif->SBackGroundColor]);
         }
     }
+}
 
-    // mark init success
-    mHasInit = true;
+// 将逐帧数组扩容到 capacity, 保留前 size 项
+template<typename T>
+static void growFrameArray(T *&array, int size, int capacity) {
+    T *newArray = new T[capacity];
+    for (int i = 0; i < size; i++) {
+        newArray[i] = array[i];
+    }
+    delete[] array;
+    array = newArray;
+}
+
+void GifDecoder::publishFrames(int frameCount) {
+    const int oldCount = mFrameCount;
+    if (frameCount > mFrameCapacity) {
+        const int capacity = max(frameCount, mFrameCapacity * 2);
+        growFrameArray(mPreservedFrames, oldCount, capacity);
+        growFrameArray(mRestoringFrames, oldCount, capacity);
+        growFrameArray(mFrameLuts, oldCount, capacity);
+        growFrameArray(mCarriedPreserves, oldCount, capacity);
+        growFrameArray(mIndependentFrames, oldCount, capacity);
+        growFrameArray(mLastIndependentFrames, oldCount, capacity);
+        growFrameArray(mFrameDelays, oldCount, capacity);
+        growFrameArray(mFrameDisposals, oldCount, capacity);
+        growFrameArray(mFrameTransparents, oldCount, capacity);
+        growFrameArray(mFrameFlags, oldCount, capacity);
+        mFrameCapacity = capacity;
+    }
+    for (int i = oldCount; i < frameCount; i++) {
+        addFrameInfo(i);
+    }
+    mFrameCount = frameCount;
+}
+
+void GifDecoder::addFrameInfo(int frameNr) {
+    const SavedImage &image = mGif->SavedImages[frameNr];
+
+    // find the loop extension pair
+    for (int j = 0; (j + 1) < image.ExtensionBlockCount; j++) {
+        ExtensionBlock *eb1 = image.ExtensionBlocks + j;
+        ExtensionBlock *eb2 = image.ExtensionBlocks + j + 1;
+        if (eb1->Function == APPLICATION_EXT_FUNC_CODE
+            // look for "NETSCAPE2.0" app extension
+            && eb1->ByteCount == 11
+            && !memcmp((const char *) (eb1->Bytes), "NETSCAPE2.0", 11)
+            // verify extension contents and get loop count
+            && eb2->Function == CONTINUE_EXT_FUNC_CODE
+            && eb2->ByteCount == 3
+            && eb2->Bytes[0] == 1) {
+            mLoopCount = (int) (eb2->Bytes[2] << 8) + (int) (eb2->Bytes[1]);
+        }
+    }
+
+    GraphicsControlBlock gcb;
+    if (mFrameIndex) {
+        gcb = mFrameIndex[frameNr].GCB;
+    } else {
+        DGifSavedExtensionToGCB(mGif, frameNr, &gcb);
+    }
+
+    const bool opaque = gcb.TransparentColor == NO_TRANSPARENT_COLOR;
+    mFrameDelays[frameNr] = getDelayMs(gcb);
+    mFrameDisposals[frameNr] = (unsigned char) gcb.DisposalMode;
+    mFrameTransparents[frameNr] = (short) gcb.TransparentColor;
+    mFrameFlags[frameNr] = opaque ? FRAME_OPAQUE : 0;
+    if (opaque && frameNr > 0
+        && checkIfCover(image.ImageDesc, mGif->SavedImages[frameNr - 1].ImageDesc)) {
+        mFrameFlags[frameNr] |= FRAME_COVERS_PREVIOUS;
+    }
+    if (hasOnlyColorMapIndices(frameNr)) {
+        mFrameFlags[frameNr] |= FRAME_IN_COLOR_MAP;
+    }
+    if (frameNr == 0) {
+        // 此时 mFrameCount 仍为 0, 以第 0 帧自己的 GCB 为准
+        initBackgroundColor(opaque);
+    }
+    // 需要在更新 mLastUnclearedFrame 之前, 此时 mUnclearedTransparentArea 对应上一帧恢复到的帧
+    updateTransparentArea(frameNr);
+
+    // timing
+    mDurationMs += mFrameDelays[frameNr];
+
+    // preserve logic
+    mPreservedFrames[frameNr] = false;
+    mRestoringFrames[frameNr] = -1;
+    mFrameLuts[frameNr] = -1;
+    if (gcb.DisposalMode == DISPOSE_PREVIOUS && mLastUnclearedFrame >= 0) {
+        mPreservedFrames[mLastUnclearedFrame] = true;
+        mRestoringFrames[frameNr] = mLastUnclearedFrame;
+    }
+    if (!willBeCleared(gcb.DisposalMode)) {
+        mLastUnclearedFrame = frameNr;
+        mUnclearedTransparentArea = mTransparentArea;
+    }
+
+    // 不透明且覆盖整个画布的帧, 或上一帧处置后整个画布被清空, 绘制时不需要之前的画布.
+    // 越界索引保留之前的画布, 只有确认没有越界索引的帧才能清空画布后从这里开始;
+    // 覆盖上一帧时顺序播放跳过上一帧的处置, 越界索引保留的是上一帧的像素
+    const GifImageDesc screen = {0, 0, mGif->SWidth, mGif->SHeight, false, NULL};
+    const bool inColorMap = mFrameFlags[frameNr] & FRAME_IN_COLOR_MAP;
+    mIndependentFrames[frameNr] = frameNr == 0
+                                  || (opaque && checkIfCover(image.ImageDesc, screen)
+                                      && inColorMap)
+                                  || (mFrameDisposals[frameNr - 1] == DISPOSE_BACKGROUND
+                                      && checkIfCover(mGif->SavedImages[frameNr - 1].ImageDesc,
+                                                      screen)
+                                      && (inColorMap
+                                          || !(mFrameFlags[frameNr] & FRAME_COVERS_PREVIOUS)));
+
+    // 帧 j 恢复保留帧 r 时, (r, j] 之间的每一帧绘制之前都需要 r 的数据,
+    // 关键帧需要连同保留帧一起保存, 独立帧也不能从这些帧开始合成.
+    // r 随 j 单调不减, 遇到已标记的帧时, 更早的帧也都已标记
+    mCarriedPreserves[frameNr] = -1;
+    const int restoring = mRestoringFrames[frameNr];
+    int firstCarried = frameNr;
+    for (int k = frameNr; restoring >= 0 && k > restoring && mCarriedPreserves[k] < 0; k--) {
+        mCarriedPreserves[k] = restoring;
+        mIndependentFrames[k] = false;
+        firstCarried = k;
+    }
+    if (firstCarried < frameNr) {
+        // 渐进解码时这些帧可能已经绘制过, 之前保存的关键帧缺少保留缓冲
+        clearKeyframes();
+    }
+    for (int k = firstCarried; k <= frameNr; k++) {
+        mLastIndependentFrames[k] = mIndependentFrames[k] ? k : mLastIndependentFrames[k - 1];
+    }
+}
+
+// 读取一个扩展记录, 与 DGifSlurp 一样暂存在 GifFile->ExtensionBlocks, 归属于之后的图像
+static bool readExtensionRecord(GifFileType *gif) {
+    int function;
+    GifByteType *data;
+    if (DGifGetExtension(gif, &function, &data) == GIF_ERROR) {
+        return false;
+    }
+    if (data && DGifAddExtensionBlock(gif, &gif->ExtensionBlockCount, &gif->ExtensionBlocks,
+                                      function, data[0], &data[1]) == GIF_ERROR) {
+        return false;
+    }
+    for (;;) {
+        if (DGifGetExtensionNext(gif, &data) == GIF_ERROR) {
+            return false;
+        }
+        if (!data) {
+            return true;
+        }
+        if (DGifAddExtensionBlock(gif, &gif->ExtensionBlockCount, &gif->ExtensionBlocks,
+                                  CONTINUE_EXT_FUNC_CODE, data[0], &data[1]) == GIF_ERROR) {
+            return false;
+        }
+    }
+}
+
+int GifDecoder::readFrames(int maxFrames) {
+    int count = 0;
+    bool failed = false;
+    while (!mComplete && count < maxFrames && !failed) {
+        GifRecordType recordType;
+        if (DGifGetRecordType(mGif, &recordType) == GIF_ERROR) {
+            failed = true;
+            break;
+        }
+        switch (recordType) {
+            case IMAGE_DESC_RECORD_TYPE: {
+                // DGifGetImageDesc 会重新分配 SavedImages, 不能与 drawFrame 同时进行
+                bool ok;
+                {
+                    std::lock_guard<std::mutex> lock(mLock);
+                    ok = DGifGetImageDesc(mGif) != GIF_ERROR;
+                }
+                // 新的一帧尚未发布, drawFrame 不会访问它, 解压时不必持有锁
+                SavedImage *sp = ok ? &mGif->SavedImages[mGif->ImageCount - 1] : NULL;
+                if (ok && (sp->ImageDesc.Width <= 0 || sp->ImageDesc.Height <= 0
+                           || sp->ImageDesc.Width > INT_MAX / sp->ImageDesc.Height)) {
+                    ok = false;
+                }
+                if (ok) {
+                    sp->RasterBits = DGifAllocRaster(
+                            mGif, (size_t) sp->ImageDesc.Width * sp->ImageDesc.Height);
+                    ok = sp->RasterBits && DGifGetImage(mGif, sp->RasterBits) == GIF_OK;
+                }
+                if (!ok) {
+                    failed = true;
+                    break;
+                }
+                sp->ExtensionBlocks = mGif->ExtensionBlocks;
+                sp->ExtensionBlockCount = mGif->ExtensionBlockCount;
+                mGif->ExtensionBlocks = NULL;
+                mGif->ExtensionBlockCount = 0;
+
+                std::lock_guard<std::mutex> lock(mLock);
+                publishFrames(mGif->ImageCount);
+                count++;
+                break;
+            }
+            case EXTENSION_RECORD_TYPE:
+                failed = !readExtensionRecord(mGif);
+                break;
+            case TERMINATE_RECORD_TYPE:
+                mComplete = true;
+                break;
+            default:
+                break;
+        }
+    }
+    if (failed) {
+        // 数据损坏或被截断, 已读出的帧仍然可以播放
+        ALOGW("Gif progressive read failed after %d frames, error %d",
+              mFrameCount.load(), mGif->Error);
+        mComplete = true;
+    }
+    if (mComplete) {
+        DGifFreeScratch(mGif);
+        releaseProgressiveStream();
+    }
+    return failed ? -1 : count;
+}
+
+int GifDecoder::decodeMoreFrames(int maxFrames) {
+    if (!mHasInit || mComplete) {
+        return 0;
+    }
+    const int count = readFrames(maxFrames);
+    // 预取线程只合成已读出的帧
+    {
+        std::lock_guard<std::mutex> lock(mPrefetchLock);
+        if (mPrefetcher) {
+            mPrefetcher->onFramesPublished();
+        }
+    }
+    return count;
+}
+
+bool GifDecoder::isFramePixelOpaque(int frameNr) const {
+    const SavedImage &image = mGif->SavedImages[frameNr];
+    const ColorMapObject *cmap = image.ImageDesc.ColorMap ? image.ImageDesc.ColorMap
+                                                          : mGif->SColorMap;
+    if (!cmap) {
+        // 没有色表的帧不会被绘制
+        return false;
+    }
+    const int transparent = mFrameTransparents[frameNr];
+    if (!image.RasterBits) {
+        return transparent == NO_TRANSPARENT_COLOR;
+    }
+    // 声明了透明色但没有使用的帧也是不透明的; 越界索引与透明色一样保留原有的像素
+    bool seeThrough[256];
+    for (int i = 0; i < 256; i++) {
+        seeThrough[i] = i == transparent || i >= cmap->ColorCount;
+    }
+    const size_t count = (size_t) image.ImageDesc.Width * image.ImageDesc.Height;
+    for (size_t i = 0; i < count; i++) {
+        if (seeThrough[image.RasterBits[i]]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool GifDecoder::hasOnlyColorMapIndices(int frameNr) const {
+    const SavedImage &image = mGif->SavedImages[frameNr];
+    const ColorMapObject *cmap = image.ImageDesc.ColorMap ? image.ImageDesc.ColorMap
+                                                          : mGif->SColorMap;
+    if (!cmap) {
+        return false;
+    }
+    if (cmap->ColorCount >= 256) {
+        return true;
+    }
+    if (image.RasterBits) {
+        const size_t count = (size_t) image.ImageDesc.Width * image.ImageDesc.Height;
+        for (size_t i = 0; i < count; i++) {
+            if (image.RasterBits[i] >= cmap->ColorCount) {
+                return false;
+            }
+        }
+        return true;
+    }
+    // 像素尚未解压: LZW 的最小码长不超过色表的位数时, 解压出的索引不会超出色表
+    size_t size;
+    const GifByteType *data = mFrameIndex ? DGifGetMemory(mGif, &size) : NULL;
+    if (data && mFrameIndex[frameNr].CodeOffset < (long) size) {
+        const int codeSize = data[mFrameIndex[frameNr].CodeOffset];
+        return codeSize <= 8 && (1 << codeSize) <= cmap->ColorCount;
+    }
+    return false;
+}
+
+// 帧矩形限制在画布内的部分
+static DirtyRect getScreenRect(const GifImageDesc &imageDesc, int screenWidth, int screenHeight) {
+    DirtyRect rect = {min(imageDesc.Left, screenWidth), min(imageDesc.Top, screenHeight),
+                      min(imageDesc.Left + imageDesc.Width, screenWidth),
+                      min(imageDesc.Top + imageDesc.Height, screenHeight)};
+    return rect;
+}
+
+static bool isEmptyRect(const DirtyRect &rect) {
+    return rect.left >= rect.right || rect.top >= rect.bottom;
+}
+
+static void addTransparentRect(TransparentArea &area, const DirtyRect &rect) {
+    if (isEmptyRect(rect)) {
+        return;
+    }
+    if (isEmptyRect(area.rect)) {
+        area.rect = rect;
+        area.single = true;
+        return;
+    }
+    if (memcmp(&area.rect, &rect, sizeof(DirtyRect)) != 0) {
+        unionDirtyRect(area.rect, rect);
+        area.single = false;
+    }
+}
+
+/**
+ * 以 imageDesc 为区域的填充或不透明帧是否能盖住 area, 对任意 inSampleSize 成立.
+ * 采样后区域的起点向下取整, 宽度向上取整, 包含关系不一定保持: 只有起点相同 (area 恰好是一个矩形)
+ * 或起点为 0 时, 采样后的区域仍然包含 area 的每一部分
+ */
+static bool coversTransparentArea(const GifImageDesc &imageDesc,
+                                  const TransparentArea &area) {
+    const DirtyRect &rect = area.rect;
+    if (isEmptyRect(rect)) {
+        return true;
+    }
+    return imageDesc.Left <= rect.left && rect.right <= imageDesc.Left + imageDesc.Width
+           && imageDesc.Top <= rect.top && rect.bottom <= imageDesc.Top + imageDesc.Height
+           && (imageDesc.Left == 0 || (area.single && imageDesc.Left == rect.left))
+           && (imageDesc.Top == 0 || (area.single && imageDesc.Top == rect.top));
+}
+
+void GifDecoder::updateTransparentArea(int frameNr) {
+    const GifImageDesc &imageDesc = mGif->SavedImages[frameNr].ImageDesc;
+    const int width = mGif->SWidth;
+    const int height = mGif->SHeight;
+    const GifImageDesc screen = {0, 0, width, height, false, NULL};
+    const TransparentArea empty = {{0, 0, 0, 0}, false};
+    const TransparentArea whole = {{0, 0, width, height}, true};
+
+    // 与 drawFrame 相同: 第 0 帧之前填充背景色; 不透明且覆盖画布的帧可能作为独立帧,
+    // 之前的画布清为透明; 其余帧之前先处置上一帧
+    if (frameNr == 0) {
+        mTransparentArea = isOpaque() ? empty : whole;
+    } else if ((mFrameFlags[frameNr] & FRAME_OPAQUE) && checkIfCover(imageDesc, screen)) {
+        mTransparentArea = whole;
+    } else if (!(mFrameFlags[frameNr] & FRAME_COVERS_PREVIOUS)) {
+        const GifImageDesc &prevDesc = mGif->SavedImages[frameNr - 1].ImageDesc;
+        switch (mFrameDisposals[frameNr - 1]) {
+            case DISPOSE_BACKGROUND:
+                addTransparentRect(mTransparentArea, getScreenRect(prevDesc, width, height));
+                break;
+            case DISPOSE_PREVIOUS:
+                if (mRestoringFrames[frameNr - 1] >= 0) {
+                    mTransparentArea = mUnclearedTransparentArea;
+                } else if (!isOpaque()) {
+                    addTransparentRect(mTransparentArea, getScreenRect(prevDesc, width, height));
+                } else if (coversTransparentArea(prevDesc, mTransparentArea)) {
+                    mTransparentArea = empty;
+                }
+                break;
+        }
+    }
+
+    if (!isEmptyRect(mTransparentArea.rect) && coversTransparentArea(imageDesc, mTransparentArea)
+        && isFramePixelOpaque(frameNr)) {
+        mTransparentArea = empty;
+    }
+    if (isEmptyRect(mTransparentArea.rect)) {
+        mFrameFlags[frameNr] |= FRAME_CANVAS_OPAQUE;
+    } else {
+        mAnimationOpaque = false;
+    }
+}
+
+void GifDecoder::releaseProgressiveStream() {
+    if (mGif) {
+        mGif->UserData = NULL;
+    }
+    delete mProgressiveStream;
+    mProgressiveStream = NULL;
 }
 
 GifDecoder::~GifDecoder() {
+    // 预取线程仍在使用解码器, 最先停止
+    stopPrefetch();
     if (mGif) {
         DGifCloseFile(mGif, NULL);
+        mGif = NULL;
     }
     delete[] mPreservedFrames;
     delete[] mRestoringFrames;
+    DecoderPool::get().recycleBuffer(mPreserveBuffer, mPreserveBufferBytes);
+    delete[] mCarriedPreserves;
+    delete[] mIndependentFrames;
+    delete[] mLastIndependentFrames;
+    clearKeyframes();
+    delete[] mFrameLuts;
+    delete[] mFrameDelays;
+    delete[] mFrameDisposals;
+    delete[] mFrameTransparents;
+    delete[] mFrameFlags;
+    for (size_t i = 0; i < mPaletteLuts.size(); i++) {
+        delete mPaletteLuts[i];
+    }
+    free(mFrameIndex);
+    for (size_t i = 0; i < mRasterCache.size(); i++) {
+        DecoderPool::get().recycleBuffer(mRasterCache[i].raster, mRasterCache[i].capacity);
+    }
+    free(mSourceCopy);
+    free(mCompressedFrames);
+    delete[] mCompressedOffsets;
+    delete mSourceStream;
+    releaseProgressiveStream();
     ALOGE("GifDecoder release.");
 }
 
+int GifDecoder::getBandCount(int rows, int width) const {
+    const int threads = resolveThreadCount(mOptions.compositeThreads);
+    if (threads <= 1 || (long) rows * width < PARALLEL_COMPOSITE_MIN_PIXELS) {
+        return 1;
+    }
+    return min(threads, rows);
+}
+
+void GifDecoder::forEachBand(int rows, int width,
+                             const std::function<void(int, int, int)> &task) const {
+    const int bands = getBandCount(rows, width);
+    if (bands <= 1) {
+        task(0, 0, rows);
+        return;
+    }
+    WorkerPool::get().run(bands, bands, [&](int band) {
+        task(band, (int) ((long) rows * band / bands), (int) ((long) rows * (band + 1) / bands));
+    });
+}
+
+void GifDecoder::fillCanvas(const OutputCanvas &canvas, int width, int height, Color8888 color) {
+    forEachBand(height, width, [&](int, int begin, int end) {
+        for (int y = begin; y < end; y++) {
+            fillLine(canvas.at(0, y), canvas.format, color, width);
+        }
+    });
+}
+
+void GifDecoder::fillFrameRect(const OutputCanvas &canvas, const GifImageDesc &imageDesc,
+                               int maxWidth, int maxHeight, Color8888 color, int inSampleSize) {
+    uint8_t *dst = canvas.at(imageDesc.Left / inSampleSize, imageDesc.Top / inSampleSize);
+    GifWord copyWidth, copyHeight;
+    getCopySize(imageDesc, maxWidth, maxHeight, inSampleSize, copyWidth, copyHeight);
+    if (copyWidth <= 0) {
+        return;
+    }
+    forEachBand(copyHeight, copyWidth, [&](int, int begin, int end) {
+        for (int y = begin; y < end; y++) {
+            fillLine(dst + canvas.rowBytes * y, canvas.format, color, copyWidth);
+        }
+    });
+}
+
 long
-GifDecoder::drawFrame(int frameNr, Color8888 *outputPtr, int outputPixelStride, int previousFrameNr,
-                      int inSampleSize) {
-    if (!mHasInit) {
+GifDecoder::drawFrame(int frameNr, void *outputPtr, PixelFormat format, int outputPixelStride,
+                      int previousFrameNr, int inSampleSize, DirtyRect *dirtyRect) {
+    if (dirtyRect) {
+        dirtyRect->left = dirtyRect->top = dirtyRect->right = dirtyRect->bottom = 0;
+    }
+    if (!mHasInit || mOptions.justDecodeInfo) {
+        return -1;
+    }
+
+    // 渐进解码时 decodeMoreFrames 可能在其他线程发布新帧
+    std::lock_guard<std::mutex> lock(mLock);
+    if (frameNr < 0 || frameNr >= mFrameCount) {
         return -1;
     }
 
@@ -186,15 +1163,17 @@ GifDecoder::drawFrame(int frameNr, Color8888 *outputPtr, int outputPixelStride,
 
     const int requestedWidth = mGif->SWidth / inSampleSize;
     const int requestedHeight = mGif->SHeight / inSampleSize;
-
-    GraphicsControlBlock gcb;
+    const GifImageDesc screen = {0, 0, mGif->SWidth, mGif->SHeight, false, NULL};
+    const OutputCanvas canvas = {(uint8_t *) outputPtr,
+                                 (size_t) outputPixelStride * getBytesPerPixel(format), format};
 
     int start = max(previousFrameNr + 1, 0);
 
     for (int i = max(start - 1, 0); i < frameNr; i++) {
         int neededPreservedFrame = getRestoringFrame(i);
-        if (neededPreservedFrame >= 0 &&
-            (mPreserveBufferFrame != neededPreservedFrame)) {
+        if (neededPreservedFrame >= 0 && (mPreserveBufferFrame != neededPreservedFrame
+                                          || mPreserveSampleSize != inSampleSize
+                                          || mPreserveFormat != format)) {
 #if GIF_DEBUG
             ALOGD("frame %d needs frame %d preserved, but %d is currently, so drawing from scratch",
                     i, neededPreservedFrame, mPreserveBufferFrame);
@@ -203,53 +1182,72 @@ GifDecoder::drawFrame(int frameNr, Color8888 *outputPtr, int outputPixelStride,
         }
     }
 
+    // 最近的独立帧比 start 更接近 frameNr 时, 从独立帧开始合成
+    int independentFrame = -1;
+    if (mLastIndependentFrames[frameNr] > start) {
+        start = independentFrame = mLastIndependentFrames[frameNr];
+    }
+
+    // 关键帧比 start 更接近 frameNr 时, 从关键帧开始合成
+    int resumeFrame = -1;
+    if (mOptions.keyframeInterval > 0) {
+        resumeFrame = restoreKeyframe(frameNr, start, canvas, inSampleSize);
+        if (resumeFrame >= 0) {
+            start = resumeFrame;
+        }
+    }
+
     for (int i = start; i <= frameNr; i++) {
-        DGifSavedExtensionToGCB(gif, i, &gcb);
         const SavedImage &frame = gif->SavedImages[i];
 
 #if GIF_DEBUG
-        bool frameOpaque = gcb.TransparentColor == NO_TRANSPARENT_COLOR;
+        bool frameOpaque = mFrameFlags[i] & FRAME_OPAQUE;
         ALOGD("producing frame %d, drawing frame %d (opaque %d, disp %d, del %d)",
-                frameNr, i, frameOpaque, gcb.DisposalMode, gcb.DelayTime);
+                frameNr, i, frameOpaque, mFrameDisposals[i], mFrameDelays[i]);
 #endif
-        if (i == 0) {
+        if (i == start && (i == resumeFrame || i == independentFrame || i == 0)) {
+            // 整个画布重新生成
+            addDirtyRect(dirtyRect, screen, requestedWidth, requestedHeight, inSampleSize);
+        }
+        if (i == resumeFrame) {
+            // 画布和保留缓冲已从关键帧恢复
+        } else if (i == independentFrame) {
+            // 独立帧: 之前的画布要么被完全覆盖, 要么已被上一帧的处置清空
+            fillCanvas(canvas, requestedWidth, requestedHeight, TRANSPARENT);
+        } else if (i == 0) {
             // clear bitmap
-            Color8888 bgColor = mBgColor;
-            for (int y = 0; y < requestedHeight; y++) {
-                for (int x = 0; x < requestedWidth; x++) {
-                    outputPtr[y * outputPixelStride + x] = bgColor;
-                }
-            }
+            fillCanvas(canvas, requestedWidth, requestedHeight, mBgColor);
         } else {
-            GraphicsControlBlock prevGcb;
-            DGifSavedExtensionToGCB(gif, i - 1, &prevGcb);
             const SavedImage &prevFrame = gif->SavedImages[i - 1];
-            bool prevFrameDisposed = willBeCleared(prevGcb);
-
-            bool newFrameOpaque = gcb.TransparentColor == NO_TRANSPARENT_COLOR;
-            bool prevFrameCompletelyCovered = newFrameOpaque
-                                              && checkIfCover(frame.ImageDesc,
-                                                              prevFrame.ImageDesc);
+            const int prevDisposal = mFrameDisposals[i - 1];
+            bool prevFrameCompletelyCovered = mFrameFlags[i] & FRAME_COVERS_PREVIOUS;
 
-            if (prevFrameDisposed && !prevFrameCompletelyCovered) {
-                switch (prevGcb.DisposalMode) {
+            if (willBeCleared(prevDisposal) && !prevFrameCompletelyCovered) {
+                switch (prevDisposal) {
                     case DISPOSE_BACKGROUND: {
                         // 填充背景色
-                        Color8888 *dst = outputPtr + (prevFrame.ImageDesc.Left / inSampleSize) +
-                                         (prevFrame.ImageDesc.Top / inSampleSize) *
-                                         outputPixelStride;
-                        GifWord copyWidth, copyHeight;
-                        getCopySize(prevFrame.ImageDesc, requestedWidth, requestedHeight, copyWidth,
-                                    copyHeight);
-                        for (; copyHeight > 0; copyHeight--) {
-                            setLineColor(dst, TRANSPARENT, copyWidth);
-                            dst += outputPixelStride;
-                        }
+                        fillFrameRect(canvas, prevFrame.ImageDesc, requestedWidth,
+                                      requestedHeight, TRANSPARENT, inSampleSize);
+                        addDirtyRect(dirtyRect, prevFrame.ImageDesc, requestedWidth,
+                                     requestedHeight, inSampleSize);
                         break;
                     }
                     case DISPOSE_PREVIOUS: {
-                        // 从上一帧中恢复数据
-                        restorePreserveBuffer(outputPtr, outputPixelStride, inSampleSize);
+                        if (getRestoringFrame(i - 1) >= 0) {
+                            // 从上一帧中恢复数据, 保留之后只有这些帧的区域可能被改动过
+                            restorePreserveBuffer(canvas, inSampleSize);
+                            for (int j = getRestoringFrame(i - 1) + 1; j < i; j++) {
+                                addDirtyRect(dirtyRect, gif->SavedImages[j].ImageDesc,
+                                             requestedWidth, requestedHeight, inSampleSize);
+                            }
+                        } else {
+                            // 之前没有可恢复的帧, 恢复为初始的背景色.
+                            // 不能读取保留缓冲里其他帧的旧数据
+                            fillFrameRect(canvas, prevFrame.ImageDesc, requestedWidth,
+                                          requestedHeight, mBgColor, inSampleSize);
+                            addDirtyRect(dirtyRect, prevFrame.ImageDesc, requestedWidth,
+                                         requestedHeight, inSampleSize);
+                        }
                         break;
                     }
                 }
@@ -257,187 +1255,387 @@ GifDecoder::drawFrame(int frameNr, Color8888 *outputPtr, int outputPixelStride,
 
             if (getPreservedFrame(i - 1)) {
                 // 保存上一帧的数据
-                savePreserveBuffer(outputPtr, outputPixelStride, i - 1, inSampleSize);
+                savePreserveBuffer(canvas, i - 1, inSampleSize);
             }
         }
 
-        bool willBeCleared = gcb.DisposalMode == DISPOSE_BACKGROUND
-                             || gcb.DisposalMode == DISPOSE_PREVIOUS;
-        if (i == frameNr || !willBeCleared) {
+        if (mOptions.keyframeInterval > 0 && i > 0 && i % mOptions.keyframeInterval == 0) {
+            saveKeyframe(i, canvas, inSampleSize);
+        }
+
+        // 会被清除的帧不必绘制; 但下一帧覆盖这一帧时跳过处置, 下一帧的越界索引露出这一帧
+        const int nextFlags = i < frameNr ? mFrameFlags[i + 1] : 0;
+        const bool shownByNext = (nextFlags & FRAME_COVERS_PREVIOUS)
+                                 && !(nextFlags & FRAME_IN_COLOR_MAP);
+        if (i == frameNr || !willBeCleared(mFrameDisposals[i]) || shownByNext) {
             // 使用全局色表为默认色表
             const ColorMapObject *cmap = gif->SColorMap;
             // 若存在局部色表, 则使用局部色表
             if (frame.ImageDesc.ColorMap) {
                 cmap = frame.ImageDesc.ColorMap;
             }
-            if (cmap) {
+            const bool box = mOptions.boxFilter && inSampleSize > 1
+                             && inSampleSize <= BOX_FILTER_MAX_SAMPLE_SIZE;
+            // 不缓存帧像素时逐行解压并直接合成, 不经过整帧的索引像素
+            const bool direct = cmap && !box && composesDirectly();
+            // 获取当前帧的索引像素, lazyDecode 和 compressedFrames 模式下在这里解压
+            const unsigned char *src = cmap && !direct ? getFrameRaster(i) : NULL;
+            if (src || direct) {
                 // 填充当前帧的颜色
-                const unsigned char *src = frame.RasterBits;
-                Color8888 *dst = outputPtr + (frame.ImageDesc.Left / inSampleSize) +
-                                 (frame.ImageDesc.Top / inSampleSize) * outputPixelStride;
+                const int left = frame.ImageDesc.Left / inSampleSize;
+                const int top = frame.ImageDesc.Top / inSampleSize;
+                uint8_t *dst = canvas.at(left, top);
+                const PaletteLut *lut = getFrameLut(i, cmap, mFrameTransparents[i]);
                 GifWord copyWidth, copyHeight;
-                getCopySize(frame.ImageDesc, requestedWidth, requestedHeight, copyWidth,
-                            copyHeight);
-                for (; copyHeight > 0; copyHeight--) {
-                    copyLine(dst, src, cmap, gcb.TransparentColor, copyWidth, inSampleSize);
-                    src += frame.ImageDesc.Width * inSampleSize;
-                    dst += outputPixelStride;
+                getCopySize(frame.ImageDesc, requestedWidth, requestedHeight, inSampleSize,
+                            copyWidth, copyHeight);
+                if (direct) {
+                    // 出错时已解压的行保留在画布上
+                    compositeFrameRows(i, canvas, left, top, lut, copyWidth, copyHeight,
+                                       inSampleSize);
+                } else if (box && copyWidth > 0) {
+                    // 每个输出像素对应帧内从 (x, y) * inSampleSize 开始的块, 超出帧的部分不计
+                    const int srcWidth = min(copyWidth * inSampleSize, frame.ImageDesc.Width);
+                    const int srcHeight = frame.ImageDesc.Height;
+                    const size_t srcRowStep = (size_t) frame.ImageDesc.Width * inSampleSize;
+                    // 每一带使用各自的通道和与展开行
+                    const int bands = getBandCount(copyHeight, copyWidth);
+                    if (mBoxSums.size() < (size_t) bands * srcWidth * 4) {
+                        mBoxSums.resize((size_t) bands * srcWidth * 4);
+                    }
+                    // 块平均需要 8888 的画布像素, 其他格式先展开一行, 合成后再打包写回
+                    if (format != PIXEL_FORMAT_8888
+                        && mBoxLine.size() < (size_t) bands * copyWidth) {
+                        mBoxLine.resize((size_t) bands * copyWidth);
+                    }
+                    forEachBand(copyHeight, copyWidth, [&](int band, int begin, int end) {
+                        uint32_t *sums = &mBoxSums[(size_t) band * srcWidth * 4];
+                        for (int y = begin; y < end; y++) {
+                            uint8_t *row = dst + canvas.rowBytes * y;
+                            const int rows = min(inSampleSize, srcHeight - y * inSampleSize);
+                            Color8888 *line = format == PIXEL_FORMAT_8888
+                                              ? (Color8888 *) row
+                                              : &mBoxLine[(size_t) band * copyWidth];
+                            if (format != PIXEL_FORMAT_8888) {
+                                unpackLine(line, row, format, copyWidth);
+                            }
+                            compositeBoxLine(line, src + srcRowStep * y, frame.ImageDesc.Width,
+                                             rows, lut->colors, copyWidth, srcWidth,
+                                             inSampleSize, sums);
+                            if (format != PIXEL_FORMAT_8888) {
+                                packLine(row, format, line, copyWidth);
+                            }
+                        }
+                    });
+                } else if (copyWidth > 0) {
+                    const size_t srcRowStep = (size_t) frame.ImageDesc.Width * inSampleSize;
+                    forEachBand(copyHeight, copyWidth, [&](int, int begin, int end) {
+                        for (int y = begin; y < end; y++) {
+                            compositeFormatLine(dst + canvas.rowBytes * y, format,
+                                                src + srcRowStep * y, lut->colors,
+                                                lut->colors565, copyWidth, inSampleSize);
+                        }
+                    });
                 }
-            } else {
+                addDirtyRect(dirtyRect, frame.ImageDesc, requestedWidth, requestedHeight,
+                             inSampleSize);
+            } else if (!cmap) {
                 ALOGI("Color map not available, ignore this frame %d", frameNr);
             }
         }
     }
     // return last frame's delay
-    const int maxFrame = gif->ImageCount;
+    const int maxFrame = mFrameCount;
     const int lastFrame = (frameNr + maxFrame - 1) % maxFrame;
-    DGifSavedExtensionToGCB(gif, lastFrame, &gcb);
-    return getDelayMs(gcb);
+    return mFrameDelays[lastFrame];
 }
 
-void
-GifDecoder::restorePreserveBuffer(Color8888 *outputPtr, int outputPixelStride, int inSampleSize) {
+long GifDecoder::drawScaledFrame(int frameNr, void *outputPtr, PixelFormat format,
+                                 int outputPixelStride, int outputWidth, int outputHeight,
+                                 int previousFrameNr, DirtyRect *dirtyRect) {
+    if (dirtyRect) {
+        dirtyRect->left = dirtyRect->top = dirtyRect->right = dirtyRect->bottom = 0;
+    }
+    if (!mHasInit || mOptions.justDecodeInfo || outputWidth <= 0 || outputHeight <= 0) {
+        return -1;
+    }
+    // 整数倍的部分由采样完成, 剩余的比例在 1 到 2 之间 (两个方向比例不同时, 较小的一个)
+    const int inSampleSize = max(1, min(mGif->SWidth / outputWidth,
+                                        mGif->SHeight / outputHeight));
+    const int canvasWidth = mGif->SWidth / inSampleSize;
+    const int canvasHeight = mGif->SHeight / inSampleSize;
+    if (canvasWidth == outputWidth && canvasHeight == outputHeight) {
+        return drawFrame(frameNr, outputPtr, format, outputPixelStride, previousFrameNr,
+                         inSampleSize, dirtyRect);
+    }
+
+    std::lock_guard<std::mutex> scaleLock(mScaleLock);
+    if (mScaledSampleSize != inSampleSize) {
+        mScaledCanvas.assign((size_t) canvasWidth * canvasHeight, TRANSPARENT);
+        mScaledSampleSize = inSampleSize;
+        mScaledFrame = mScaledPrevFrame = -1;
+    }
+    mScaler.setSize(canvasWidth, canvasHeight, outputWidth, outputHeight);
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mScaledBytes = mScaledCanvas.size() * sizeof(Color8888) + mScaler.getMemoryBytes();
+    }
+
+    // 画布只能向后推进, 倒退时从头合成
+    const int canvasFrame = mScaledFrame <= frameNr ? mScaledFrame : -1;
+    DirtyRect changed;
+    const long delay = drawFrame(frameNr, mScaledCanvas.data(), canvasWidth, canvasFrame,
+                                 inSampleSize, &changed);
+    if (delay < 0) {
+        mScaledFrame = mScaledPrevFrame = -1;
+        return delay;
+    }
+
+    // 输出中原有的帧与画布之前的帧相同时只需更新 changed; 与再之前的帧相同时 (双缓冲),
+    // 还需加上上一次绘制改动的区域; 否则整个输出重新缩放
+    DirtyRect region = changed;
+    if (previousFrameNr < 0 || previousFrameNr != canvasFrame) {
+        if (previousFrameNr >= 0 && canvasFrame >= 0 && previousFrameNr == mScaledPrevFrame) {
+            unionDirtyRect(region, mScaledLastChanged);
+        } else {
+            region.left = region.top = 0;
+            region.right = canvasWidth;
+            region.bottom = canvasHeight;
+        }
+    }
+    if (frameNr != canvasFrame) {
+        mScaledPrevFrame = canvasFrame;
+        mScaledLastChanged = changed;
+        mScaledFrame = frameNr;
+    }
+
+    mScaler.mapRect(region.left, region.top, region.right, region.bottom);
+    mScaler.scale(mScaledCanvas.data(), canvasWidth, outputPtr, format, outputPixelStride,
+                  region.left, region.top, region.right, region.bottom);
+    if (dirtyRect) {
+        *dirtyRect = region;
+    }
+    return delay;
+}
+
+bool GifDecoder::startPrefetch(const PrefetchOptions &options) {
+    stopPrefetch();
+    if (!mHasInit || mOptions.justDecodeInfo || options.ringSize <= 0
+        || options.firstFrame < 0 || options.firstFrame >= getFrameCount()
+        || options.inSampleSize < 0) {
+        return false;
+    }
+    const int width = options.inSampleSize > 0 ? mGif->SWidth / options.inSampleSize
+                                               : options.outputWidth;
+    const int height = options.inSampleSize > 0 ? mGif->SHeight / options.inSampleSize
+                                                : options.outputHeight;
+    if (width <= 0 || height <= 0) {
+        return false;
+    }
+    FramePrefetcher *prefetcher = new FramePrefetcher(this, options, width, height);
+    {
+        std::lock_guard<std::mutex> lock(mPrefetchLock);
+        std::swap(prefetcher, mPrefetcher);
+        mPrefetchBytes = mPrefetcher->getBytes();
+    }
+    // 其他线程同时启动的预取
+    delete prefetcher;
+    return true;
+}
+
+void GifDecoder::stopPrefetch() {
+    FramePrefetcher *prefetcher;
+    {
+        std::lock_guard<std::mutex> lock(mPrefetchLock);
+        prefetcher = mPrefetcher;
+        mPrefetcher = NULL;
+        mPrefetchBytes = 0;
+    }
+    // 在锁外等待预取线程, 其间 takeNextFrame 直接返回
+    delete prefetcher;
+}
+
+int GifDecoder::takeNextFrame(void *outputPtr, PixelFormat format, int outputPixelStride,
+                              int outputWidth, int outputHeight, long *delayMs) {
+    std::lock_guard<std::mutex> lock(mPrefetchLock);
+    if (!mPrefetcher) {
+        return -1;
+    }
+    return mPrefetcher->takeNextFrame(outputPtr, format, outputPixelStride, outputWidth,
+                                      outputHeight, delayMs);
+}
+
+int GifDecoder::getFrameControls(int start, int count, FrameControl *out) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (!mHasInit || start < 0 || count <= 0 || start >= mFrameCount) {
+        return 0;
+    }
+    count = min(count, mFrameCount - start);
+    for (int i = 0; i < count; i++) {
+        const int frameNr = start + i;
+        out[i].delayMs = mFrameDelays[frameNr];
+        out[i].disposalMode = mFrameDisposals[frameNr];
+        out[i].transparentColor = mFrameTransparents[frameNr];
+        out[i].flags = mFrameFlags[frameNr];
+    }
+    return count;
+}
+
+void GifDecoder::restorePreserveBuffer(const OutputCanvas &canvas, int inSampleSize) {
     // 判断是否可以从上一帧中获取数据
-    if (!mPreserveBuffer || inSampleSize != mPreserveSampleSize) {
+    if (!mPreserveBuffer || inSampleSize != mPreserveSampleSize
+        || canvas.format != mPreserveFormat) {
         ALOGI("preserve buffer not available.");
         return;
     }
     // 从上一帧的 Buffer 中拷贝数据
-    const int requestWidth = mGif->SWidth / inSampleSize;
     const int requestHeight = mGif->SHeight / inSampleSize;
-    for (int y = 0; y < requestHeight; y++) {
-        memcpy(outputPtr + outputPixelStride * y, mPreserveBuffer + requestWidth * y,
-               requestWidth * 4);
-    }
+    const size_t rowBytes = (size_t) (mGif->SWidth / inSampleSize)
+                            * getBytesPerPixel(canvas.format);
+    forEachBand(requestHeight, mGif->SWidth / inSampleSize, [&](int, int begin, int end) {
+        for (int y = begin; y < end; y++) {
+            memcpy(canvas.at(0, y), mPreserveBuffer + rowBytes * y, rowBytes);
+        }
+    });
 }
 
-void
-GifDecoder::savePreserveBuffer(Color8888 *outputPtr, int outputPixelStride, int frameNr,
-                               int inSampleSize) {
-    if (frameNr == mPreserveBufferFrame) {
+void GifDecoder::savePreserveBuffer(const OutputCanvas &canvas, int frameNr, int inSampleSize) {
+    if (frameNr == mPreserveBufferFrame && inSampleSize == mPreserveSampleSize
+        && canvas.format == mPreserveFormat) {
         return;
     }
-    mPreserveBufferFrame = frameNr;
-    mPreserveSampleSize = inSampleSize;
-    const int width = mGif->SWidth / inSampleSize;
+    if (mPreserveBuffer && (inSampleSize != mPreserveSampleSize
+                            || canvas.format != mPreserveFormat)) {
+        // 采样率或像素格式变化后画布大小不同, 重新分配
+        DecoderPool::get().recycleBuffer(mPreserveBuffer, mPreserveBufferBytes);
+        mPreserveBuffer = NULL;
+    }
     const int height = mGif->SHeight / inSampleSize;
+    const size_t rowBytes = (size_t) (mGif->SWidth / inSampleSize)
+                            * getBytesPerPixel(canvas.format);
     if (!mPreserveBuffer) {
-        mPreserveBuffer = new Color8888[width * height];
+        mPreserveBufferBytes = rowBytes * height;
+        mPreserveBuffer = (uint8_t *) DecoderPool::get().takeBuffer(mPreserveBufferBytes);
+        if (!mPreserveBuffer) {
+            ALOGE("Out of memory while saving frame %d", frameNr);
+            mPreserveBufferFrame = -1;
+            return;
+        }
+    }
+    mPreserveBufferFrame = frameNr;
+    mPreserveSampleSize = inSampleSize;
+    mPreserveFormat = canvas.format;
+    forEachBand(height, mGif->SWidth / inSampleSize, [&](int, int begin, int end) {
+        for (int y = begin; y < end; y++) {
+            memcpy(mPreserveBuffer + rowBytes * y, canvas.at(0, y), rowBytes);
+        }
+    });
+}
+
+int GifDecoder::restoreKeyframe(int frameNr, int start, const OutputCanvas &canvas,
+                                int inSampleSize) {
+    if (inSampleSize != mKeyframeSampleSize || canvas.format != mKeyframeFormat) {
+        return -1;
+    }
+    KeyframeSnapshot *keyframe = NULL;
+    for (size_t i = 0; i < mKeyframes.size(); i++) {
+        KeyframeSnapshot &candidate = mKeyframes[i];
+        if (candidate.frameNr > start && candidate.frameNr <= frameNr
+            && (!keyframe || candidate.frameNr > keyframe->frameNr)) {
+            keyframe = &candidate;
+        }
     }
+    if (!keyframe) {
+        return -1;
+    }
+    keyframe->lastUse = ++mKeyframeClock;
+
+    const int height = mGif->SHeight / inSampleSize;
+    const size_t rowBytes = (size_t) (mGif->SWidth / inSampleSize)
+                            * getBytesPerPixel(canvas.format);
     for (int y = 0; y < height; y++) {
-        memcpy(mPreserveBuffer + width * y, outputPtr + outputPixelStride * y, width * 4);
+        memcpy(canvas.at(0, y), keyframe->canvas + rowBytes * y, rowBytes);
+    }
+    // 恢复之后的 DISPOSE_PREVIOUS 需要的保留缓冲
+    int preservedFrame = mCarriedPreserves[keyframe->frameNr];
+    if (preservedFrame >= 0) {
+        const OutputCanvas saved = {keyframe->preserve ? keyframe->preserve : keyframe->canvas,
+                                    rowBytes, canvas.format};
+        savePreserveBuffer(saved, preservedFrame, inSampleSize);
     }
+    return keyframe->frameNr;
 }
 
-////////////////////////////////////////////////////////////////////////////////
-// JNILoader
-////////////////////////////////////////////////////////////////////////////////
+void GifDecoder::saveKeyframe(int frameNr, const OutputCanvas &canvas, int inSampleSize) {
+    if (inSampleSize != mKeyframeSampleSize || canvas.format != mKeyframeFormat) {
+        clearKeyframes();
+        mKeyframeSampleSize = inSampleSize;
+        mKeyframeFormat = canvas.format;
+    }
+    for (size_t i = 0; i < mKeyframes.size(); i++) {
+        if (mKeyframes[i].frameNr == frameNr) {
+            return;
+        }
+    }
+    // 上一帧刚好是保留帧时, 保留缓冲就是当前画布, 不必另存
+    int preservedFrame = mCarriedPreserves[frameNr];
+    bool needPreserve = preservedFrame >= 0 && preservedFrame != frameNr - 1;
+    if (needPreserve && (preservedFrame != mPreserveBufferFrame
+                         || inSampleSize != mPreserveSampleSize
+                         || canvas.format != mPreserveFormat)) {
+        return;
+    }
 
-static jobject createJavaGifDecoder(JNIEnv *env, jclass jclazz, GifDecoder *decoder) {
-    if (!decoder || !decoder->hasInit()) {
-        ALOGE("Gif parsed failed. Please check input source and try again.");
-        return NULL;
+    const int height = mGif->SHeight / inSampleSize;
+    const size_t rowBytes = (size_t) (mGif->SWidth / inSampleSize)
+                            * getBytesPerPixel(canvas.format);
+    const size_t canvasBytes = rowBytes * height;
+    const size_t bytes = needPreserve ? canvasBytes * 2 : canvasBytes;
+    // 来自 Java 的负值与 0 相同, 不保存关键帧
+    const size_t cacheBytes = (size_t) max(mOptions.keyframeCacheBytes, 0l);
+    if (bytes > cacheBytes) {
+        return;
     }
-    // Create Java method.<init>是每个对象创建走的第一个方法。
-    jmethodID jCtr = env->GetMethodID(jclazz, "<init>", "(JIIZIIJ)V");
-    // 在C++层构建Java层的GifDecoder
-    return env->NewObject(
-            jclazz, jCtr,
-            reinterpret_cast<jlong>(decoder),
-            decoder->getWidth(),
-            decoder->getHeight(),
-            decoder->isOpaque(),
-            decoder->getFrameCount(),
-            decoder->getLooperCount(),
-            static_cast<jlong>(decoder->getDuration())
-    );
-}
-
-namespace gifdecoder {
-
-    jobject _nativeDecodeFile(JNIEnv *env, jclass jclazz, jstring file_path) {
-        char *filePath = const_cast<char *>(env->GetStringUTFChars(file_path, NULL));
-        GifDecoder *decoder = new GifDecoder(filePath);
-        env->ReleaseStringUTFChars(file_path, filePath);
-        return createJavaGifDecoder(env, jclazz, decoder);
-    }
-
-    jobject _nativeDecodeStream(JNIEnv *env, jclass jclazz, jobject istream,
-                               jbyteArray byteArray) {
-        JavaInputStream stream(env, istream, byteArray);
-        GifDecoder *decoder = new GifDecoder(&stream);
-        return createJavaGifDecoder(env, jclazz, decoder);
-    }
-
-    jobject _nativeDecodeByteArray(JNIEnv *env, jclass jclazz,
-                                  jbyteArray byteArray,
-                                  jint offset, jint length) {
-        jbyte *bytes = reinterpret_cast<jbyte *>(env->GetPrimitiveArrayCritical(byteArray, NULL));
-        if (bytes == NULL) {
-            ALOGE("couldn't read array bytes");
-            return NULL;
+    // 超出内存上限时淘汰最久未使用的关键帧
+    while (mKeyframeBytes + bytes > cacheBytes) {
+        size_t victim = 0;
+        for (size_t i = 1; i < mKeyframes.size(); i++) {
+            if (mKeyframes[i].lastUse < mKeyframes[victim].lastUse) {
+                victim = i;
+            }
         }
-        MemoryStream stream(bytes + offset, length, NULL);
-        GifDecoder *decoder = new GifDecoder(&stream);
-        env->ReleasePrimitiveArrayCritical(byteArray, bytes, 0);
-        return createJavaGifDecoder(env, jclazz, decoder);
-    }
-
-    jobject _nativeDecodeByteBuffer(JNIEnv *env, jclass jclazz, jobject buf,
-                                   jint offset, jint limit) {
-        jobject globalBuf = env->NewGlobalRef(buf);
-        JavaVM *vm;
-        env->GetJavaVM(&vm);
-        MemoryStream stream(
-                (reinterpret_cast<uint8_t *>(env->GetDirectBufferAddress(globalBuf))) + offset,
-                limit,
-                globalBuf);
-        GifDecoder *decoder = new GifDecoder(&stream);
-        //创建GifDecoder
-        return createJavaGifDecoder(env, jclazz, decoder);
-    }
-
-    jlong _nativeGetFrame(JNIEnv *env, jobject, jlong handle,
-                         jint frameNr, jobject bitmap, jint prevFrameNr, jint inSampleSize) {
-        GifDecoder *decoder = reinterpret_cast<GifDecoder *>(handle);
-        AndroidBitmapInfo info;
-        void *pixels;
-        AndroidBitmap_getInfo(env, bitmap, &info);
-        AndroidBitmap_lockPixels(env, bitmap, &pixels);
-        // 获取一行的像素数数量  每行字节数/4  = 一行的像素的个数乘以4
-        // （rgba）像素由rgba四个分量组成，像素数量是等于每一行的字节数除以4 因为像素有四个分量每个分量占用一个字节
-        int pixelStride = info.stride >> 2;
-        jlong delayMs = decoder->drawFrame(frameNr, (Color8888 *) pixels, pixelStride,
-                                           prevFrameNr, inSampleSize);
-        AndroidBitmap_unlockPixels(env, bitmap);
-        return delayMs;
-    }
-
-    void _nativeDestroy(JNIEnv *, jobject, jlong native_ptr) {
-        GifDecoder *decoder = reinterpret_cast<GifDecoder *>(native_ptr);
-        delete (decoder);
-    }
-
-}
-
-static JNINativeMethod gGifDecoderMethods[] = {
-        // 动态注册的方式注册Java层的native方法
-        {"nativeDecodeFile",       "(Ljava/lang/String;)Lcom/hash/study/gif/GifDecoder;",      (void *) gifdecoder::_nativeDecodeFile},
-        {"nativeDecodeStream",     "(Ljava/io/InputStream;[B)Lcom/hash/study/gif/GifDecoder;", (void *) gifdecoder::_nativeDecodeStream},
-        {"nativeDecodeByteArray",  "([BII)Lcom/hash/study/gif/GifDecoder;",                    (void *) gifdecoder::_nativeDecodeByteArray},
-        {"nativeDecodeByteBuffer", "(Ljava/nio/ByteBuffer;II)Lcom/hash/study/gif/GifDecoder;", (void *) gifdecoder::_nativeDecodeByteBuffer},
-        // other method.
-        {"nativeGetFrame",         "(JILandroid/graphics/Bitmap;II)J",                         (void *) gifdecoder::_nativeGetFrame},
-        {"nativeDestroy",          "(J)V",                                                     (void *) gifdecoder::_nativeDestroy},
-};
+        mKeyframeBytes -= mKeyframes[victim].preserve ? canvasBytes * 2 : canvasBytes;
+        releaseKeyframe(mKeyframes[victim]);
+        mKeyframes.erase(mKeyframes.begin() + victim);
+    }
 
-// 通过
-jint GifDecoder_OnLoad(JNIEnv *env) {
-    jclass jclsGifDecoder = env->FindClass("com/hash/study/gif/GifDecoder");
-    jclsGifDecoder = reinterpret_cast<jclass>(env->NewGlobalRef(jclsGifDecoder));
-    return env->RegisterNatives(
-            jclsGifDecoder,
-            gGifDecoderMethods,
-            sizeof(gGifDecoderMethods) / sizeof(gGifDecoderMethods[0])
-    );
-}
\ No newline at end of file
+    KeyframeSnapshot keyframe = {frameNr, ++mKeyframeClock, NULL, NULL, canvasBytes};
+    keyframe.canvas = (uint8_t *) DecoderPool::get().takeBuffer(canvasBytes);
+    keyframe.preserve = needPreserve
+                        ? (uint8_t *) DecoderPool::get().takeBuffer(canvasBytes) : NULL;
+    if (!keyframe.canvas || (needPreserve && !keyframe.preserve)) {
+        releaseKeyframe(keyframe);
+        return;
+    }
+    for (int y = 0; y < height; y++) {
+        memcpy(keyframe.canvas + rowBytes * y, canvas.at(0, y), rowBytes);
+    }
+    if (needPreserve) {
+        memcpy(keyframe.preserve, mPreserveBuffer, canvasBytes);
+    }
+    mKeyframes.push_back(keyframe);
+    mKeyframeBytes += bytes;
+}
+
+void GifDecoder::releaseKeyframe(const KeyframeSnapshot &keyframe) {
+    DecoderPool::get().recycleBuffer(keyframe.canvas, keyframe.canvasBytes);
+    DecoderPool::get().recycleBuffer(keyframe.preserve, keyframe.canvasBytes);
+}
+
+void GifDecoder::clearKeyframes() {
+    for (size_t i = 0; i < mKeyframes.size(); i++) {
+        releaseKeyframe(mKeyframes[i]);
+    }
+    mKeyframes.clear();
+    mKeyframeBytes = 0;
+}
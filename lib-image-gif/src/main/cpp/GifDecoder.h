@@ -1,14 +1,142 @@
 
-#pragma
-#include <jni.h>
+#pragma once
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
 #include "giflib/gif_lib.h"
 #include "Color.h"
+#include "FramePrefetcher.h"
+#include "FrameScaler.h"
 #include "stream/Stream.h"
 
+// 解码参数, 对应 Java 层的 GifDecoder.Options
+struct DecodeOptions {
+    // 打开时只扫描 GIF 的记录结构, 每一帧的像素在 drawFrame 需要时才解压
+    bool lazyDecode = false;
+    // lazyDecode 模式下最多缓存多少帧已解压的像素, 0 表示只保留当前帧
+    int rasterCacheSize = 0;
+    // 只解析尺寸、帧数、时长等信息, 不保留数据, drawFrame 不可用
+    bool justDecodeInfo = false;
+    // 每隔多少帧保存一份合成中的画布作为关键帧, 跳帧时从最近的关键帧开始合成; 0 表示关闭
+    int keyframeInterval = 0;
+    // 关键帧占用内存的上限 (字节), 超出后淘汰最久未使用的关键帧
+    long keyframeCacheBytes = 8 * 1024 * 1024;
+    // LZW 解压引擎, 仅 native 使用; GIF_LZW_CLASSIC 用于逐字节对比结果
+    int lzwEngine = GIF_LZW_TABLE;
+    // 帧像素、局部色表和扩展块从按文件分配的大块内存中切分, 关闭时整体释放, 仅 native 使用
+    bool arena = true;
+    // 渐进解码: 打开时只读到第一帧, 其余帧由 decodeMoreFrames 继续读取, 边读边播放.
+    // 只对 Stream 输入有效, 并且 lazyDecode 和 justDecodeInfo 优先
+    bool progressive = false;
+    // 每一帧只保留原始的 LZW 数据 (通常只有解压后的 1/5 到 1/20), 绘制时解压到
+    // rasterCacheSize 控制的缓存中, 打开后不再持有数据源. lazyDecode, justDecodeInfo 和 progressive 优先
+    bool compressedFrames = false;
+    // lazyDecode 和 compressedFrames 模式下 rasterCacheSize 为 0 时, 逐行解压并直接合成,
+    // 省掉整帧的索引像素缓冲, 但逐行解压约慢一倍. 仅 native 使用
+    bool directComposite = false;
+    // inSampleSize 大于 1 时按块取平均 (盒式滤波) 代替逐点采样, 缩小较多时不会闪烁和锯齿,
+    // 但需要读取块内全部像素. 此时不使用 directComposite, inSampleSize 超过 128 时仍逐点采样
+    bool boxFilter = false;
+    // 内存预算 (字节), 0 表示不限制. 打开时估算完整解压所需的内存, 超出预算时改为 lazyDecode,
+    // 并按剩余预算降低 rasterCacheSize 和 keyframeCacheBytes. progressive 和 justDecodeInfo 模式忽略
+    long memoryBudgetBytes = 0;
+    // 按行分带并行合成的线程数 (含调用线程), 0 表示与 CPU 核数相同, 1 表示单线程.
+    // 一次填充或合成的像素少于 PARALLEL_COMPOSITE_MIN_PIXELS 时仍在调用线程完成; directComposite 逐行解压时不并行
+    int compositeThreads = 1;
+    // 打开时完整解压所有帧所用的线程数 (含调用线程), 0 表示与 CPU 核数相同, 1 表示单线程.
+    // 大于 1 时先扫描出每一帧 LZW 数据的位置, 再由各线程依次领取尚未解压的帧; 数据源不在内存中时先读入一份副本.
+    // lazyDecode, justDecodeInfo, progressive 和 compressedFrames 模式不解压所有帧, 忽略此项
+    int decodeThreads = 1;
+};
+
+// 分带并行的最少像素数, 约 512x512; 更小的区域分发到线程的开销超过并行的收益
+static const long PARALLEL_COMPOSITE_MIN_PIXELS = 256 * 1024;
+
+// getMemoryUsage 的结果, 按类别统计解码器持有的 native 内存 (字节)
+struct MemoryUsage {
+    // 已解压的帧像素: 完整解压时为所有帧, lazyDecode 模式下为缓存; 以及交错帧解压用的中间缓冲
+    size_t rasters;
+    // lazyDecode 模式下数据源的副本
+    size_t sourceCopy;
+    // compressedFrames 模式下每一帧的 LZW 数据
+    size_t compressedFrames;
+    // 文件的只读映射, 由页缓存承担, 内存紧张时可以被系统回收
+    size_t mappedSource;
+    // DISPOSE_PREVIOUS 的保留缓冲
+    size_t preserveBuffer;
+    size_t keyframes;
+    size_t paletteLuts;
+    // 色表、扩展块、帧索引和逐帧数组
+    size_t metadata;
+    // drawScaledFrame 的中间画布和缩放权重
+    size_t scaledCanvas;
+    // startPrefetch 的环形缓冲和合成画布
+    size_t prefetch;
+};
+
+// 预解析的一帧 GCB, getFrameControls 的输出
+struct FrameControl {
+    // 帧的时长 (毫秒)
+    int delayMs;
+    // DISPOSAL_UNSPECIFIED 等
+    int disposalMode;
+    // 透明色索引, 没有时为 NO_TRANSPARENT_COLOR
+    int transparentColor;
+    // FRAME_OPAQUE 等
+    int flags;
+};
+
+enum {
+    // 帧没有透明色
+    FRAME_OPAQUE = 1,
+    // 帧没有透明色且完全覆盖上一帧的区域, 上一帧的处置不必执行
+    FRAME_COVERS_PREVIOUS = 2,
+    // 合成到这一帧后整个画布不透明 (任意 inSampleSize), 可以不混合地绘制或输出 RGB_565
+    FRAME_CANVAS_OPAQUE = 4,
+    // 确认帧的索引都在色表之内; 否则越界索引的像素保留之前的画布
+    FRAME_IN_COLOR_MAP = 8,
+};
+
+// drawFrame 改动过的区域, 采样后的画布坐标, right/bottom 不包含在内; 没有改动时为空
+struct DirtyRect {
+    int left;
+    int top;
+    int right;
+    int bottom;
+};
+
+// 画布中可能透明的区域 (GIF 坐标), 各部分的外接矩形; single 表示恰好是一个帧矩形
+struct TransparentArea {
+    DirtyRect rect;
+    bool single;
+};
+
+// drawFrame 的输出画布
+struct OutputCanvas {
+    uint8_t *pixels;
+    // 每行的字节数
+    size_t rowBytes;
+    PixelFormat format;
+
+    uint8_t *at(int x, int y) const {
+        return pixels + y * rowBytes + (size_t) x * getBytesPerPixel(format);
+    }
+};
+
 class GifDecoder {
 
 private:
-    GifFileType *mGif;
+    // lazyDecode 模式下, 已解压帧像素的缓存项
+    struct RasterCacheEntry {
+        int frameNr;
+        unsigned int lastUse;
+        GifByteType *raster;
+        size_t capacity;
+    };
+
+    GifFileType *mGif = NULL;
+    DecodeOptions mOptions;
     // array of bool per frame - if true, frame data is used by a later DISPOSE_PREVIOUS frame
     bool *mPreservedFrames = NULL;
     // array of ints per frame - if >= 0, points to the index of the preserve that frame needs
@@ -17,27 +145,132 @@ private:
     Color8888 mBgColor = TRANSPARENT;
 
     // 缓存上一帧的 Bitmap 数据
-    Color8888 *mPreserveBuffer = NULL;
-    // 缓存上一帧的 SampleSize
+    uint8_t *mPreserveBuffer = NULL;
+    size_t mPreserveBufferBytes = 0;
+    // 缓存上一帧的 SampleSize 和像素格式
     int mPreserveSampleSize = 1;
+    PixelFormat mPreserveFormat = PIXEL_FORMAT_8888;
     // 上一帧的 FrameNumber
-    int mPreserveBufferFrame;
+    int mPreserveBufferFrame = -1;
 
-    int mLoopCount = 1;
-    long mDurationMs = 0l;
+    // 渐进解码时这些值随读出的帧增长, 可能被其他线程读取
+    std::atomic<int> mLoopCount{1};
+    std::atomic<long> mDurationMs{0l};
     bool mHasInit = false;
 
+    // 保护 mGif->SavedImages 和逐帧数组: 渐进解码时 decodeMoreFrames 与 drawFrame 可以在不同线程
+    std::mutex mLock;
+    // 已发布 (可以绘制) 的帧数
+    std::atomic<int> mFrameCount{0};
+    // 逐帧数组的容量
+    int mFrameCapacity = 0;
+    // 渐进解码时尚未读完的输入, 读完或出错后释放
+    Stream *mProgressiveStream = NULL;
+    std::atomic<bool> mComplete{true};
+    // 逐帧信息的增量计算状态
+    int mLastUnclearedFrame = -1;
+
+    // 合成到最后一个已发布的帧后的透明区域, 为空时画布完全不透明
+    TransparentArea mTransparentArea = {{0, 0, 0, 0}, false};
+    // 合成到 mLastUnclearedFrame 后的透明区域, DISPOSE_PREVIOUS 恢复到这里
+    TransparentArea mUnclearedTransparentArea = {{0, 0, 0, 0}, false};
+    // 已发布的帧合成后是否都完全不透明
+    bool mAnimationOpaque = true;
+
+    // 逐帧的 GCB, 发布帧时解析一次, drawFrame 不再逐次查找扩展块
+    int *mFrameDelays = NULL;
+    unsigned char *mFrameDisposals = NULL;
+    // 透明色索引, 没有时为 NO_TRANSPARENT_COLOR
+    short *mFrameTransparents = NULL;
+    unsigned char *mFrameFlags = NULL;
+
+    // 一个 (色表, 透明色) 组合对应的 Color8888 查找表,
+    // 透明色和越界索引映射为 TRANSPARENT (色表中的颜色 alpha 恒为 0xff)
+    struct PaletteLut {
+        const ColorMapObject *cmap;
+        int transparent;
+        Color8888 colors[256];
+        // RGB_565 输出使用的颜色, 透明与否仍以 colors 为准
+        Color565 colors565[256];
+    };
+
+    // 已建立的查找表, 循环播放时直接复用
+    std::vector<PaletteLut *> mPaletteLuts;
+    // 每一帧使用的查找表在 mPaletteLuts 中的下标, -1 表示尚未建立
+    int *mFrameLuts = NULL;
+
+    // 关键帧: 第 frameNr 帧绘制之前 (上一帧已处置) 的画布
+    struct KeyframeSnapshot {
+        int frameNr;
+        unsigned int lastUse;
+        uint8_t *canvas;
+        // 之后的 DISPOSE_PREVIOUS 仍需要的保留缓冲, 不需要或与 canvas 相同时为 NULL
+        uint8_t *preserve;
+        // canvas 和 preserve 各自的字节数
+        size_t canvasBytes;
+    };
+
+    std::vector<KeyframeSnapshot> mKeyframes;
+    // 关键帧对应的 SampleSize 和像素格式, 变化后全部失效
+    int mKeyframeSampleSize = 1;
+    PixelFormat mKeyframeFormat = PIXEL_FORMAT_8888;
+    unsigned int mKeyframeClock = 0;
+    size_t mKeyframeBytes = 0;
+    // 每一帧绘制之前, 之后的帧仍需要恢复的保留帧, -1 表示没有
+    int *mCarriedPreserves = NULL;
+    // 每一帧是否为独立帧: 绘制时不依赖之前的画布, 可以直接从该帧开始合成
+    bool *mIndependentFrames = NULL;
+    // 每一帧之前 (含) 最近的独立帧
+    int *mLastIndependentFrames = NULL;
+
+    // lazyDecode 模式下从无法长期持有的 Stream 读入的完整副本, 文件映射时为 NULL
+    GifByteType *mSourceCopy = NULL;
+    size_t mSourceCopySize = 0;
+    // 文件的只读映射, giflib 直接在其上读取; 只有 lazyDecode 模式在 init 之后继续持有
+    Stream *mSourceStream = NULL;
+    // DGifScan 建立的帧索引, 记录每一帧在数据源中的偏移和 GCB
+    GifFrameIndex *mFrameIndex = NULL;
+    // compressedFrames 模式下所有帧的 LZW 数据, 第 i 帧为 [mCompressedOffsets[i], mCompressedOffsets[i + 1])
+    GifByteType *mCompressedFrames = NULL;
+    size_t *mCompressedOffsets = NULL;
+    std::vector<RasterCacheEntry> mRasterCache;
+    // compositeFrameRows 解压一行的缓冲
+    std::vector<GifByteType> mLineBuffer;
+    // boxFilter 合成时每列的通道和
+    std::vector<uint32_t> mBoxSums;
+    // 输出不是 ARGB_8888 时, boxFilter 在这一行上合成后再转换
+    std::vector<Color8888> mBoxLine;
+    unsigned int mRasterCacheClock = 0;
+
+    // drawScaledFrame 的状态, 由 mScaleLock 保护; 先合成到采样后的 mScaledCanvas 再缩放到输出
+    std::mutex mScaleLock;
+    std::vector<Color8888> mScaledCanvas;
+    int mScaledSampleSize = 0;
+    FrameScaler mScaler;
+    // mScaledCanvas 中的帧, -1 表示内容无效
+    int mScaledFrame = -1;
+    // 绘制 mScaledFrame 之前画布中的帧, 以及那次绘制改动过的区域 (画布坐标)
+    int mScaledPrevFrame = -1;
+    DirtyRect mScaledLastChanged = {0, 0, 0, 0};
+    // mScaledCanvas 和 mScaler 占用的内存, 在 mLock 下更新供 getMemoryUsage 读取
+    size_t mScaledBytes = 0;
+    // 预取, 没有启动时为 NULL; mPrefetchLock 保护指针本身, 预取线程不持有
+    std::mutex mPrefetchLock;
+    FramePrefetcher *mPrefetcher = NULL;
+    std::atomic<size_t> mPrefetchBytes{0};
+
 public:
     /**
      *
-     * @param stream 处理原始GIf流信息
+     * @param stream 处理原始GIf流信息. progressive 模式下解码器接管 stream (须由 new 创建),
+     *               读完、出错或析构时释放
      */
-    GifDecoder(Stream *stream);
+    GifDecoder(Stream *stream, const DecodeOptions &options = DecodeOptions());
     /**
      *
      * @param filePath 处理Gif文件
      */
-    GifDecoder(char *filePath);
+    GifDecoder(char *filePath, const DecodeOptions &options = DecodeOptions());
 
     ~GifDecoder();
     // 是否初始化
@@ -50,12 +283,12 @@ public:
     }
 
     int getHeight() { return mHasInit ? mGif->SHeight : 0; }
-    //是否透明
+    // 背景色是否不透明; 帧合成后是否不透明见 isFrameOpaque 和 isAnimationOpaque
     bool isOpaque() {
         return (mBgColor & COLOR_8888_ALPHA_MASK) == COLOR_8888_ALPHA_MASK;
     }
-    // 获取Gif数据帧的个数
-    int getFrameCount() { return mHasInit ? mGif->ImageCount : 0; }
+    // 获取Gif数据帧的个数, 渐进解码时为目前已读出的帧数
+    int getFrameCount() { return mHasInit ? mFrameCount.load() : 0; }
     //循环次数
     int getLooperCount() {
         return mLoopCount;
@@ -65,23 +298,212 @@ public:
         return mDurationMs;
     }
 
+    // 第 frameNr 帧是否为独立帧, drawFrame 会从最近的独立帧开始合成
+    bool isIndependentFrame(int frameNr) {
+        std::lock_guard<std::mutex> lock(mLock);
+        return mHasInit && frameNr >= 0 && frameNr < mFrameCount
+               && mIndependentFrames[frameNr];
+    }
+
+    /**
+     * 复制 [start, start + count) 帧预解析的 GCB 到 out, 供调度播放使用
+     * @return 复制的帧数, 渐进解码时只包含已读出的帧
+     */
+    int getFrameControls(int start, int count, FrameControl *out);
+
+    /**
+     * 合成到第 frameNr 帧后整个画布是否不透明, 即 FRAME_CANVAS_OPAQUE.
+     * 帧像素已解压时按像素判断, 声明了透明色但没有使用的帧也不透明; lazyDecode 和 compressedFrames
+     * 模式 (包括超出 memoryBudgetBytes 后改用的) 发布帧时没有像素, 只按透明色判断, 结果可能偏保守
+     */
+    bool isFrameOpaque(int frameNr) {
+        std::lock_guard<std::mutex> lock(mLock);
+        return mHasInit && frameNr >= 0 && frameNr < mFrameCount
+               && (mFrameFlags[frameNr] & FRAME_CANVAS_OPAQUE);
+    }
+
+    /**
+     * 所有帧读出后, 整个动画的每一帧是否都完全不透明, 此时可以用 RGB_565 输出.
+     * 按透明色, 处置方式和帧矩形逐帧推算, 与背景色是否透明无关
+     */
+    bool isAnimationOpaque() {
+        std::lock_guard<std::mutex> lock(mLock);
+        return mHasInit && mComplete && mFrameCount > 0 && mAnimationOpaque;
+    }
+
+    // 按类别统计目前持有的内存
+    MemoryUsage getMemoryUsage();
+
+    // 所有帧是否都已读出; 渐进解码读到结尾或出错之前为 false
+    bool isComplete() {
+        return mComplete;
+    }
+
+    /**
+     * 渐进解码时继续从 stream 读取最多 maxFrames 帧, 可以与 drawFrame 在不同线程调用
+     * @return 新读出的帧数, 出错时返回 -1 (已读出的帧仍然可以绘制)
+     */
+    int decodeMoreFrames(int maxFrames);
+
+    /**
+     * 将第 frameNr 帧合成到 outputPtr, outputPtr 中原有的内容为第 previousFrameNr 帧
+     * @param dirtyRect 不为 NULL 时返回相对原有内容改动过的区域
+     * @return 帧的时长
+     */
     long drawFrame(int frameNr, Color8888 *outputPtr, int outputPixelStride, int previousFrameNr,
-                   int inSampleSize);
+                   int inSampleSize, DirtyRect *dirtyRect = NULL) {
+        return drawFrame(frameNr, outputPtr, PIXEL_FORMAT_8888, outputPixelStride,
+                         previousFrameNr, inSampleSize, dirtyRect);
+    }
+
+    /**
+     * 与上面相同, 按 format 写入 outputPtr, outputPixelStride 以像素计.
+     * RGB_565 丢弃透明度, 只适合 isAnimationOpaque 的 GIF; ALPHA_8 只保留透明度, 用作单色遮罩.
+     * 保留缓冲和关键帧按格式保存, 同一解码器交替使用不同格式时需要重新合成
+     */
+    long drawFrame(int frameNr, void *outputPtr, PixelFormat format, int outputPixelStride,
+                   int previousFrameNr, int inSampleSize, DirtyRect *dirtyRect = NULL);
+
+    /**
+     * 将第 frameNr 帧缩放到 outputWidth x outputHeight 写入 outputPtr, outputPtr 中原有的内容为
+     * 同样尺寸的第 previousFrameNr 帧. 先以不超过缩放比例的最大整数 inSampleSize 合成,
+     * 再用 FrameScaler 缩放剩余的比例; 尺寸恰好为整数倍时等同于 drawFrame
+     * @param dirtyRect 不为 NULL 时返回相对原有内容改动过的区域 (输出坐标)
+     * @return 帧的时长
+     */
+    long drawScaledFrame(int frameNr, Color8888 *outputPtr, int outputPixelStride,
+                         int outputWidth, int outputHeight, int previousFrameNr,
+                         DirtyRect *dirtyRect = NULL) {
+        return drawScaledFrame(frameNr, outputPtr, PIXEL_FORMAT_8888, outputPixelStride,
+                               outputWidth, outputHeight, previousFrameNr, dirtyRect);
+    }
+
+    // 与上面相同, 按 format 写入 outputPtr; 中间画布仍为 ARGB_8888, 缩放后转换
+    long drawScaledFrame(int frameNr, void *outputPtr, PixelFormat format, int outputPixelStride,
+                         int outputWidth, int outputHeight, int previousFrameNr,
+                         DirtyRect *dirtyRect = NULL);
+
+    /**
+     * 启动预取: 后台线程从 firstFrame 开始按播放顺序循环合成, 最多提前 ringSize 帧, 由 takeNextFrame 取出.
+     * 已在预取时先停止之前的. 预取期间 drawFrame 等调用仍然可用, 但与预取线程互相等待;
+     * 预取线程不读取数据源, 渐进解码时仍由调用方以 decodeMoreFrames 读取, 预取线程等待读出的帧
+     * @return 参数无效或不能绘制时返回 false
+     */
+    bool startPrefetch(const PrefetchOptions &options);
+
+    // 停止预取并释放环形缓冲, 等待正在合成的一帧完成
+    void stopPrefetch();
+
+    /**
+     * 取出预取合成好的下一帧, 见 FramePrefetcher::takeNextFrame; 不等待合成
+     * @return 帧号, 没有启动预取或还没有合成好的帧时返回 -1
+     */
+    int takeNextFrame(void *outputPtr, PixelFormat format, int outputPixelStride, int outputWidth,
+                      int outputHeight, long *delayMs);
 
 private:
     void init();
+
+    // 将 stream 完整读入 mSourceCopy, 并以其为数据源打开 giflib
+    bool openSource(Stream *stream);
+
+    // 获取一帧的索引像素, lazyDecode 模式下按需解压
+    const GifByteType *getFrameRaster(int frameNr);
+
+    bool decodeFrameRaster(int frameNr, GifByteType *raster);
+
+    // 按需解压且不缓存帧像素时, 逐行解压并直接合成
+    bool composesDirectly() const {
+        return (mOptions.lazyDecode || mCompressedFrames) && mOptions.rasterCacheSize == 0
+               && mOptions.directComposite;
+    }
+
+    // 逐行解压一帧, 每一行解压后立即经查找表合成到 canvas 的 (left, top), 参数与 drawFrame 中的合成循环相同
+    bool compositeFrameRows(int frameNr, const OutputCanvas &canvas, int left, int top,
+                            const PaletteLut *lut, int copyWidth, int copyHeight,
+                            int inSampleSize);
+
+    bool hasMemoryBudget() const {
+        return mOptions.memoryBudgetBytes > 0 && !mOptions.justDecodeInfo && !mOptions.progressive;
+    }
+
+    // 扫描之后按 memoryBudgetBytes 选择完整解压或 lazyDecode
+    bool applyMemoryBudget();
+
+    // 打开时按 decodeThreads 并行解压所有帧
+    bool decodesInParallel() const;
+
+    // 按帧索引解压所有帧到 SavedImages, 之后与 DGifSlurp 的结果相同
+    bool decodeAllFrames();
+
+    // 由 threads 个线程解压所有帧到已分配的 RasterBits, data 为 mGif 读取的内存数据
+    bool decodeFramesInParallel(const GifByteType *data, size_t size, int threads);
+
+    // 按帧索引截取每一帧的 LZW 数据到 mCompressedFrames
+    bool captureCompressedFrames();
+
+    size_t getMetadataBytes() const;
+
+    // capacity 帧的逐帧数组占用的内存
+    size_t getFrameArrayBytes(int capacity) const;
+
+    // 渐进解码: 读取记录直到读出 maxFrames 帧或到达结尾
+    int readFrames(int maxFrames);
+
+    // 为新读出的帧计算逐帧信息, 之后 drawFrame 才能使用这些帧; 渐进解码时需持有 mLock
+    void publishFrames(int frameCount);
+
+    void addFrameInfo(int frameNr);
+
+    // compositeThreads 下 rows 行, 每行 width 个像素的工作分成的带数, 不并行时为 1
+    int getBandCount(int rows, int width) const;
+
+    // 将 [0, rows) 行分带执行 task(band, begin, end), band 小于 getBandCount 的结果; 全部完成后返回
+    void forEachBand(int rows, int width, const std::function<void(int, int, int)> &task) const;
+
+    // 用同一颜色填充采样后画布的 width x height 区域
+    void fillCanvas(const OutputCanvas &canvas, int width, int height, Color8888 color);
+
+    // 用同一颜色填充一帧在采样后画布上的区域
+    void fillFrameRect(const OutputCanvas &canvas, const GifImageDesc &imageDesc, int maxWidth,
+                       int maxHeight, Color8888 color, int inSampleSize);
+
+    // 解析 GIF 的背景色: 第 0 帧有透明色时为 TRANSPARENT; firstFrameOpaque 在没有帧时为 true
+    void initBackgroundColor(bool firstFrameOpaque);
+
+    // 第 frameNr 帧的每个像素是否都不透明; 像素尚未解压时按 GCB 判断, 假定索引不超出色表
+    bool isFramePixelOpaque(int frameNr) const;
+
+    // 第 frameNr 帧的索引是否都在色表之内; 像素尚未解压时按 LZW 码长判断, 无法确认时返回 false
+    bool hasOnlyColorMapIndices(int frameNr) const;
+
+    // 按 drawFrame 的合成顺序推算合成到第 frameNr 帧后的透明区域, 设置 FRAME_CANVAS_OPAQUE
+    void updateTransparentArea(int frameNr);
+
+    void releaseProgressiveStream();
+
+    // 获取一帧的调色板查找表, 首次使用时建立
+    const PaletteLut *getFrameLut(int frameNr, const ColorMapObject *cmap, int transparent);
+
     // 获取上一帧数据
     bool getPreservedFrame(int frameIndex) const { return mPreservedFrames[frameIndex]; }
 
     int getRestoringFrame(int frameIndex) const { return mRestoringFrames[frameIndex]; }
 
     // 缓存上一帧的数据
-    void savePreserveBuffer(Color8888 *outputPtr, int outputPixelStride, int frameNr, int inSampleSize);
+    void savePreserveBuffer(const OutputCanvas &canvas, int frameNr, int inSampleSize);
 
     // 从上一帧中恢复数据
-    void restorePreserveBuffer(Color8888 *outputPtr, int outputPixelStride, int inSampleSize);
+    void restorePreserveBuffer(const OutputCanvas &canvas, int inSampleSize);
 
-};
+    // 查找 (start, frameNr] 之间最近的关键帧并恢复到 canvas, 返回关键帧的帧号, 没有时返回 -1
+    int restoreKeyframe(int frameNr, int start, const OutputCanvas &canvas, int inSampleSize);
 
-jint GifDecoder_OnLoad(JNIEnv *env);
+    // 保存第 frameNr 帧绘制之前的画布
+    void saveKeyframe(int frameNr, const OutputCanvas &canvas, int inSampleSize);
 
+    void releaseKeyframe(const KeyframeSnapshot &keyframe);
+
+    void clearKeyframes();
+
+};
@@ -0,0 +1,102 @@
+#include <algorithm>
+#include "WorkerPool.h"
+
+// 工作线程数的上限, 合成和解压都受内存带宽限制, 更多线程收益很小
+static const int MAX_WORKERS = 7;
+
+WorkerPool &WorkerPool::get() {
+    static WorkerPool pool;
+    return pool;
+}
+
+int WorkerPool::getCpuCount() {
+    const unsigned int count = std::thread::hardware_concurrency();
+    return count > 0 ? (int) count : 1;
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mStopping = true;
+    }
+    mWake.notify_all();
+    for (size_t i = 0; i < mWorkers.size(); i++) {
+        mWorkers[i].join();
+    }
+}
+
+void WorkerPool::ensureWorkers(int count) {
+    count = std::min(count, MAX_WORKERS);
+    while ((int) mWorkers.size() < count) {
+        mWorkers.push_back(std::thread(&WorkerPool::workerLoop, this));
+    }
+}
+
+WorkerPool::Job *WorkerPool::findJob() {
+    for (size_t i = 0; i < mJobs.size(); i++) {
+        if (mJobs[i]->workers < mJobs[i]->maxWorkers) {
+            return mJobs[i];
+        }
+    }
+    return NULL;
+}
+
+bool WorkerPool::runNext(Job *job, std::unique_lock<std::mutex> &lock) {
+    if (job->next >= job->count) {
+        return false;
+    }
+    const int index = job->next++;
+    if (job->next == job->count) {
+        // 所有项都已分配, 其他线程不必再加入
+        mJobs.erase(std::find(mJobs.begin(), mJobs.end(), job));
+    }
+    lock.unlock();
+    (*job->task)(index);
+    lock.lock();
+    // 最后一项完成后提交者可能立即返回并销毁 job, 之后只能在持有锁时访问
+    if (++job->done == job->count) {
+        job->finished.notify_all();
+    }
+    return true;
+}
+
+void WorkerPool::run(int count, int threads, const std::function<void(int)> &task) {
+    if (count <= 1 || threads <= 1) {
+        for (int i = 0; i < count; i++) {
+            task(i);
+        }
+        return;
+    }
+    Job job;
+    job.task = &task;
+    job.count = count;
+    job.next = 0;
+    job.done = 0;
+    job.workers = 0;
+    job.maxWorkers = std::min(threads, count) - 1;
+
+    std::unique_lock<std::mutex> lock(mLock);
+    ensureWorkers(job.maxWorkers);
+    mJobs.push_back(&job);
+    mWake.notify_all();
+    while (runNext(&job, lock)) {
+    }
+    job.finished.wait(lock, [&job] { return job.done == job.count; });
+}
+
+void WorkerPool::workerLoop() {
+    std::unique_lock<std::mutex> lock(mLock);
+    while (true) {
+        Job *job = NULL;
+        mWake.wait(lock, [this, &job] {
+            job = findJob();
+            return mStopping || job;
+        });
+        if (mStopping) {
+            return;
+        }
+        job->workers++;
+        while (runNext(job, lock)) {
+        }
+    }
+}
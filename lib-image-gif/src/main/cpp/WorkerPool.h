@@ -0,0 +1,61 @@
+/**
+ * 进程内共用的工作线程: 把一段可以拆分的工作 (例如 drawFrame 按行分带合成) 分给多个线程执行,
+ * 调用线程也参与, 全部完成后返回. 线程在第一次需要时创建, 空闲时阻塞等待, 不占用 CPU.
+ * 多个解码器可以同时提交, 先提交的工作先分配.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPool {
+public:
+    static WorkerPool &get();
+
+    // 可用的 CPU 核数, 至少为 1
+    static int getCpuCount();
+
+    /**
+     * 执行 task(0) 到 task(count - 1), 每一项只执行一次, 顺序不定; 全部完成后返回.
+     * 最多同时使用 threads 个线程 (含调用线程), threads 不超过 1 或只有一项时直接在调用线程执行
+     */
+    void run(int count, int threads, const std::function<void(int)> &task);
+
+private:
+    struct Job {
+        const std::function<void(int)> *task;
+        int count;
+        // 下一个未分配的项, 以及已完成的项数
+        int next;
+        int done;
+        // 已加入的工作线程数, 不超过 maxWorkers
+        int workers;
+        int maxWorkers;
+        std::condition_variable finished;
+    };
+
+    WorkerPool() = default;
+
+    ~WorkerPool();
+
+    // 工作线程不足 count 个时补足, 需持有 mLock
+    void ensureWorkers(int count);
+
+    void workerLoop();
+
+    // 分配 job 的下一项并执行, 没有未分配的项时返回 false; 需持有 lock, 执行 task 时释放
+    bool runNext(Job *job, std::unique_lock<std::mutex> &lock);
+
+    // 还有未分配的项且工作线程未满的工作, 没有时返回 NULL; 需持有 mLock
+    Job *findJob();
+
+    std::mutex mLock;
+    std::condition_variable mWake;
+    std::vector<Job *> mJobs;
+    std::vector<std::thread> mWorkers;
+    bool mStopping = false;
+};
@@ -33,11 +33,210 @@ SPDX-License-Identifier: MIT
 
 /* avoid extra function call in case we use fread (TVT) */
 static int InternalRead(GifFileType *gif, GifByteType *buf, int len) {
+    GifFilePrivateType *Private = (GifFilePrivateType *) gif->Private;
+    int Read;
+
     //fprintf(stderr, "### Read: %d\n", len);
-    return
-            (((GifFilePrivateType *) gif->Private)->Read ?
-             ((GifFilePrivateType *) gif->Private)->Read(gif, buf, len) :
-             fread(buf, 1, len, ((GifFilePrivateType *) gif->Private)->File));
+    if (Private->Memory) {
+        size_t Left = Private->MemorySize - (size_t) Private->Position;
+
+        Read = (size_t) len < Left ? len : (int) Left;
+        memcpy(buf, Private->Memory + Private->Position, Read);
+        Private->Position += Read;
+        return Read;
+    }
+    Read = Private->Read ?
+           Private->Read(gif, buf, len) :
+           (int) fread(buf, 1, len, Private->File);
+    if (Read > 0)
+        Private->Position += Read;
+    return Read;
+}
+
+/* point *data at the next len bytes of a memory input and consume them;
+ * returns the number of bytes available, as InternalRead would copy */
+static int InternalMap(GifFileType *gif, const GifByteType **data, int len) {
+    GifFilePrivateType *Private = (GifFilePrivateType *) gif->Private;
+    size_t Left = Private->MemorySize - (size_t) Private->Position;
+    int Read = (size_t) len < Left ? len : (int) Left;
+
+    *data = Private->Memory + Private->Position;
+    Private->Position += Read;
+    return Read;
+}
+
+/* skip len (at most 255) bytes of input; input functions cannot seek */
+static int InternalSkip(GifFileType *gif, int len) {
+    GifFilePrivateType *Private = (GifFilePrivateType *) gif->Private;
+    const GifByteType *Unused;
+
+    if (Private->Memory)
+        return InternalMap(gif, &Unused, len);
+    return InternalRead(gif, Private->Buf, len);
+}
+
+static GifRecycler Recycler;    /* All NULL: plain malloc and free. */
+
+/* allocate a decoder's GifFileType together with its private state */
+static GifFileType *DGifAllocFile(void) {
+    GifDecoderState *State = NULL;
+
+    if (Recycler.TakeState)
+        State = (GifDecoderState *) Recycler.TakeState(sizeof(GifDecoderState));
+    if (State) {
+        /* a recycled state keeps its spare SavedImages array */
+        memset(&State->File, '\0', sizeof(GifFileType));
+        memset(&State->Private, '\0', sizeof(GifFilePrivateType));
+    } else {
+        State = (GifDecoderState *) calloc(1, sizeof(GifDecoderState));
+        if (State == NULL)
+            return NULL;
+    }
+
+    /* Belt and suspenders, in case the null pointer isn't zero */
+    State->File.SavedImages = NULL;
+    State->File.SColorMap = NULL;
+    State->File.Private = (void *) &State->Private;
+    return &State->File;
+}
+
+#define ARENA_ALIGN          16
+#define ARENA_HEADER_SIZE    ((sizeof(GifArenaChunk) + ARENA_ALIGN - 1) & \
+                              ~(size_t) (ARENA_ALIGN - 1))
+#define ARENA_MIN_CHUNK      (64 * 1024)
+#define ARENA_MAX_CHUNK      (4 * 1024 * 1024)
+
+static void *DGifTakeBlock(size_t Size) {
+    return Recycler.TakeRaster ? Recycler.TakeRaster(Size) : malloc(Size);
+}
+
+static void DGifGiveBlock(void *Block, size_t Size) {
+    if (!(Recycler.GiveRaster && Recycler.GiveRaster(Block, Size)))
+        free(Block);
+}
+
+/* bump allocate Size bytes from the arena of a file: shared chunks double
+ * from ARENA_MIN_CHUNK, an allocation of half a chunk or more gets its own */
+static void *DGifArenaAlloc(GifFilePrivateType *Private, size_t Size) {
+    GifArenaChunk *Chunk = Private->Arena;
+    size_t ChunkSize;
+    void *Result;
+
+    if (Size > SIZE_MAX - ARENA_HEADER_SIZE - ARENA_ALIGN)
+        return NULL;
+    Size = (Size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+    if (Chunk == NULL || Chunk->Size - Chunk->Used < Size) {
+        if (Private->ArenaChunkSize == 0)
+            Private->ArenaChunkSize = ARENA_MIN_CHUNK;
+        ChunkSize = Private->ArenaChunkSize;
+        if (Size >= ChunkSize / 2) {
+            Chunk = (GifArenaChunk *) DGifTakeBlock(ARENA_HEADER_SIZE + Size);
+            if (Chunk == NULL)
+                return NULL;
+            Chunk->Size = Size;
+            Chunk->Used = Size;
+            /* keep filling the current shared chunk */
+            if (Private->Arena != NULL) {
+                Chunk->Next = Private->Arena->Next;
+                Private->Arena->Next = Chunk;
+            } else {
+                Chunk->Next = NULL;
+                Private->Arena = Chunk;
+            }
+            return (char *) Chunk + ARENA_HEADER_SIZE;
+        }
+        Chunk = (GifArenaChunk *) DGifTakeBlock(ARENA_HEADER_SIZE + ChunkSize);
+        if (Chunk == NULL)
+            return NULL;
+        Chunk->Size = ChunkSize;
+        Chunk->Used = 0;
+        Chunk->Next = Private->Arena;
+        Private->Arena = Chunk;
+        if (ChunkSize < ARENA_MAX_CHUNK)
+            Private->ArenaChunkSize = ChunkSize * 2;
+    }
+    Result = (char *) Chunk + ARENA_HEADER_SIZE + Chunk->Used;
+    Chunk->Used += Size;
+    return Result;
+}
+
+/* release all arena chunks at once */
+static void DGifFreeArena(GifFilePrivateType *Private) {
+    GifArenaChunk *Chunk = Private->Arena, *Next;
+
+    while (Chunk != NULL) {
+        Next = Chunk->Next;
+        DGifGiveBlock(Chunk, ARENA_HEADER_SIZE + Chunk->Size);
+        Chunk = Next;
+    }
+    Private->Arena = NULL;
+}
+
+/* copy of a color map, from the arena if the file uses one */
+static ColorMapObject *DGifCopyMapObject(GifFileType *GifFile,
+                                         const ColorMapObject *Source) {
+    GifFilePrivateType *Private = (GifFilePrivateType *) GifFile->Private;
+    ColorMapObject *Object;
+
+    if (!Private->UseArena)
+        return GifMakeMapObject(Source->ColorCount, Source->Colors);
+    Object = (ColorMapObject *) DGifArenaAlloc(Private, sizeof(ColorMapObject));
+    if (Object == NULL)
+        return NULL;
+    Object->Colors = (GifColorType *) DGifArenaAlloc(
+            Private, Source->ColorCount * sizeof(GifColorType));
+    if (Object->Colors == NULL)
+        return NULL;
+    Object->ColorCount = Source->ColorCount;
+    Object->BitsPerPixel = Source->BitsPerPixel;
+    Object->SortFlag = false;
+    memcpy(Object->Colors, Source->Colors,
+           Source->ColorCount * sizeof(GifColorType));
+    return Object;
+}
+
+/* free the images of GifFile and hand its state to the recycler */
+static void DGifFreeFile(GifFileType *GifFile) {
+    GifDecoderState *State = (GifDecoderState *) GifFile;
+    SavedImage *sp;
+
+    DGifFreeScratch(GifFile);
+
+    if (State->Private.UseArena) {
+        /* all saved image data lives in the arena */
+        DGifFreeArena(&State->Private);
+        GifFile->ExtensionBlocks = NULL;
+        GifFile->ExtensionBlockCount = 0;
+    } else {
+        GifFreeExtensions(&GifFile->ExtensionBlockCount,
+                          &GifFile->ExtensionBlocks);
+    }
+
+    if (GifFile->SavedImages) {
+        for (sp = GifFile->SavedImages;
+             !State->Private.UseArena &&
+             sp < GifFile->SavedImages + GifFile->ImageCount; sp++) {
+            if (sp->ImageDesc.ColorMap != NULL)
+                GifFreeMapObject(sp->ImageDesc.ColorMap);
+            if (sp->RasterBits != NULL)
+                DGifGiveBlock(sp->RasterBits, (size_t) sp->ImageDesc.Width *
+                                              sp->ImageDesc.Height);
+            GifFreeExtensions(&sp->ExtensionBlockCount, &sp->ExtensionBlocks);
+        }
+        /* keep the larger array for the next file using this state */
+        if (State->Private.SavedImagesCapacity > State->SpareCapacity) {
+            free(State->SpareImages);
+            State->SpareImages = GifFile->SavedImages;
+            State->SpareCapacity = State->Private.SavedImagesCapacity;
+        } else {
+            free(GifFile->SavedImages);
+        }
+        GifFile->SavedImages = NULL;
+    }
+
+    if (!(Recycler.GiveState &&
+          Recycler.GiveState(State, sizeof(GifDecoderState))))
+        DGifFreeState(State);
 }
 
 static int DGifGetWord(GifFileType *GifFile, GifWord *Word);
@@ -54,6 +253,12 @@ static int DGifDecompressInput(GifFileType *GifFile, int *Code);
 static int DGifBufferedInput(GifFileType *GifFile, GifByteType *Buf,
                              GifByteType *NextByte);
 
+static int DGifDecompressRows(GifFileType *GifFile, GifPixelType *Line,
+                              GifRowFunc RowFunc, void *UserData);
+
+static int DGifDecompressImage(GifFileType *GifFile, GifPixelType *Pixels,
+                               size_t PixelCount);
+
 /******************************************************************************
  Open a new GIF file for read, given by its name.
  Returns dynamically allocated GifFileType pointer which serves as the GIF
@@ -86,30 +291,14 @@ DGifOpenFileHandle(int FileHandle, int *Error) {
     GifFilePrivateType *Private;
     FILE *f;
 
-    GifFile = (GifFileType *) malloc(sizeof(GifFileType));
+    GifFile = DGifAllocFile();
     if (GifFile == NULL) {
         if (Error != NULL)
             *Error = D_GIF_ERR_NOT_ENOUGH_MEM;
         (void) close(FileHandle);
         return NULL;
     }
-
-    /*@i1@*/memset(GifFile, '\0', sizeof(GifFileType));
-
-    /* Belt and suspenders, in case the null pointer isn't zero */
-    GifFile->SavedImages = NULL;
-    GifFile->SColorMap = NULL;
-
-    Private = (GifFilePrivateType *) calloc(1, sizeof(GifFilePrivateType));
-    if (Private == NULL) {
-        if (Error != NULL)
-            *Error = D_GIF_ERR_NOT_ENOUGH_MEM;
-        (void) close(FileHandle);
-        free((char *) GifFile);
-        return NULL;
-    }
-
-    /*@i1@*/memset(Private, '\0', sizeof(GifFilePrivateType));
+    Private = (GifFilePrivateType *) GifFile->Private;
 
 #ifdef _WIN32
     _setmode(FileHandle, O_BINARY);    /* Make sure it is in binary mode. */
@@ -118,7 +307,6 @@ DGifOpenFileHandle(int FileHandle, int *Error) {
     f = fdopen(FileHandle, "rb");    /* Make it into a stream: */
 
     /*@-mustfreeonly@*/
-    GifFile->Private = (void *) Private;
     Private->FileHandle = FileHandle;
     Private->File = f;
     Private->FileState = FILE_STATE_READ;
@@ -132,8 +320,7 @@ DGifOpenFileHandle(int FileHandle, int *Error) {
         if (Error != NULL)
             *Error = D_GIF_ERR_READ_FAILED;
         (void) fclose(f);
-        free((char *) Private);
-        free((char *) GifFile);
+        DGifFreeFile(GifFile);
         return NULL;
     }
 
@@ -143,15 +330,13 @@ DGifOpenFileHandle(int FileHandle, int *Error) {
         if (Error != NULL)
             *Error = D_GIF_ERR_NOT_GIF_FILE;
         (void) fclose(f);
-        free((char *) Private);
-        free((char *) GifFile);
+        DGifFreeFile(GifFile);
         return NULL;
     }
 
     if (DGifGetScreenDesc(GifFile) == GIF_ERROR) {
         (void) fclose(f);
-        free((char *) Private);
-        free((char *) GifFile);
+        DGifFreeFile(GifFile);
         return NULL;
     }
 
@@ -164,42 +349,31 @@ DGifOpenFileHandle(int FileHandle, int *Error) {
 }
 
 /******************************************************************************
- GifFileType constructor with user supplied input function (TVT)
+ Shared by DGifOpen() and DGifOpenMemory(): input comes from readFunc, or
+ from Data when it is not NULL.
 ******************************************************************************/
-GifFileType *
-DGifOpen(void *userData, InputFunc readFunc, int *Error) {
+static GifFileType *
+DGifOpenInternal(void *userData, InputFunc readFunc,
+                 const GifByteType *Data, size_t Size, int *Error) {
     char Buf[GIF_STAMP_LEN + 1];
     GifFileType *GifFile;
     GifFilePrivateType *Private;
 
-    GifFile = (GifFileType *) malloc(sizeof(GifFileType));
+    GifFile = DGifAllocFile();
     if (GifFile == NULL) {
         if (Error != NULL)
             *Error = D_GIF_ERR_NOT_ENOUGH_MEM;
         return NULL;
     }
+    Private = (GifFilePrivateType *) GifFile->Private;
 
-    memset(GifFile, '\0', sizeof(GifFileType));
-
-    /* Belt and suspenders, in case the null pointer isn't zero */
-    GifFile->SavedImages = NULL;
-    GifFile->SColorMap = NULL;
-
-    Private = (GifFilePrivateType *) calloc(1, sizeof(GifFilePrivateType));
-    if (!Private) {
-        if (Error != NULL)
-            *Error = D_GIF_ERR_NOT_ENOUGH_MEM;
-        free((char *) GifFile);
-        return NULL;
-    }
-    /*@i1@*/memset(Private, '\0', sizeof(GifFilePrivateType));
-
-    GifFile->Private = (void *) Private;
     Private->FileHandle = 0;
     Private->File = NULL;
     Private->FileState = FILE_STATE_READ;
 
     Private->Read = readFunc;    /* TVT */
+    Private->Memory = Data;
+    Private->MemorySize = Size;
     GifFile->UserData = userData;    /* TVT */
 
     /* Lets see if this is a GIF file: */
@@ -207,8 +381,7 @@ DGifOpen(void *userData, InputFunc readFunc, int *Error) {
     if (InternalRead(GifFile, (unsigned char *) Buf, GIF_STAMP_LEN) != GIF_STAMP_LEN) {
         if (Error != NULL)
             *Error = D_GIF_ERR_READ_FAILED;
-        free((char *) Private);
-        free((char *) GifFile);
+        DGifFreeFile(GifFile);
         return NULL;
     }
 
@@ -217,14 +390,12 @@ DGifOpen(void *userData, InputFunc readFunc, int *Error) {
     if (strncmp(GIF_STAMP, Buf, GIF_VERSION_POS) != 0) {
         if (Error != NULL)
             *Error = D_GIF_ERR_NOT_GIF_FILE;
-        free((char *) Private);
-        free((char *) GifFile);
+        DGifFreeFile(GifFile);
         return NULL;
     }
 
     if (DGifGetScreenDesc(GifFile) == GIF_ERROR) {
-        free((char *) Private);
-        free((char *) GifFile);
+        DGifFreeFile(GifFile);
         if (Error != NULL)
             *Error = D_GIF_ERR_NO_SCRN_DSCR;
         return NULL;
@@ -238,6 +409,235 @@ DGifOpen(void *userData, InputFunc readFunc, int *Error) {
     return GifFile;
 }
 
+/******************************************************************************
+ GifFileType constructor with user supplied input function (TVT)
+******************************************************************************/
+GifFileType *
+DGifOpen(void *userData, InputFunc readFunc, int *Error) {
+    return DGifOpenInternal(userData, readFunc, NULL, 0, Error);
+}
+
+/******************************************************************************
+ GifFileType constructor reading Size bytes at Data in place: no input
+ function is called and LZW data sub-blocks are decoded without being copied.
+ Data must stay valid and unchanged until DGifCloseFile().
+******************************************************************************/
+GifFileType *
+DGifOpenMemory(const void *Data, size_t Size, int *Error) {
+    if (Data == NULL) {
+        if (Error != NULL)
+            *Error = D_GIF_ERR_OPEN_FAILED;
+        return NULL;
+    }
+    return DGifOpenInternal(NULL, NULL, (const GifByteType *) Data, Size,
+                            Error);
+}
+
+/******************************************************************************
+ Move the input of a DGifOpenMemory() file to Offset, e.g. an ImageOffset
+ recorded by DGifScan(), before DGifGetImageHeader().  Other inputs cannot
+ seek.
+******************************************************************************/
+int
+DGifSeek(GifFileType *GifFile, long Offset) {
+    GifFilePrivateType *Private = (GifFilePrivateType *) GifFile->Private;
+
+    if (Private->Memory == NULL || Offset < 0 ||
+        (size_t) Offset > Private->MemorySize) {
+        GifFile->Error = D_GIF_ERR_READ_FAILED;
+        return GIF_ERROR;
+    }
+    Private->Position = Offset;
+    Private->Buf[0] = 0;
+    return GIF_OK;
+}
+
+/******************************************************************************
+ The data a DGifOpenMemory() file reads, and its size in *Size if Size is not
+ NULL, e.g. to hand the LZW data at the CodeOffset recorded by DGifScan() to
+ DGifDecompressCode() of another file.  NULL for other inputs.
+******************************************************************************/
+const GifByteType *
+DGifGetMemory(const GifFileType *GifFile, size_t *Size) {
+    const GifFilePrivateType *Private =
+            (const GifFilePrivateType *) GifFile->Private;
+
+    if (Size != NULL)
+        *Size = Private->Memory != NULL ? Private->MemorySize : 0;
+    return Private->Memory;
+}
+
+/******************************************************************************
+ Install hooks that keep decoder state blocks (GifFileType, LZW tables and
+ the SavedImages array) and RasterBits of closed files for later files, or
+ NULL to go back to malloc and free.  Must be called before any file is
+ opened, and the hooks must be thread safe if files are decoded in parallel.
+******************************************************************************/
+void
+DGifSetRecycler(const GifRecycler *NewRecycler) {
+    if (NewRecycler != NULL)
+        Recycler = *NewRecycler;
+    else
+        memset(&Recycler, '\0', sizeof(Recycler));
+}
+
+/******************************************************************************
+ Free a state block a recycler took with GiveState and will not hand back.
+******************************************************************************/
+void
+DGifFreeState(void *State) {
+    if (State != NULL) {
+        free(((GifDecoderState *) State)->SpareImages);
+        free(State);
+    }
+}
+
+/* decompress an image from kept LZW data into Raster, or row by row through
+ * RowFunc when Raster is NULL, and put the input of GifFile back */
+static int
+DGifDecompressCodeInternal(GifFileType *GifFile, const GifImageDesc *Desc,
+                           const GifByteType *Code, size_t CodeLength,
+                           GifPixelType *Raster, GifPixelType *Line,
+                           GifRowFunc RowFunc, void *UserData) {
+    GifFilePrivateType *Private = (GifFilePrivateType *) GifFile->Private;
+    const GifByteType *Memory = Private->Memory;
+    size_t MemorySize = Private->MemorySize;
+    long Position = Private->Position;
+    int Result;
+
+    if (!IS_READABLE(Private)) {
+        GifFile->Error = D_GIF_ERR_NOT_READABLE;
+        return GIF_ERROR;
+    }
+
+    Private->Memory = Code;
+    Private->MemorySize = CodeLength;
+    Private->Position = 0;
+    GifFile->Image.Left = Desc->Left;
+    GifFile->Image.Top = Desc->Top;
+    GifFile->Image.Width = Desc->Width;
+    GifFile->Image.Height = Desc->Height;
+    GifFile->Image.Interlace = Desc->Interlace;
+    Private->PixelCount = (long) Desc->Width * (long) Desc->Height;
+
+    if (DGifSetupDecompress(GifFile) == GIF_ERROR) {
+        GifFile->Error = D_GIF_ERR_READ_FAILED;
+        Result = GIF_ERROR;
+    } else if (Raster != NULL) {
+        Result = DGifGetImage(GifFile, Raster);
+    } else {
+        Result = DGifGetImageRows(GifFile, Line, RowFunc, UserData);
+    }
+
+    Private->Memory = Memory;
+    Private->MemorySize = MemorySize;
+    Private->Position = Position;
+    Private->Buf[0] = 0;
+    return Result;
+}
+
+/******************************************************************************
+ Decompress an image from its LZW data alone: the CodeLength bytes DGifScan()
+ recorded at CodeOffset (code size byte, sub-blocks and terminator) of the
+ image described by Desc, kept after the input may be gone.  The input of
+ GifFile is left where it was.
+******************************************************************************/
+int
+DGifDecompressCode(GifFileType *GifFile, const GifImageDesc *Desc,
+                   const GifByteType *Code, size_t CodeLength,
+                   GifPixelType *Raster) {
+    return DGifDecompressCodeInternal(GifFile, Desc, Code, CodeLength, Raster,
+                                      NULL, NULL, NULL);
+}
+
+/******************************************************************************
+ DGifDecompressCode() one row at a time, see DGifGetImageRows().
+******************************************************************************/
+int
+DGifDecompressCodeRows(GifFileType *GifFile, const GifImageDesc *Desc,
+                       const GifByteType *Code, size_t CodeLength,
+                       GifPixelType *Line, GifRowFunc RowFunc,
+                       void *UserData) {
+    return DGifDecompressCodeInternal(GifFile, Desc, Code, CodeLength, NULL,
+                                      Line, RowFunc, UserData);
+}
+
+/******************************************************************************
+ Allocate the RasterBits, local color maps and extension blocks of the
+ images read from GifFile out of a few large chunks that DGifCloseFile()
+ frees at once, instead of one heap block each.  Must be called before any
+ image or extension is read.
+******************************************************************************/
+int
+DGifSetArena(GifFileType *GifFile, bool Enable) {
+    GifFilePrivateType *Private = (GifFilePrivateType *) GifFile->Private;
+
+    if (GifFile->ImageCount > 0 || GifFile->ExtensionBlocks != NULL) {
+        GifFile->Error = D_GIF_ERR_WRONG_RECORD;
+        return GIF_ERROR;
+    }
+    Private->UseArena = Enable;
+    return GIF_OK;
+}
+
+/******************************************************************************
+ Allocate Size bytes for the RasterBits of a SavedImage of GifFile the way
+ DGifSlurp() does, so DGifCloseFile() can free or recycle them.
+******************************************************************************/
+GifPixelType *
+DGifAllocRaster(GifFileType *GifFile, size_t Size) {
+    GifFilePrivateType *Private = (GifFilePrivateType *) GifFile->Private;
+
+    if (Private->UseArena)
+        return (GifPixelType *) DGifArenaAlloc(Private, Size);
+    return (GifPixelType *) DGifTakeBlock(Size);
+}
+
+/******************************************************************************
+ GifAddExtensionBlock() for the extension blocks saved with GifFile, which
+ come from its arena when it has one.
+******************************************************************************/
+int
+DGifAddExtensionBlock(GifFileType *GifFile,
+                      int *ExtensionBlockCount,
+                      ExtensionBlock **ExtensionBlocks,
+                      int Function,
+                      unsigned int Len,
+                      unsigned char ExtData[]) {
+    GifFilePrivateType *Private = (GifFilePrivateType *) GifFile->Private;
+    int Count = *ExtensionBlockCount;
+    ExtensionBlock *ep;
+
+    if (!Private->UseArena)
+        return GifAddExtensionBlock(ExtensionBlockCount, ExtensionBlocks,
+                                    Function, Len, ExtData);
+
+    /* capacity is 4, then doubles: grow when Count reaches it */
+    if (Count == 0 || (Count >= 4 && (Count & (Count - 1)) == 0)) {
+        int Capacity = Count ? Count * 2 : 4;
+        ExtensionBlock *NewBlocks = (ExtensionBlock *) DGifArenaAlloc(
+                Private, Capacity * sizeof(ExtensionBlock));
+
+        if (NewBlocks == NULL)
+            return GIF_ERROR;
+        if (Count > 0)
+            memcpy(NewBlocks, *ExtensionBlocks, Count * sizeof(ExtensionBlock));
+        *ExtensionBlocks = NewBlocks;
+    }
+
+    ep = &(*ExtensionBlocks)[Count];
+    ep->Function = Function;
+    ep->ByteCount = Len;
+    ep->Bytes = (GifByteType *) DGifArenaAlloc(Private, Len);
+    if (ep->Bytes == NULL)
+        return GIF_ERROR;
+    if (ExtData != NULL)
+        memcpy(ep->Bytes, ExtData, Len);
+    *ExtensionBlockCount = Count + 1;
+
+    return GIF_OK;
+}
+
 /******************************************************************************
  This routine should be called before any other DGif calls. Note that
  this routine is called automatically from DGif file open routines.
@@ -438,29 +838,35 @@ DGifGetImageDesc(GifFileType *GifFile) {
         return GIF_ERROR;
     }
 
-    if (GifFile->SavedImages) {
-        SavedImage *new_saved_images =
-                (SavedImage *) reallocarray(GifFile->SavedImages,
-                                            (GifFile->ImageCount + 1), sizeof(SavedImage));
-        if (new_saved_images == NULL) {
-            GifFile->Error = D_GIF_ERR_NOT_ENOUGH_MEM;
-            return GIF_ERROR;
-        }
-        GifFile->SavedImages = new_saved_images;
-    } else {
-        if ((GifFile->SavedImages =
-                     (SavedImage *) malloc(sizeof(SavedImage))) == NULL) {
-            GifFile->Error = D_GIF_ERR_NOT_ENOUGH_MEM;
-            return GIF_ERROR;
+    if (GifFile->ImageCount >= Private->SavedImagesCapacity) {
+        GifDecoderState *State = (GifDecoderState *) GifFile;
+
+        if (GifFile->SavedImages == NULL && State->SpareImages != NULL) {
+            /* reuse the array of the file this state was recycled from */
+            GifFile->SavedImages = State->SpareImages;
+            Private->SavedImagesCapacity = State->SpareCapacity;
+            State->SpareImages = NULL;
+            State->SpareCapacity = 0;
+        } else {
+            int Capacity = Private->SavedImagesCapacity ?
+                           Private->SavedImagesCapacity * 2 : 8;
+            SavedImage *new_saved_images =
+                    (SavedImage *) reallocarray(GifFile->SavedImages,
+                                                Capacity, sizeof(SavedImage));
+            if (new_saved_images == NULL) {
+                GifFile->Error = D_GIF_ERR_NOT_ENOUGH_MEM;
+                return GIF_ERROR;
+            }
+            GifFile->SavedImages = new_saved_images;
+            Private->SavedImagesCapacity = Capacity;
         }
     }
 
     sp = &GifFile->SavedImages[GifFile->ImageCount];
     memcpy(&sp->ImageDesc, &GifFile->Image, sizeof(GifImageDesc));
     if (GifFile->Image.ColorMap != NULL) {
-        sp->ImageDesc.ColorMap = GifMakeMapObject(
-                GifFile->Image.ColorMap->ColorCount,
-                GifFile->Image.ColorMap->Colors);
+        sp->ImageDesc.ColorMap = DGifCopyMapObject(GifFile,
+                                                   GifFile->Image.ColorMap);
         if (sp->ImageDesc.ColorMap == NULL) {
             GifFile->Error = D_GIF_ERR_NOT_ENOUGH_MEM;
             return GIF_ERROR;
@@ -514,6 +920,55 @@ DGifGetLine(GifFileType *GifFile, GifPixelType *Line, int LineLen) {
         return GIF_ERROR;
 }
 
+/******************************************************************************
+ Decompress the current image one row at a time into Line (Image.Width
+ pixels) and hand each row to RowFunc with its row number, in the order the
+ rows are stored: pass by pass for an interlaced image.  Needs no raster for
+ the whole image.  With the table engine selected the rows come from
+ DGifDecompressRows(), which keeps the head of every string instead of
+ referring back to earlier output; otherwise the line by line (classic)
+ engine is the fallback.
+******************************************************************************/
+int
+DGifGetImageRows(GifFileType *GifFile, GifPixelType *Line,
+                 GifRowFunc RowFunc, void *UserData) {
+    static const int InterlacedOffset[] = {0, 4, 2, 1};
+    static const int InterlacedJumps[] = {8, 8, 4, 2};
+    int i, j, Width = GifFile->Image.Width, Height = GifFile->Image.Height;
+    GifFilePrivateType *Private = (GifFilePrivateType *) GifFile->Private;
+
+    if (!IS_READABLE(Private)) {
+        /* This file was NOT open for reading: */
+        GifFile->Error = D_GIF_ERR_NOT_READABLE;
+        return GIF_ERROR;
+    }
+
+    if (Private->LZWEngine == GIF_LZW_TABLE) {
+        if ((size_t) Width * Height != Private->PixelCount) {
+            GifFile->Error = D_GIF_ERR_DATA_TOO_BIG;
+            return GIF_ERROR;
+        }
+        return DGifDecompressRows(GifFile, Line, RowFunc, UserData);
+    }
+
+    if (!GifFile->Image.Interlace) {
+        for (j = 0; j < Height; j++) {
+            if (DGifGetLine(GifFile, Line, Width) == GIF_ERROR)
+                return GIF_ERROR;
+            RowFunc(UserData, j, Line);
+        }
+        return GIF_OK;
+    }
+
+    for (i = 0; i < 4; i++)
+        for (j = InterlacedOffset[i]; j < Height; j += InterlacedJumps[i]) {
+            if (DGifGetLine(GifFile, Line, Width) == GIF_ERROR)
+                return GIF_ERROR;
+            RowFunc(UserData, j, Line);
+        }
+    return GIF_OK;
+}
+
 /******************************************************************************
  Put one pixel (Pixel) into GIF file.
 ******************************************************************************/
@@ -549,6 +1004,109 @@ DGifGetPixel(GifFileType *GifFile, GifPixelType Pixel) {
         return GIF_ERROR;
 }
 
+/******************************************************************************
+ Select the LZW decompressor DGifGetImage() (and so DGifSlurp()) uses for
+ the following images.  Both produce identical pixels; GIF_LZW_CLASSIC is
+ the default.
+******************************************************************************/
+void
+DGifSetLZWEngine(GifFileType *GifFile, int Engine) {
+    GifFilePrivateType *Private = (GifFilePrivateType *) GifFile->Private;
+
+    Private->LZWEngine = Engine;
+}
+
+/******************************************************************************
+ Get the whole current image into Raster (Width * Height pixels, rows in
+ display order even if the image is interlaced).  Must be called right after
+ DGifGetImageDesc() or DGifGetImageHeader().
+******************************************************************************/
+int
+DGifGetImage(GifFileType *GifFile, GifPixelType *Raster) {
+    /*
+     * The way an interlaced image should be read -
+     * offsets and jumps...
+     */
+    static const int InterlacedOffset[] = {0, 4, 2, 1};
+    static const int InterlacedJumps[] = {8, 8, 4, 2};
+    int i, j, Width = GifFile->Image.Width, Height = GifFile->Image.Height;
+    size_t ImageSize = (size_t) Width * Height;
+    GifPixelType *Linear;
+    GifFilePrivateType *Private = (GifFilePrivateType *) GifFile->Private;
+
+    if (!IS_READABLE(Private)) {
+        /* This file was NOT open for reading: */
+        GifFile->Error = D_GIF_ERR_NOT_READABLE;
+        return GIF_ERROR;
+    }
+
+    if (Private->LZWEngine != GIF_LZW_TABLE) {
+        if (!GifFile->Image.Interlace)
+            return DGifGetLine(GifFile, Raster, ImageSize);
+        /* Need to perform 4 passes on the image */
+        for (i = 0; i < 4; i++)
+            for (j = InterlacedOffset[i]; j < Height; j += InterlacedJumps[i])
+                if (DGifGetLine(GifFile, Raster + (size_t) j * Width,
+                                Width) == GIF_ERROR)
+                    return GIF_ERROR;
+        return GIF_OK;
+    }
+
+    if (ImageSize != Private->PixelCount) {
+        GifFile->Error = D_GIF_ERR_DATA_TOO_BIG;
+        return GIF_ERROR;
+    }
+    if (!GifFile->Image.Interlace)
+        return DGifDecompressImage(GifFile, Raster, ImageSize);
+
+    /* The table engine needs the rows in stream order, so decode them into
+     * the scratch raster of the file and move each pass into place
+     * afterwards.  The scratch only grows, for the largest interlaced image
+     * so far, and comes from the recycler like RasterBits. */
+    if (Private->ScratchSize < ImageSize) {
+        DGifFreeScratch(GifFile);
+        Private->Scratch = (GifPixelType *) DGifTakeBlock(ImageSize);
+        if (Private->Scratch == NULL) {
+            GifFile->Error = D_GIF_ERR_NOT_ENOUGH_MEM;
+            return GIF_ERROR;
+        }
+        Private->ScratchSize = ImageSize;
+    }
+    Linear = Private->Scratch;
+    if (DGifDecompressImage(GifFile, Linear, ImageSize) == GIF_ERROR)
+        return GIF_ERROR;
+    ImageSize = 0;
+    for (i = 0; i < 4; i++)
+        for (j = InterlacedOffset[i]; j < Height; j += InterlacedJumps[i]) {
+            memcpy(Raster + (size_t) j * Width, Linear + ImageSize, Width);
+            ImageSize += Width;
+        }
+    return GIF_OK;
+}
+
+/******************************************************************************
+ Bytes held by the scratch raster DGifGetImage() decodes interlaced images
+ through with the table engine, 0 if none.
+******************************************************************************/
+size_t
+DGifGetScratchSize(const GifFileType *GifFile) {
+    return ((const GifFilePrivateType *) GifFile->Private)->ScratchSize;
+}
+
+/******************************************************************************
+ Give the scratch raster back, e.g. once all images are decoded.  The next
+ interlaced image decoded with the table engine takes a new one.
+******************************************************************************/
+void
+DGifFreeScratch(GifFileType *GifFile) {
+    GifFilePrivateType *Private = (GifFilePrivateType *) GifFile->Private;
+
+    if (Private->Scratch != NULL)
+        DGifGiveBlock(Private->Scratch, Private->ScratchSize);
+    Private->Scratch = NULL;
+    Private->ScratchSize = 0;
+}
+
 /******************************************************************************
  Get an extension block (see GIF manual) from GIF file. This routine only
  returns the first data block, and DGifGetExtensionNext should be called
@@ -678,34 +1236,24 @@ DGifCloseFile(GifFileType *GifFile, int *ErrorCode) {
         GifFile->SColorMap = NULL;
     }
 
-    if (GifFile->SavedImages) {
-        GifFreeSavedImages(GifFile);
-        GifFile->SavedImages = NULL;
-    }
-
-    GifFreeExtensions(&GifFile->ExtensionBlockCount, &GifFile->ExtensionBlocks);
-
     Private = (GifFilePrivateType *) GifFile->Private;
 
     if (!IS_READABLE(Private)) {
         /* This file was NOT open for reading: */
         if (ErrorCode != NULL)
             *ErrorCode = D_GIF_ERR_NOT_READABLE;
-        free((char *) GifFile->Private);
-        free(GifFile);
+        DGifFreeFile(GifFile);
         return GIF_ERROR;
     }
 
     if (Private->File && (fclose(Private->File) != 0)) {
         if (ErrorCode != NULL)
             *ErrorCode = D_GIF_ERR_CLOSE_FAILED;
-        free((char *) GifFile->Private);
-        free(GifFile);
+        DGifFreeFile(GifFile);
         return GIF_ERROR;
     }
 
-    free((char *) GifFile->Private);
-    free(GifFile);
+    DGifFreeFile(GifFile);
     if (ErrorCode != NULL)
         *ErrorCode = D_GIF_SUCCEEDED;
     return GIF_OK;
@@ -1101,6 +1649,372 @@ DGifBufferedInput(GifFileType *GifFile, GifByteType *Buf, GifByteType *NextByte)
     return GIF_OK;
 }
 
+/******************************************************************************
+ The table driven LZ decompression routine:
+ Decompress a whole image into Pixels, PixelCount long.  Rather than tracing
+ prefix chains through Prefix[]/Suffix[], every code remembers where its
+ string was last written to Pixels (StringOffset[], StringLength[]), so a
+ code expands with a single copy out of the output itself.  Codes are pulled
+ from a 64 bit buffer refilled from whole data sub-blocks.  Code width and
+ table growth follow DGifDecompressInput()/DGifDecompressLine() exactly, so
+ the output is identical to the classic engine.
+******************************************************************************/
+static int
+DGifDecompressImage(GifFileType *GifFile, GifPixelType *Pixels,
+                    size_t PixelCount) {
+    GifByteType BlockBuf[255 + 8];    /* Sub-block, padded for 8 byte loads. */
+    const GifByteType *Block = BlockBuf;
+    int BlockLen = 0, BlockPos = 0, EndOfData = 0, BitCount = 0;
+    uint64_t BitBuf = 0;
+    int Code, RunningBits, MaxCode1, RunningCode, NextCode, CodeMask;
+    int LastCode = NO_SUCH_CODE;
+    size_t Out = 0, LastStart = 0, Start, Len, Count;
+    GifByteType Byte;
+    GifFilePrivateType *Private = (GifFilePrivateType *) GifFile->Private;
+    unsigned int *StringOffset = Private->StringOffset;
+    unsigned short *StringLength = Private->StringLength;
+    const int ClearCode = Private->ClearCode, EOFCode = Private->EOFCode;
+
+    RunningCode = Private->RunningCode;
+    RunningBits = Private->RunningBits;
+    MaxCode1 = Private->MaxCode1;
+    NextCode = EOFCode + 1;
+    CodeMask = (1 << RunningBits) - 1;
+
+    while (Out < PixelCount) {
+        if (BitCount < RunningBits) {
+            /* Top the bit buffer up, 8 bytes at a time when the sub-block
+             * has them, byte by byte across sub-block boundaries. */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            if (BlockLen - BlockPos >= 8) {
+                uint64_t Word;
+                int Take = (63 - BitCount) >> 3;
+
+                memcpy(&Word, Block + BlockPos, sizeof(Word));
+                Word &= ((uint64_t) 1 << (Take * 8)) - 1;
+                BitBuf |= Word << BitCount;
+                BlockPos += Take;
+                BitCount += Take * 8;
+            }
+#endif
+            while (BitCount <= 56) {
+                if (BlockPos == BlockLen) {
+                    if (EndOfData)
+                        break;
+                    /* coverity[check_return] */
+                    if (InternalRead(GifFile, &Byte, 1) != 1) {
+                        GifFile->Error = D_GIF_ERR_READ_FAILED;
+                        return GIF_ERROR;
+                    }
+                    if (Byte == 0) {
+                        EndOfData = 1;
+                        break;
+                    }
+                    /* A memory input is decoded in place; 8 byte loads
+                     * stay inside the sub-block either way. */
+                    if ((Private->Memory ?
+                         InternalMap(GifFile, &Block, Byte) :
+                         InternalRead(GifFile, BlockBuf, Byte)) != Byte) {
+                        GifFile->Error = D_GIF_ERR_READ_FAILED;
+                        return GIF_ERROR;
+                    }
+                    BlockLen = Byte;
+                    BlockPos = 0;
+                }
+                BitBuf |= (uint64_t) Block[BlockPos++] << BitCount;
+                BitCount += 8;
+            }
+            if (BitCount < RunningBits) {
+                /* Data ran out before all the pixels were decoded. */
+                GifFile->Error = D_GIF_ERR_IMAGE_DEFECT;
+                return GIF_ERROR;
+            }
+        }
+        Code = (int) (BitBuf & CodeMask);
+        BitBuf >>= RunningBits;
+        BitCount -= RunningBits;
+
+        if (RunningCode < LZ_MAX_CODE + 2 &&
+            ++RunningCode > MaxCode1 && RunningBits < LZ_BITS) {
+            MaxCode1 <<= 1;
+            RunningBits++;
+            CodeMask = (1 << RunningBits) - 1;
+        }
+
+        if (Code == ClearCode) {
+            /* We need to start over again: */
+            RunningCode = EOFCode + 1;
+            RunningBits = Private->BitsPerPixel + 1;
+            MaxCode1 = 1 << RunningBits;
+            CodeMask = MaxCode1 - 1;
+            NextCode = EOFCode + 1;
+            LastCode = NO_SUCH_CODE;
+            continue;
+        }
+        if (Code == EOFCode) {
+            GifFile->Error = D_GIF_ERR_EOF_TOO_SOON;
+            return GIF_ERROR;
+        }
+
+        Start = Out;
+        if (Code < ClearCode) {
+            /* This is simple - its pixel scalar, so add it to output: */
+            Pixels[Out] = (GifPixelType) Code;
+            Len = 1;
+        } else if (Code < NextCode) {
+            /* A known string: it lies wholly before Out, so copy it. */
+            const GifPixelType *Src = Pixels + StringOffset[Code];
+
+            Len = StringLength[Code];
+            if (Len <= 8 && PixelCount - Out >= 8 &&
+                PixelCount - StringOffset[Code] >= 8) {
+                uint64_t Word;
+
+                memcpy(&Word, Src, sizeof(Word));
+                memcpy(Pixels + Out, &Word, sizeof(Word));
+            } else {
+                Count = PixelCount - Out;
+                memcpy(Pixels + Out, Src, Len < Count ? Len : Count);
+            }
+        } else if (Code == NextCode && LastCode != NO_SUCH_CODE) {
+            /* The string being defined: last string plus its own first
+             * pixel.  The last string ends exactly at Out. */
+            Len = StringLength[LastCode] + 1;
+            Count = PixelCount - Out;
+            memcpy(Pixels + Out, Pixels + LastStart,
+                   Len - 1 < Count ? Len - 1 : Count);
+            if (Len <= Count)
+                Pixels[Out + Len - 1] = Pixels[LastStart];
+        } else {
+            GifFile->Error = D_GIF_ERR_IMAGE_DEFECT;
+            return GIF_ERROR;
+        }
+        Out += Len < PixelCount - Out ? Len : PixelCount - Out;
+
+        if (LastCode != NO_SUCH_CODE && NextCode <= LZ_MAX_CODE) {
+            StringOffset[NextCode] = (unsigned int) LastStart;
+            StringLength[NextCode] =
+                    (unsigned short) (StringLength[LastCode] + 1);
+            NextCode++;
+        }
+        StringLength[Code] = (unsigned short) Len;
+        LastStart = Start;
+        LastCode = Code;
+    }
+
+    /* Flush out the rest of the image until the empty block, as
+     * DGifGetLine does. */
+    while (!EndOfData) {
+        /* coverity[check_return] */
+        if (InternalRead(GifFile, &Byte, 1) != 1) {
+            GifFile->Error = D_GIF_ERR_READ_FAILED;
+            return GIF_ERROR;
+        }
+        if (Byte == 0)
+            EndOfData = 1;
+        else if (InternalSkip(GifFile, Byte) != Byte) {
+            GifFile->Error = D_GIF_ERR_READ_FAILED;
+            return GIF_ERROR;
+        }
+    }
+    Private->Buf[0] = 0;
+    Private->PixelCount = 0;
+
+    return GIF_OK;
+}
+
+/******************************************************************************
+ The table engine for DGifGetImageRows().  Without the whole image to copy
+ earlier strings from, a code's string is unwound through Prefix[] and
+ Suffix[], backwards straight into Line when it ends within the row, through
+ Stack otherwise; FirstChar[] spares walking the chain for new entries.
+ Input is read as in DGifDecompressImage().
+******************************************************************************/
+static int
+DGifDecompressRows(GifFileType *GifFile, GifPixelType *Line,
+                   GifRowFunc RowFunc, void *UserData) {
+    static const int InterlacedOffset[] = {0, 4, 2, 1};
+    static const int InterlacedJumps[] = {8, 8, 4, 2};
+    GifByteType BlockBuf[255 + 8];    /* Sub-block, padded for 8 byte loads. */
+    const GifByteType *Block = BlockBuf;
+    int BlockLen = 0, BlockPos = 0, EndOfData = 0, BitCount = 0;
+    uint64_t BitBuf = 0;
+    int Code, RunningBits, MaxCode1, RunningCode, NextCode, CodeMask;
+    int LastCode = NO_SUCH_CODE, String, Len, Count, InPlace, i;
+    const int Width = GifFile->Image.Width, Height = GifFile->Image.Height;
+    int Rows = 0, Row = 0, Pass = 0, X = 0;
+    GifByteType Byte, First, *Out, *End;
+    GifFilePrivateType *Private = (GifFilePrivateType *) GifFile->Private;
+    GifPrefixType *Prefix = Private->Prefix;
+    GifByteType *Suffix = Private->Suffix, *FirstChar = Private->FirstChar;
+    GifByteType *Stack = Private->Stack;
+    unsigned short *StringLength = Private->StringLength;
+    const int ClearCode = Private->ClearCode, EOFCode = Private->EOFCode;
+
+    for (i = 0; i < ClearCode; i++) {
+        Suffix[i] = FirstChar[i] = (GifByteType) i;
+        StringLength[i] = 1;
+    }
+    RunningCode = Private->RunningCode;
+    RunningBits = Private->RunningBits;
+    MaxCode1 = Private->MaxCode1;
+    NextCode = EOFCode + 1;
+    CodeMask = (1 << RunningBits) - 1;
+
+    while (Rows < Height) {
+        if (BitCount < RunningBits) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            if (BlockLen - BlockPos >= 8) {
+                uint64_t Word;
+                int Take = (63 - BitCount) >> 3;
+
+                memcpy(&Word, Block + BlockPos, sizeof(Word));
+                Word &= ((uint64_t) 1 << (Take * 8)) - 1;
+                BitBuf |= Word << BitCount;
+                BlockPos += Take;
+                BitCount += Take * 8;
+            }
+#endif
+            while (BitCount <= 56) {
+                if (BlockPos == BlockLen) {
+                    if (EndOfData)
+                        break;
+                    /* coverity[check_return] */
+                    if (InternalRead(GifFile, &Byte, 1) != 1) {
+                        GifFile->Error = D_GIF_ERR_READ_FAILED;
+                        return GIF_ERROR;
+                    }
+                    if (Byte == 0) {
+                        EndOfData = 1;
+                        break;
+                    }
+                    if ((Private->Memory ?
+                         InternalMap(GifFile, &Block, Byte) :
+                         InternalRead(GifFile, BlockBuf, Byte)) != Byte) {
+                        GifFile->Error = D_GIF_ERR_READ_FAILED;
+                        return GIF_ERROR;
+                    }
+                    BlockLen = Byte;
+                    BlockPos = 0;
+                }
+                BitBuf |= (uint64_t) Block[BlockPos++] << BitCount;
+                BitCount += 8;
+            }
+            if (BitCount < RunningBits) {
+                /* Data ran out before all the pixels were decoded. */
+                GifFile->Error = D_GIF_ERR_IMAGE_DEFECT;
+                return GIF_ERROR;
+            }
+        }
+        Code = (int) (BitBuf & CodeMask);
+        BitBuf >>= RunningBits;
+        BitCount -= RunningBits;
+
+        if (RunningCode < LZ_MAX_CODE + 2 &&
+            ++RunningCode > MaxCode1 && RunningBits < LZ_BITS) {
+            MaxCode1 <<= 1;
+            RunningBits++;
+            CodeMask = (1 << RunningBits) - 1;
+        }
+
+        if (Code == ClearCode) {
+            RunningCode = EOFCode + 1;
+            RunningBits = Private->BitsPerPixel + 1;
+            MaxCode1 = 1 << RunningBits;
+            CodeMask = MaxCode1 - 1;
+            NextCode = EOFCode + 1;
+            LastCode = NO_SUCH_CODE;
+            continue;
+        }
+        if (Code == EOFCode) {
+            GifFile->Error = D_GIF_ERR_EOF_TOO_SOON;
+            return GIF_ERROR;
+        }
+
+        if (Code < NextCode) {
+            /* A root pixel or a known string. */
+            String = Code;
+            Len = StringLength[Code];
+            First = FirstChar[Code];
+        } else if (Code == NextCode && LastCode != NO_SUCH_CODE) {
+            /* The string being defined: last string plus its own first
+             * pixel, which goes last. */
+            String = LastCode;
+            Len = StringLength[LastCode] + 1;
+            First = FirstChar[LastCode];
+        } else {
+            GifFile->Error = D_GIF_ERR_IMAGE_DEFECT;
+            return GIF_ERROR;
+        }
+
+        if (Len > LZ_MAX_CODE) {
+            GifFile->Error = D_GIF_ERR_IMAGE_DEFECT;
+            return GIF_ERROR;
+        }
+
+        /* Unwind the string backwards, in place if it ends in this row. */
+        InPlace = Len <= Width - X;
+        Out = InPlace ? Line + X : Stack;
+        End = Out + Len;
+        if (String != Code)
+            *--End = First;
+        while (End > Out) {
+            *--End = Suffix[String];
+            String = Prefix[String];
+        }
+        while (Len > 0 && Rows < Height) {
+            Count = Len < Width - X ? Len : Width - X;
+            if (!InPlace)
+                memcpy(Line + X, Out, Count);
+            Out += Count;
+            Len -= Count;
+            X += Count;
+            if (X < Width)
+                break;
+            RowFunc(UserData, Row, Line);
+            Rows++;
+            X = 0;
+            if (!GifFile->Image.Interlace) {
+                Row++;
+            } else {
+                Row += InterlacedJumps[Pass];
+                while (Row >= Height && Pass < 3)
+                    Row = InterlacedOffset[++Pass];
+            }
+        }
+
+        if (LastCode != NO_SUCH_CODE && NextCode <= LZ_MAX_CODE) {
+            Prefix[NextCode] = LastCode;
+            Suffix[NextCode] = First;
+            FirstChar[NextCode] = FirstChar[LastCode];
+            StringLength[NextCode] =
+                    (unsigned short) (StringLength[LastCode] + 1);
+            NextCode++;
+        }
+        LastCode = Code;
+    }
+
+    /* Flush out the rest of the image until the empty block, as
+     * DGifGetLine does. */
+    while (!EndOfData) {
+        /* coverity[check_return] */
+        if (InternalRead(GifFile, &Byte, 1) != 1) {
+            GifFile->Error = D_GIF_ERR_READ_FAILED;
+            return GIF_ERROR;
+        }
+        if (Byte == 0)
+            EndOfData = 1;
+        else if (InternalSkip(GifFile, Byte) != Byte) {
+            GifFile->Error = D_GIF_ERR_READ_FAILED;
+            return GIF_ERROR;
+        }
+    }
+    Private->Buf[0] = 0;
+    Private->PixelCount = 0;
+
+    return GIF_OK;
+}
+
 /******************************************************************************
  This routine reads an entire GIF into core, hanging all its state info off
  the GifFileType pointer.  Call DGifOpenFileName() or DGifOpenFileHandle()
@@ -1137,35 +2051,15 @@ DGifSlurp(GifFileType *GifFile) {
                 if (ImageSize > (SIZE_MAX / sizeof(GifPixelType))) {
                     return GIF_ERROR;
                 }
-                sp->RasterBits = (unsigned char *) reallocarray(NULL, ImageSize,
-                                                                sizeof(GifPixelType));
+                sp->RasterBits = DGifAllocRaster(GifFile,
+                                                 ImageSize * sizeof(GifPixelType));
 
                 if (sp->RasterBits == NULL) {
                     return GIF_ERROR;
                 }
 
-                if (sp->ImageDesc.Interlace) {
-                    int i, j;
-                    /*
-                     * The way an interlaced image should be read -
-                     * offsets and jumps...
-                     */
-                    int InterlacedOffset[] = {0, 4, 2, 1};
-                    int InterlacedJumps[] = {8, 8, 4, 2};
-                    /* Need to perform 4 passes on the image */
-                    for (i = 0; i < 4; i++)
-                        for (j = InterlacedOffset[i];
-                             j < sp->ImageDesc.Height;
-                             j += InterlacedJumps[i]) {
-                            if (DGifGetLine(GifFile,
-                                            sp->RasterBits + j * sp->ImageDesc.Width,
-                                            sp->ImageDesc.Width) == GIF_ERROR)
-                                return GIF_ERROR;
-                        }
-                } else {
-                    if (DGifGetLine(GifFile, sp->RasterBits, ImageSize) == GIF_ERROR)
-                        return (GIF_ERROR);
-                }
+                if (DGifGetImage(GifFile, sp->RasterBits) == GIF_ERROR)
+                    return (GIF_ERROR);
 
                 if (GifFile->ExtensionBlocks) {
                     sp->ExtensionBlocks = GifFile->ExtensionBlocks;
@@ -1181,9 +2075,9 @@ DGifSlurp(GifFileType *GifFile) {
                     return (GIF_ERROR);
                 /* Create an extension block with our data */
                 if (ExtData != NULL) {
-                    if (GifAddExtensionBlock(&GifFile->ExtensionBlockCount,
-                                             &GifFile->ExtensionBlocks,
-                                             ExtFunction, ExtData[0], &ExtData[1])
+                    if (DGifAddExtensionBlock(GifFile, &GifFile->ExtensionBlockCount,
+                                              &GifFile->ExtensionBlocks,
+                                              ExtFunction, ExtData[0], &ExtData[1])
                         == GIF_ERROR)
                         return (GIF_ERROR);
                 }
@@ -1194,10 +2088,10 @@ DGifSlurp(GifFileType *GifFile) {
                         break;
                     /* Continue the extension block */
                     if (ExtData != NULL)
-                        if (GifAddExtensionBlock(&GifFile->ExtensionBlockCount,
-                                                 &GifFile->ExtensionBlocks,
-                                                 CONTINUE_EXT_FUNC_CODE,
-                                                 ExtData[0], &ExtData[1]) == GIF_ERROR)
+                        if (DGifAddExtensionBlock(GifFile, &GifFile->ExtensionBlockCount,
+                                                  &GifFile->ExtensionBlocks,
+                                                  CONTINUE_EXT_FUNC_CODE,
+                                                  ExtData[0], &ExtData[1]) == GIF_ERROR)
                             return (GIF_ERROR);
                 }
                 break;
@@ -1210,6 +2104,9 @@ DGifSlurp(GifFileType *GifFile) {
         }
     } while (RecordType != TERMINATE_RECORD_TYPE);
 
+    /* All images are decoded. */
+    DGifFreeScratch(GifFile);
+
     /* Sanity check for corrupted file */
     if (GifFile->ImageCount == 0) {
         GifFile->Error = D_GIF_ERR_NO_IMAG_DSCR;
@@ -1219,4 +2116,138 @@ DGifSlurp(GifFileType *GifFile) {
     return (GIF_OK);
 }
 
+/******************************************************************************
+ This routine walks the block structure of an entire GIF without decoding
+ any image.  SavedImages and extension blocks are filled in as DGifSlurp()
+ does, but RasterBits are left NULL: the LZW sub-blocks are skipped using
+ their length bytes, so the cost is proportional to the number of blocks,
+ not the number of pixels.  If FrameIndex is not NULL, it receives a
+ malloc(3)'ed array of ImageCount entries holding the input offsets and the
+ parsed graphics control block of every image; release it with free().
+*******************************************************************************/
+int
+DGifScan(GifFileType *GifFile, GifFrameIndex **FrameIndex) {
+    GifFilePrivateType *Private = (GifFilePrivateType *) GifFile->Private;
+    GifRecordType RecordType;
+    SavedImage *sp;
+    GifFrameIndex *Index = NULL, *ip;
+    GifByteType *ExtData, BlockSize;
+    int ExtFunction, IndexCapacity = 0;
+    long ImageOffset;
+
+    if (FrameIndex != NULL)
+        *FrameIndex = NULL;
+
+    GifFile->ExtensionBlocks = NULL;
+    GifFile->ExtensionBlockCount = 0;
+
+    do {
+        if (DGifGetRecordType(GifFile, &RecordType) == GIF_ERROR)
+            goto fail;
+
+        switch (RecordType) {
+            case IMAGE_DESC_RECORD_TYPE:
+                ImageOffset = Private->Position;
+                if (DGifGetImageDesc(GifFile) == GIF_ERROR)
+                    goto fail;
+
+                sp = &GifFile->SavedImages[GifFile->ImageCount - 1];
+                if (sp->ImageDesc.Width <= 0 || sp->ImageDesc.Height <= 0 ||
+                    sp->ImageDesc.Width > (INT_MAX / sp->ImageDesc.Height)) {
+                    goto fail;
+                }
+
+                if (GifFile->ImageCount > IndexCapacity) {
+                    IndexCapacity = IndexCapacity ? IndexCapacity * 2 : 16;
+                    ip = (GifFrameIndex *) reallocarray(Index, IndexCapacity,
+                                                        sizeof(GifFrameIndex));
+                    if (ip == NULL) {
+                        GifFile->Error = D_GIF_ERR_NOT_ENOUGH_MEM;
+                        goto fail;
+                    }
+                    Index = ip;
+                }
+                ip = &Index[GifFile->ImageCount - 1];
+                ip->ImageOffset = ImageOffset;
+                /* descriptor is 9 bytes, the color map follows it */
+                ip->ColorMapOffset = sp->ImageDesc.ColorMap ? ImageOffset + 9 : -1;
+                /* DGifGetImageDesc() has consumed the LZW code size byte */
+                ip->CodeOffset = Private->Position - 1;
+                ip->ImageDesc = sp->ImageDesc;
+                ip->ImageDesc.ColorMap = NULL;
+
+                /* Skip the sub-blocks by their length bytes, no decoding */
+                do {
+                    if (InternalRead(GifFile, &BlockSize, 1) != 1) {
+                        GifFile->Error = D_GIF_ERR_READ_FAILED;
+                        goto fail;
+                    }
+                    if (BlockSize > 0 && InternalSkip(GifFile, BlockSize) != BlockSize) {
+                        GifFile->Error = D_GIF_ERR_READ_FAILED;
+                        goto fail;
+                    }
+                } while (BlockSize > 0);
+                Private->Buf[0] = 0;
+                Private->PixelCount = 0;
+                ip->CodeLength = Private->Position - ip->CodeOffset;
+
+                if (GifFile->ExtensionBlocks) {
+                    sp->ExtensionBlocks = GifFile->ExtensionBlocks;
+                    sp->ExtensionBlockCount = GifFile->ExtensionBlockCount;
+
+                    GifFile->ExtensionBlocks = NULL;
+                    GifFile->ExtensionBlockCount = 0;
+                }
+                /* leaves the defaults in place if there is no GCB */
+                (void) DGifSavedExtensionToGCB(GifFile, GifFile->ImageCount - 1, &ip->GCB);
+                break;
+
+            case EXTENSION_RECORD_TYPE:
+                if (DGifGetExtension(GifFile, &ExtFunction, &ExtData) == GIF_ERROR)
+                    goto fail;
+                if (ExtData != NULL) {
+                    if (DGifAddExtensionBlock(GifFile, &GifFile->ExtensionBlockCount,
+                                              &GifFile->ExtensionBlocks,
+                                              ExtFunction, ExtData[0], &ExtData[1])
+                        == GIF_ERROR)
+                        goto fail;
+                }
+                for (;;) {
+                    if (DGifGetExtensionNext(GifFile, &ExtData) == GIF_ERROR)
+                        goto fail;
+                    if (ExtData == NULL)
+                        break;
+                    if (DGifAddExtensionBlock(GifFile, &GifFile->ExtensionBlockCount,
+                                              &GifFile->ExtensionBlocks,
+                                              CONTINUE_EXT_FUNC_CODE,
+                                             ExtData[0], &ExtData[1]) == GIF_ERROR)
+                        goto fail;
+                }
+                break;
+
+            case TERMINATE_RECORD_TYPE:
+                break;
+
+            default:    /* Should be trapped by DGifGetRecordType */
+                break;
+        }
+    } while (RecordType != TERMINATE_RECORD_TYPE);
+
+    /* Sanity check for corrupted file */
+    if (GifFile->ImageCount == 0) {
+        GifFile->Error = D_GIF_ERR_NO_IMAG_DSCR;
+        goto fail;
+    }
+
+    if (FrameIndex != NULL)
+        *FrameIndex = Index;
+    else
+        free(Index);
+    return (GIF_OK);
+
+fail:
+    free(Index);
+    return (GIF_ERROR);
+}
+
 /* end */
@@ -404,6 +404,8 @@ EGifPutImageDesc(GifFileType *GifFile,
                 return GIF_ERROR;
             }
         } else {
+            /* Drop the local map of the previous image. */
+            GifFreeMapObject(GifFile->Image.ColorMap);
             GifFile->Image.ColorMap = NULL;
         }
     }
@@ -120,6 +120,19 @@ typedef struct GraphicsControlBlock {
 #define NO_TRANSPARENT_COLOR    -1
 } GraphicsControlBlock;
 
+/******************************************************************************
+ Frame index built by DGifScan(), one entry per image
+******************************************************************************/
+
+typedef struct GifFrameIndex {
+    long ImageOffset;          /* Offset of the image descriptor, past ',' */
+    long ColorMapOffset;       /* Offset of the local color map, -1 if none */
+    long CodeOffset;           /* Offset of the LZW minimum code size byte */
+    long CodeLength;           /* Code size byte, sub-blocks and terminator */
+    GifImageDesc ImageDesc;    /* ColorMap is not set, see ColorMapOffset */
+    GraphicsControlBlock GCB;  /* Defaults if the image has no GCB */
+} GifFrameIndex;
+
 /******************************************************************************
  GIF encoding routines
 ******************************************************************************/
@@ -199,7 +212,54 @@ GifFileType *DGifOpenFileHandle(int GifFileHandle, int *Error);
 
 int DGifSlurp(GifFileType *GifFile);
 
+int DGifScan(GifFileType *GifFile, GifFrameIndex **FrameIndex);
+
+#define GIF_LZW_CLASSIC  0    /* DGifDecompressLine, one code at a time. */
+#define GIF_LZW_TABLE    1    /* Table driven, one copy per code. */
+
+void DGifSetLZWEngine(GifFileType *GifFile, int Engine);
+
+int DGifGetImage(GifFileType *GifFile, GifPixelType *Raster);
+
+typedef void (*GifRowFunc)(void *UserData, int Row, const GifPixelType *Line);
+
+int DGifGetImageRows(GifFileType *GifFile, GifPixelType *Line,
+                     GifRowFunc RowFunc, void *UserData);
+
 GifFileType *DGifOpen(void *userPtr, InputFunc readFunc, int *Error);    /* new one (TVT) */
+GifFileType *DGifOpenMemory(const void *Data, size_t Size, int *Error);
+
+/* Recycling of decoder allocations between files, see DGifSetRecycler() */
+typedef struct GifRecycler {
+    void *(*TakeState)(size_t Size);    /* A kept state block, or NULL */
+    int (*GiveState)(void *State, size_t Size);    /* 0: giflib frees it */
+    void *(*TakeRaster)(size_t Size);   /* Rasters and arena chunks, NULL */
+                                        /* only when out of memory     */
+    int (*GiveRaster)(void *Raster, size_t Size);  /* 0: giflib frees it */
+} GifRecycler;
+
+void DGifSetRecycler(const GifRecycler *Recycler);
+void DGifFreeState(void *State);
+
+/* Saved image data of a file allocated from a per file arena */
+int DGifSetArena(GifFileType *GifFile, bool Enable);
+GifPixelType *DGifAllocRaster(GifFileType *GifFile, size_t Size);
+int DGifAddExtensionBlock(GifFileType *GifFile,
+                          int *ExtensionBlock_Count,
+                          ExtensionBlock **ExtensionBlocks,
+                          int Function,
+                          unsigned int Len, unsigned char ExtData[]);
+int DGifSeek(GifFileType *GifFile, long Offset);
+const GifByteType *DGifGetMemory(const GifFileType *GifFile, size_t *Size);
+int DGifDecompressCode(GifFileType *GifFile, const GifImageDesc *Desc,
+                       const GifByteType *Code, size_t CodeLength,
+                       GifPixelType *Raster);
+int DGifDecompressCodeRows(GifFileType *GifFile, const GifImageDesc *Desc,
+                           const GifByteType *Code, size_t CodeLength,
+                           GifPixelType *Line, GifRowFunc RowFunc,
+                           void *UserData);
+size_t DGifGetScratchSize(const GifFileType *GifFile);
+void DGifFreeScratch(GifFileType *GifFile);
 int DGifCloseFile(GifFileType *GifFile, int *ErrorCode);
 
 #define D_GIF_SUCCEEDED          0
@@ -35,6 +35,13 @@ SPDX-License-Identifier: MIT
 #define IS_READABLE(Private)    (Private->FileState & FILE_STATE_READ)
 #define IS_WRITEABLE(Private)   (Private->FileState & FILE_STATE_WRITE)
 
+/* A block of a DGifSetArena() arena; allocations follow the header. */
+typedef struct GifArenaChunk {
+    struct GifArenaChunk *Next;
+    size_t Size;    /* Bytes after the header. */
+    size_t Used;
+} GifArenaChunk;
+
 typedef struct GifFilePrivateType {
     GifWord FileState, FileHandle,  /* Where all this data goes to! */
             BitsPerPixel,     /* Bits per pixel (Codes uses at least this + 1). */
@@ -49,17 +56,39 @@ typedef struct GifFilePrivateType {
             CrntShiftState;    /* Number of bits in CrntShiftDWord. */
     unsigned long CrntShiftDWord;   /* For bytes decomposition into codes. */
     unsigned long PixelCount;   /* Number of pixels in image. */
+    long Position;     /* Bytes consumed from the input so far. */
     FILE *File;    /* File as stream. */
     InputFunc Read;     /* function to read gif input (TVT) */
+    const GifByteType *Memory;  /* Whole input in memory (DGifOpenMemory), */
+    size_t MemorySize;          /* read in place at Position.              */
     OutputFunc Write;   /* function to write gif output (MRB) */
     GifByteType Buf[256];   /* Compressed input is buffered here. */
     GifByteType Stack[LZ_MAX_CODE]; /* Decoded pixels are stacked here. */
     GifByteType Suffix[LZ_MAX_CODE + 1];    /* So we can trace the codes. */
     GifPrefixType Prefix[LZ_MAX_CODE + 1];
+    unsigned int StringOffset[LZ_MAX_CODE + 1];    /* Table engine: where each */
+    unsigned short StringLength[LZ_MAX_CODE + 1];  /* code's string sits.      */
+    GifByteType FirstChar[LZ_MAX_CODE + 1];  /* Row engine: string heads. */
+    GifPixelType *Scratch;      /* Table engine: interlaced images decode   */
+    size_t ScratchSize;         /* here first, kept until DGifFreeScratch(). */
     GifHashTableType *HashTable;
+    int LZWEngine;     /* GIF_LZW_CLASSIC or GIF_LZW_TABLE. */
+    int SavedImagesCapacity;    /* Slots allocated in SavedImages. */
+    bool UseArena;              /* Saved image data comes from Arena. */
+    GifArenaChunk *Arena;       /* Chunk being filled first. */
+    size_t ArenaChunkSize;      /* Size of the next shared chunk. */
     bool gif89;
 } GifFilePrivateType;
 
+/* A decoder's GifFileType and private state in one block, so a GifRecycler
+ * can pass it on to the next DGifOpen*() along with a SavedImages array. */
+typedef struct GifDecoderState {
+    GifFileType File;
+    GifFilePrivateType Private;
+    SavedImage *SpareImages;    /* SavedImages array left by the last file. */
+    int SpareCapacity;
+} GifDecoderState;
+
 #ifndef HAVE_REALLOCARRAY
 
 extern void *openbsd_reallocarray(void *optr, size_t nmemb, size_t size);
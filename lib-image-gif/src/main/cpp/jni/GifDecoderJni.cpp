@@ -0,0 +1,421 @@
+#include <vector>
+#include <android/bitmap.h>
+#include "GifDecoderJni.h"
+#include "JavaInputStream.h"
+#include "../GifDecoder.h"
+#include "../DecoderPool.h"
+#include "../utils/log.h"
+#include "../utils/math.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// JNILoader
+////////////////////////////////////////////////////////////////////////////////
+
+static struct {
+    jfieldID lazyDecode;
+    jfieldID rasterCacheSize;
+    jfieldID justDecodeInfo;
+    jfieldID keyframeInterval;
+    jfieldID keyframeCacheBytes;
+    jfieldID progressive;
+    jfieldID compressedFrames;
+    jfieldID boxFilter;
+    jfieldID memoryBudgetBytes;
+    jfieldID compositeThreads;
+    jfieldID decodeThreads;
+} gOptionsClassInfo;
+
+static struct {
+    jfieldID left;
+    jfieldID top;
+    jfieldID right;
+    jfieldID bottom;
+} gRectClassInfo;
+
+// 将 Bitmap 的格式转换为 drawFrame 的输出格式, 不支持的格式返回 false
+static bool toPixelFormat(int32_t bitmapFormat, PixelFormat &format) {
+    switch (bitmapFormat) {
+        case ANDROID_BITMAP_FORMAT_RGBA_8888:
+            format = PIXEL_FORMAT_8888;
+            return true;
+        case ANDROID_BITMAP_FORMAT_RGB_565:
+            format = PIXEL_FORMAT_565;
+            return true;
+        case ANDROID_BITMAP_FORMAT_A_8:
+            format = PIXEL_FORMAT_A8;
+            return true;
+        default:
+            return false;
+    }
+}
+
+// 读取 Java 层的 GifDecoder.Options, options 为 null 时使用默认值
+static DecodeOptions readDecodeOptions(JNIEnv *env, jobject options) {
+    DecodeOptions decodeOptions;
+    if (options) {
+        decodeOptions.lazyDecode = env->GetBooleanField(options, gOptionsClassInfo.lazyDecode);
+        decodeOptions.rasterCacheSize = env->GetIntField(options,
+                                                         gOptionsClassInfo.rasterCacheSize);
+        decodeOptions.justDecodeInfo = env->GetBooleanField(options,
+                                                            gOptionsClassInfo.justDecodeInfo);
+        decodeOptions.keyframeInterval = env->GetIntField(options,
+                                                          gOptionsClassInfo.keyframeInterval);
+        decodeOptions.keyframeCacheBytes = (long) env->GetLongField(
+                options, gOptionsClassInfo.keyframeCacheBytes);
+        decodeOptions.progressive = env->GetBooleanField(options, gOptionsClassInfo.progressive);
+        decodeOptions.compressedFrames = env->GetBooleanField(options,
+                                                              gOptionsClassInfo.compressedFrames);
+        decodeOptions.boxFilter = env->GetBooleanField(options, gOptionsClassInfo.boxFilter);
+        decodeOptions.memoryBudgetBytes = (long) env->GetLongField(
+                options, gOptionsClassInfo.memoryBudgetBytes);
+        decodeOptions.compositeThreads = env->GetIntField(options,
+                                                          gOptionsClassInfo.compositeThreads);
+        decodeOptions.decodeThreads = env->GetIntField(options, gOptionsClassInfo.decodeThreads);
+    }
+    return decodeOptions;
+}
+
+static jobject createJavaGifDecoder(JNIEnv *env, jclass jclazz, GifDecoder *decoder) {
+    if (!decoder || !decoder->hasInit()) {
+        ALOGE("Gif parsed failed. Please check input source and try again.");
+        delete decoder;
+        return NULL;
+    }
+    // Create Java method.<init>是每个对象创建走的第一个方法。
+    jmethodID jCtr = env->GetMethodID(jclazz, "<init>", "(JIIZIIJ)V");
+    // 在C++层构建Java层的GifDecoder
+    return env->NewObject(
+            jclazz, jCtr,
+            reinterpret_cast<jlong>(decoder),
+            decoder->getWidth(),
+            decoder->getHeight(),
+            decoder->isOpaque(),
+            decoder->getFrameCount(),
+            decoder->getLooperCount(),
+            static_cast<jlong>(decoder->getDuration())
+    );
+}
+
+namespace gifdecoder {
+
+    jobject _nativeDecodeFile(JNIEnv *env, jclass jclazz, jstring file_path, jobject options) {
+        char *filePath = const_cast<char *>(env->GetStringUTFChars(file_path, NULL));
+        GifDecoder *decoder = new GifDecoder(filePath, readDecodeOptions(env, options));
+        env->ReleaseStringUTFChars(file_path, filePath);
+        return createJavaGifDecoder(env, jclazz, decoder);
+    }
+
+    jobject _nativeDecodeStream(JNIEnv *env, jclass jclazz, jobject istream,
+                               jbyteArray byteArray, jobject options) {
+        DecodeOptions decodeOptions = readDecodeOptions(env, options);
+        if (decodeOptions.progressive && !decodeOptions.lazyDecode
+            && !decodeOptions.justDecodeInfo) {
+            // 渐进解码时 stream 在之后的 decodeMoreFrames 中继续读取, 交给 GifDecoder 释放
+            JavaInputStream *stream = new JavaInputStream(env, istream, byteArray, true);
+            return createJavaGifDecoder(env, jclazz, new GifDecoder(stream, decodeOptions));
+        }
+        JavaInputStream stream(env, istream, byteArray);
+        GifDecoder *decoder = new GifDecoder(&stream, decodeOptions);
+        return createJavaGifDecoder(env, jclazz, decoder);
+    }
+
+    jobject _nativeDecodeByteArray(JNIEnv *env, jclass jclazz,
+                                  jbyteArray byteArray,
+                                  jint offset, jint length, jobject options) {
+        jbyte *bytes = reinterpret_cast<jbyte *>(env->GetPrimitiveArrayCritical(byteArray, NULL));
+        if (bytes == NULL) {
+            ALOGE("couldn't read array bytes");
+            return NULL;
+        }
+        MemoryStream stream(bytes + offset, length, NULL);
+        GifDecoder *decoder = new GifDecoder(&stream, readDecodeOptions(env, options));
+        env->ReleasePrimitiveArrayCritical(byteArray, bytes, 0);
+        return createJavaGifDecoder(env, jclazz, decoder);
+    }
+
+    jobject _nativeDecodeByteBuffer(JNIEnv *env, jclass jclazz, jobject buf,
+                                   jint offset, jint limit, jobject options) {
+        jobject globalBuf = env->NewGlobalRef(buf);
+        JavaVM *vm;
+        env->GetJavaVM(&vm);
+        MemoryStream stream(
+                (reinterpret_cast<uint8_t *>(env->GetDirectBufferAddress(globalBuf))) + offset,
+                limit,
+                globalBuf);
+        GifDecoder *decoder = new GifDecoder(&stream, readDecodeOptions(env, options));
+        //创建GifDecoder
+        return createJavaGifDecoder(env, jclazz, decoder);
+    }
+
+    jlong _nativeGetFrame(JNIEnv *env, jobject, jlong handle,
+                         jint frameNr, jobject bitmap, jint prevFrameNr, jint inSampleSize,
+                         jobject outDirtyRect) {
+        GifDecoder *decoder = reinterpret_cast<GifDecoder *>(handle);
+        AndroidBitmapInfo info;
+        void *pixels;
+        AndroidBitmap_getInfo(env, bitmap, &info);
+        PixelFormat format;
+        if (!toPixelFormat(info.format, format)) {
+            ALOGE("unsupported bitmap format %d", info.format);
+            return -1;
+        }
+        AndroidBitmap_lockPixels(env, bitmap, &pixels);
+        // 获取一行的像素数数量  每行字节数/每像素字节数 = 一行的像素的个数
+        // ARGB_8888 每个像素 4 个字节, RGB_565 为 2 个, ALPHA_8 为 1 个
+        int pixelStride = info.stride / getBytesPerPixel(format);
+        DirtyRect dirtyRect;
+        jlong delayMs = decoder->drawFrame(frameNr, pixels, format, pixelStride,
+                                           prevFrameNr, inSampleSize,
+                                           outDirtyRect ? &dirtyRect : NULL);
+        AndroidBitmap_unlockPixels(env, bitmap);
+        if (outDirtyRect) {
+            env->SetIntField(outDirtyRect, gRectClassInfo.left, dirtyRect.left);
+            env->SetIntField(outDirtyRect, gRectClassInfo.top, dirtyRect.top);
+            env->SetIntField(outDirtyRect, gRectClassInfo.right, dirtyRect.right);
+            env->SetIntField(outDirtyRect, gRectClassInfo.bottom, dirtyRect.bottom);
+        }
+        return delayMs;
+    }
+
+    jlong _nativeGetScaledFrame(JNIEnv *env, jobject, jlong handle, jint frameNr,
+                                jobject bitmap, jint prevFrameNr, jint width, jint height,
+                                jobject outDirtyRect) {
+        GifDecoder *decoder = reinterpret_cast<GifDecoder *>(handle);
+        AndroidBitmapInfo info;
+        void *pixels;
+        AndroidBitmap_getInfo(env, bitmap, &info);
+        PixelFormat format;
+        if (!toPixelFormat(info.format, format)) {
+            ALOGE("unsupported bitmap format %d", info.format);
+            return -1;
+        }
+        AndroidBitmap_lockPixels(env, bitmap, &pixels);
+        int pixelStride = info.stride / getBytesPerPixel(format);
+        // 输出尺寸不超过 bitmap
+        width = min(width, (jint) info.width);
+        height = min(height, (jint) info.height);
+        DirtyRect dirtyRect;
+        jlong delayMs = decoder->drawScaledFrame(frameNr, pixels, format, pixelStride,
+                                                 width, height, prevFrameNr,
+                                                 outDirtyRect ? &dirtyRect : NULL);
+        AndroidBitmap_unlockPixels(env, bitmap);
+        if (outDirtyRect) {
+            env->SetIntField(outDirtyRect, gRectClassInfo.left, dirtyRect.left);
+            env->SetIntField(outDirtyRect, gRectClassInfo.top, dirtyRect.top);
+            env->SetIntField(outDirtyRect, gRectClassInfo.right, dirtyRect.right);
+            env->SetIntField(outDirtyRect, gRectClassInfo.bottom, dirtyRect.bottom);
+        }
+        return delayMs;
+    }
+
+    jboolean _nativeStartPrefetch(JNIEnv *, jobject, jlong handle, jint frameCount,
+                                  jint firstFrame, jint inSampleSize, jint width, jint height,
+                                  jint format) {
+        GifDecoder *decoder = reinterpret_cast<GifDecoder *>(handle);
+        // 与 Java 层 toNativeFormat 的取值一致
+        if (format < PIXEL_FORMAT_8888 || format > PIXEL_FORMAT_A8) {
+            ALOGE("unsupported prefetch format %d", format);
+            return JNI_FALSE;
+        }
+        PrefetchOptions options = {frameCount, firstFrame, (PixelFormat) format, inSampleSize,
+                                   width, height};
+        return static_cast<jboolean>(decoder->startPrefetch(options));
+    }
+
+    void _nativeStopPrefetch(JNIEnv *, jobject, jlong handle) {
+        GifDecoder *decoder = reinterpret_cast<GifDecoder *>(handle);
+        decoder->stopPrefetch();
+    }
+
+    jint _nativeTakeNextFrame(JNIEnv *env, jobject, jlong handle, jobject bitmap,
+                              jlongArray outDelayMs) {
+        GifDecoder *decoder = reinterpret_cast<GifDecoder *>(handle);
+        AndroidBitmapInfo info;
+        void *pixels;
+        AndroidBitmap_getInfo(env, bitmap, &info);
+        PixelFormat format;
+        if (!toPixelFormat(info.format, format)) {
+            ALOGE("unsupported bitmap format %d", info.format);
+            return -1;
+        }
+        AndroidBitmap_lockPixels(env, bitmap, &pixels);
+        long delayMs = 0;
+        jint frameNr = decoder->takeNextFrame(pixels, format,
+                                              info.stride / getBytesPerPixel(format),
+                                              info.width, info.height, &delayMs);
+        AndroidBitmap_unlockPixels(env, bitmap);
+        if (frameNr >= 0 && outDelayMs && env->GetArrayLength(outDelayMs) > 0) {
+            jlong value = delayMs;
+            env->SetLongArrayRegion(outDelayMs, 0, 1, &value);
+        }
+        return frameNr;
+    }
+
+    jboolean _nativeIsIndependentFrame(JNIEnv *, jobject, jlong handle, jint frameNr) {
+        GifDecoder *decoder = reinterpret_cast<GifDecoder *>(handle);
+        return static_cast<jboolean>(decoder->isIndependentFrame(frameNr));
+    }
+
+    jint _nativeDecodeMoreFrames(JNIEnv *, jobject, jlong handle, jint maxFrames) {
+        GifDecoder *decoder = reinterpret_cast<GifDecoder *>(handle);
+        return decoder->decodeMoreFrames(maxFrames);
+    }
+
+    jboolean _nativeIsFrameOpaque(JNIEnv *, jobject, jlong handle, jint frameNr) {
+        GifDecoder *decoder = reinterpret_cast<GifDecoder *>(handle);
+        return static_cast<jboolean>(decoder->isFrameOpaque(frameNr));
+    }
+
+    jboolean _nativeIsAnimationOpaque(JNIEnv *, jobject, jlong handle) {
+        GifDecoder *decoder = reinterpret_cast<GifDecoder *>(handle);
+        return static_cast<jboolean>(decoder->isAnimationOpaque());
+    }
+
+    jboolean _nativeIsComplete(JNIEnv *, jobject, jlong handle) {
+        GifDecoder *decoder = reinterpret_cast<GifDecoder *>(handle);
+        return static_cast<jboolean>(decoder->isComplete());
+    }
+
+    jint _nativeGetFrameCount(JNIEnv *, jobject, jlong handle) {
+        GifDecoder *decoder = reinterpret_cast<GifDecoder *>(handle);
+        return decoder->getFrameCount();
+    }
+
+    jlong _nativeGetDuration(JNIEnv *, jobject, jlong handle) {
+        GifDecoder *decoder = reinterpret_cast<GifDecoder *>(handle);
+        return static_cast<jlong>(decoder->getDuration());
+    }
+
+    jintArray _nativeGetFrameDelays(JNIEnv *env, jobject, jlong handle) {
+        GifDecoder *decoder = reinterpret_cast<GifDecoder *>(handle);
+        const int count = decoder->getFrameCount();
+        std::vector<FrameControl> controls(count);
+        std::vector<jint> delays(count);
+        const int copied = count ? decoder->getFrameControls(0, count, controls.data()) : 0;
+        for (int i = 0; i < copied; i++) {
+            delays[i] = controls[i].delayMs;
+        }
+        jintArray array = env->NewIntArray(copied);
+        if (array && copied) {
+            env->SetIntArrayRegion(array, 0, copied, delays.data());
+        }
+        return array;
+    }
+
+    jlongArray _nativeGetMemoryUsage(JNIEnv *env, jobject, jlong handle) {
+        GifDecoder *decoder = reinterpret_cast<GifDecoder *>(handle);
+        MemoryUsage usage = decoder->getMemoryUsage();
+        // 与 Java 层 MemoryUsage 构造参数的顺序一致
+        jlong values[] = {(jlong) usage.rasters, (jlong) usage.sourceCopy,
+                          (jlong) usage.compressedFrames, (jlong) usage.mappedSource, (jlong) usage.preserveBuffer,
+                          (jlong) usage.keyframes, (jlong) usage.paletteLuts,
+                          (jlong) usage.metadata, (jlong) usage.scaledCanvas,
+                          (jlong) usage.prefetch};
+        jlongArray array = env->NewLongArray(10);
+        if (array) {
+            env->SetLongArrayRegion(array, 0, 10, values);
+        }
+        return array;
+    }
+
+    void _nativeSetPoolLimits(JNIEnv *, jclass, jint maxStates, jlong maxBufferBytes) {
+        DecoderPool::get().setLimits(maxStates, maxBufferBytes > 0 ? (size_t) maxBufferBytes : 0);
+    }
+
+    void _nativeTrimPool(JNIEnv *, jclass) {
+        DecoderPool::get().trim();
+    }
+
+    jlongArray _nativeGetPoolStats(JNIEnv *env, jclass) {
+        DecoderPoolStats stats = DecoderPool::get().getStats();
+        // 与 Java 层 PoolStats 构造参数的顺序一致
+        jlong values[] = {stats.stateAllocs, stats.stateReuses, stats.bufferAllocs,
+                          stats.bufferReuses, (jlong) stats.retainedBytes};
+        jlongArray array = env->NewLongArray(5);
+        if (array) {
+            env->SetLongArrayRegion(array, 0, 5, values);
+        }
+        return array;
+    }
+
+    void _nativeDestroy(JNIEnv *, jobject, jlong native_ptr) {
+        GifDecoder *decoder = reinterpret_cast<GifDecoder *>(native_ptr);
+        delete (decoder);
+    }
+
+}
+
+static JNINativeMethod gGifDecoderMethods[] = {
+        // 动态注册的方式注册Java层的native方法
+        {"nativeDecodeFile",       "(Ljava/lang/String;Lcom/hash/study/gif/GifDecoder$Options;)Lcom/hash/study/gif/GifDecoder;",      (void *) gifdecoder::_nativeDecodeFile},
+        {"nativeDecodeStream",     "(Ljava/io/InputStream;[BLcom/hash/study/gif/GifDecoder$Options;)Lcom/hash/study/gif/GifDecoder;", (void *) gifdecoder::_nativeDecodeStream},
+        {"nativeDecodeByteArray",  "([BIILcom/hash/study/gif/GifDecoder$Options;)Lcom/hash/study/gif/GifDecoder;",                    (void *) gifdecoder::_nativeDecodeByteArray},
+        {"nativeDecodeByteBuffer", "(Ljava/nio/ByteBuffer;IILcom/hash/study/gif/GifDecoder$Options;)Lcom/hash/study/gif/GifDecoder;", (void *) gifdecoder::_nativeDecodeByteBuffer},
+        // other method.
+        {"nativeGetFrame",         "(JILandroid/graphics/Bitmap;IILandroid/graphics/Rect;)J",  (void *) gifdecoder::_nativeGetFrame},
+        {"nativeGetScaledFrame",   "(JILandroid/graphics/Bitmap;IIILandroid/graphics/Rect;)J", (void *) gifdecoder::_nativeGetScaledFrame},
+        {"nativeStartPrefetch",    "(JIIIIII)Z",                                               (void *) gifdecoder::_nativeStartPrefetch},
+        {"nativeStopPrefetch",     "(J)V",                                                     (void *) gifdecoder::_nativeStopPrefetch},
+        {"nativeTakeNextFrame",    "(JLandroid/graphics/Bitmap;[J)I",                          (void *) gifdecoder::_nativeTakeNextFrame},
+        {"nativeIsIndependentFrame", "(JI)Z",                                                  (void *) gifdecoder::_nativeIsIndependentFrame},
+        {"nativeDecodeMoreFrames", "(JI)I",                                                    (void *) gifdecoder::_nativeDecodeMoreFrames},
+        {"nativeIsComplete",       "(J)Z",                                                     (void *) gifdecoder::_nativeIsComplete},
+        {"nativeIsFrameOpaque",    "(JI)Z",                                                    (void *) gifdecoder::_nativeIsFrameOpaque},
+        {"nativeIsAnimationOpaque", "(J)Z",                                                    (void *) gifdecoder::_nativeIsAnimationOpaque},
+        {"nativeGetFrameCount",    "(J)I",                                                     (void *) gifdecoder::_nativeGetFrameCount},
+        {"nativeGetDuration",      "(J)J",                                                     (void *) gifdecoder::_nativeGetDuration},
+        {"nativeGetFrameDelays",   "(J)[I",                                                    (void *) gifdecoder::_nativeGetFrameDelays},
+        {"nativeGetMemoryUsage",   "(J)[J",                                                    (void *) gifdecoder::_nativeGetMemoryUsage},
+        {"nativeSetPoolLimits",    "(IJ)V",                                                    (void *) gifdecoder::_nativeSetPoolLimits},
+        {"nativeTrimPool",         "()V",                                                      (void *) gifdecoder::_nativeTrimPool},
+        {"nativeGetPoolStats",     "()[J",                                                     (void *) gifdecoder::_nativeGetPoolStats},
+        {"nativeDestroy",          "(J)V",                                                     (void *) gifdecoder::_nativeDestroy},
+};
+
+// 通过
+jint GifDecoder_OnLoad(JNIEnv *env) {
+    jclass jclsOptions = env->FindClass("com/hash/study/gif/GifDecoder$Options");
+    if (!jclsOptions) {
+        return -1;
+    }
+    gOptionsClassInfo.lazyDecode = env->GetFieldID(jclsOptions, "lazyDecode", "Z");
+    gOptionsClassInfo.rasterCacheSize = env->GetFieldID(jclsOptions, "rasterCacheSize", "I");
+    gOptionsClassInfo.justDecodeInfo = env->GetFieldID(jclsOptions, "justDecodeInfo", "Z");
+    gOptionsClassInfo.keyframeInterval = env->GetFieldID(jclsOptions, "keyframeInterval", "I");
+    gOptionsClassInfo.keyframeCacheBytes = env->GetFieldID(jclsOptions, "keyframeCacheBytes", "J");
+    gOptionsClassInfo.progressive = env->GetFieldID(jclsOptions, "progressive", "Z");
+    gOptionsClassInfo.compressedFrames = env->GetFieldID(jclsOptions, "compressedFrames", "Z");
+    gOptionsClassInfo.boxFilter = env->GetFieldID(jclsOptions, "boxFilter", "Z");
+    gOptionsClassInfo.memoryBudgetBytes = env->GetFieldID(jclsOptions, "memoryBudgetBytes", "J");
+    gOptionsClassInfo.compositeThreads = env->GetFieldID(jclsOptions, "compositeThreads", "I");
+    gOptionsClassInfo.decodeThreads = env->GetFieldID(jclsOptions, "decodeThreads", "I");
+    if (!gOptionsClassInfo.lazyDecode || !gOptionsClassInfo.rasterCacheSize
+        || !gOptionsClassInfo.justDecodeInfo || !gOptionsClassInfo.keyframeInterval
+        || !gOptionsClassInfo.keyframeCacheBytes || !gOptionsClassInfo.progressive
+        || !gOptionsClassInfo.compressedFrames || !gOptionsClassInfo.boxFilter
+        || !gOptionsClassInfo.memoryBudgetBytes || !gOptionsClassInfo.compositeThreads
+        || !gOptionsClassInfo.decodeThreads) {
+        return -1;
+    }
+
+    jclass jclsRect = env->FindClass("android/graphics/Rect");
+    if (!jclsRect) {
+        return -1;
+    }
+    gRectClassInfo.left = env->GetFieldID(jclsRect, "left", "I");
+    gRectClassInfo.top = env->GetFieldID(jclsRect, "top", "I");
+    gRectClassInfo.right = env->GetFieldID(jclsRect, "right", "I");
+    gRectClassInfo.bottom = env->GetFieldID(jclsRect, "bottom", "I");
+    if (!gRectClassInfo.left || !gRectClassInfo.top || !gRectClassInfo.right
+        || !gRectClassInfo.bottom) {
+        return -1;
+    }
+
+    jclass jclsGifDecoder = env->FindClass("com/hash/study/gif/GifDecoder");
+    jclsGifDecoder = reinterpret_cast<jclass>(env->NewGlobalRef(jclsGifDecoder));
+    return env->RegisterNatives(
+            jclsGifDecoder,
+            gGifDecoderMethods,
+            sizeof(gGifDecoderMethods) / sizeof(gGifDecoderMethods[0])
+    );
+}
\ No newline at end of file
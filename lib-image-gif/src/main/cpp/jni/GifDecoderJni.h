@@ -0,0 +1,6 @@
+#pragma once
+
+#include <jni.h>
+
+// 注册 Java 层 GifDecoder 的 native 方法
+jint GifDecoder_OnLoad(JNIEnv *env);
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "Stream"
+
+#include "JavaInputStream.h"
+
+#include "../utils/math.h"
+
+static struct {
+    jmethodID read;
+    jmethodID reset;
+} gInputStreamClassInfo;
+
+JavaInputStream::JavaInputStream(JNIEnv *env, jobject inputStream, jbyteArray byteArray,
+                                 bool globalRefs) :
+        mVm(NULL),
+        mEnv(env),
+        mGlobalRefs(globalRefs),
+        mInputStream(inputStream),
+        mByteArray(byteArray),
+        mByteArrayLength(env->GetArrayLength(byteArray)) {
+    if (mGlobalRefs) {
+        env->GetJavaVM(&mVm);
+        mInputStream = env->NewGlobalRef(inputStream);
+        mByteArray = (jbyteArray) env->NewGlobalRef(byteArray);
+    }
+}
+
+JavaInputStream::~JavaInputStream() {
+    if (mGlobalRefs) {
+        JNIEnv *env = getEnv();
+        if (env) {
+            env->DeleteGlobalRef(mInputStream);
+            env->DeleteGlobalRef(mByteArray);
+        }
+    }
+}
+
+JNIEnv *JavaInputStream::getEnv() {
+    if (!mVm) {
+        return mEnv;
+    }
+    JNIEnv *env = NULL;
+    if (mVm->GetEnv((void **) &env, JNI_VERSION_1_6) != JNI_OK) {
+        return NULL;
+    }
+    return env;
+}
+
+size_t JavaInputStream::doRead(void *dstBuffer, size_t size) {
+    JNIEnv *env = getEnv();
+    if (!env) {
+        // the calling thread is not attached to the VM
+        return 0;
+    }
+    size_t totalBytesRead = 0;
+
+    do {
+        size_t requested = min(size, mByteArrayLength);
+
+        jint bytesRead = env->CallIntMethod(mInputStream,
+                                            gInputStreamClassInfo.read, mByteArray, 0, requested);
+        if (env->ExceptionCheck()) {
+            return 0;
+        }
+        if (bytesRead < 0) {
+            // end of stream, keep what has been read in this call
+            return totalBytesRead;
+        }
+
+        env->GetByteArrayRegion(mByteArray, 0, bytesRead, (jbyte *) dstBuffer);
+        dstBuffer = (char *) dstBuffer + bytesRead;
+        totalBytesRead += bytesRead;
+        size -= bytesRead;
+    } while (size > 0);
+
+    return totalBytesRead;
+}
+
+jint JavaStream_OnLoad(JNIEnv *env) {
+    // Skip the verbose logging on error for these, as they won't be subject
+    // to obfuscators or similar and are thus unlikely to ever fail
+    jclass inputStreamClazz = env->FindClass("java/io/InputStream");
+    if (!inputStreamClazz) {
+        return -1;
+    }
+    gInputStreamClassInfo.read = env->GetMethodID(inputStreamClazz, "read", "([BII)I");
+    gInputStreamClassInfo.reset = env->GetMethodID(inputStreamClazz, "reset", "()V");
+    if (!gInputStreamClassInfo.read || !gInputStreamClassInfo.reset) {
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RASTERMILL_JAVA_INPUT_STREAM_H
+#define RASTERMILL_JAVA_INPUT_STREAM_H
+
+#include <jni.h>
+#include "../stream/Stream.h"
+
+class JavaInputStream : public Stream {
+public:
+    /**
+     * With globalRefs, the stream and the byte array are held as global
+     * references and the JNIEnv is looked up on every read, so the stream
+     * may outlive the JNI call that created it and be read from any
+     * attached thread.
+     */
+    JavaInputStream(JNIEnv* env, jobject inputStream, jbyteArray byteArray,
+                    bool globalRefs = false);
+
+    virtual ~JavaInputStream();
+
+protected:
+    virtual size_t doRead(void* buffer, size_t size);
+
+private:
+    JNIEnv* getEnv();
+
+    JavaVM* mVm;
+    JNIEnv* mEnv;
+    const bool mGlobalRefs;
+    jobject mInputStream;
+    jbyteArray mByteArray;
+    const size_t mByteArrayLength;
+};
+
+jint JavaStream_OnLoad(JNIEnv* env);
+
+#endif //RASTERMILL_JAVA_INPUT_STREAM_H
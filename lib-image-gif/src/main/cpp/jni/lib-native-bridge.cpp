@@ -1,7 +1,7 @@
 #include <jni.h>
-#include "utils/log.h"
-#include "GifDecoder.h"
-#include "stream/Stream.h"
+#include "../utils/log.h"
+#include "GifDecoderJni.h"
+#include "JavaInputStream.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 // JNILoader
@@ -17,7 +17,6 @@
 #ifndef RASTERMILL_REGISTRY_H
 #define RASTERMILL_REGISTRY_H
 
-#include "jni.h"
 #include <stdint.h>
 
 class FrameSequence;
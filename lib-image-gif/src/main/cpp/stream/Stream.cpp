@@ -18,15 +18,15 @@
 
 #include "Stream.h"
 
+#include <fcntl.h>
+#include <limits.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "../utils/math.h"
 
-static struct {
-    jmethodID read;
-    jmethodID reset;
-} gInputStreamClassInfo;
-
 Stream::Stream()
         : mPeekBuffer(0), mPeekSize(0), mPeekOffset(0) {
 }
@@ -79,7 +79,7 @@ uint8_t *Stream::getRawBufferAddr() {
     return NULL;
 }
 
-jobject Stream::getRawBuffer() {
+void *Stream::getRawBuffer() {
     return NULL;
 }
 
@@ -91,7 +91,7 @@ uint8_t *MemoryStream::getRawBufferAddr() {
     return mBuffer;
 }
 
-jobject MemoryStream::getRawBuffer() {
+void *MemoryStream::getRawBuffer() {
     return mRawBuffer;
 }
 
@@ -115,38 +115,42 @@ size_t FileStream::doRead(void *buffer, size_t size) {
     return fread(buffer, 1, size, mFd);
 }
 
-size_t JavaInputStream::doRead(void *dstBuffer, size_t size) {
-    size_t totalBytesRead = 0;
-
-    do {
-        size_t requested = min(size, mByteArrayLength);
-
-        jint bytesRead = mEnv->CallIntMethod(mInputStream,
-                                             gInputStreamClassInfo.read, mByteArray, 0, requested);
-        if (mEnv->ExceptionCheck() || bytesRead < 0) {
-            return 0;
+MmapStream::MmapStream(const char *path)
+        : mBuffer(NULL), mSize(0), mPosition(0) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)
+        && st.st_size > 0 && st.st_size <= INT_MAX) {
+        void *addr = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            mBuffer = (uint8_t *) addr;
+            mSize = (size_t) st.st_size;
         }
+    }
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+}
+
+MmapStream::~MmapStream() {
+    if (mBuffer) {
+        munmap(mBuffer, mSize);
+    }
+}
 
-        mEnv->GetByteArrayRegion(mByteArray, 0, bytesRead, (jbyte *) dstBuffer);
-        dstBuffer = (char *) dstBuffer + bytesRead;
-        totalBytesRead += bytesRead;
-        size -= bytesRead;
-    } while (size > 0);
+uint8_t *MmapStream::getRawBufferAddr() {
+    return mBuffer ? mBuffer + mPosition : NULL;
+}
 
-    return totalBytesRead;
+int MmapStream::getRawBufferSize() {
+    return (int) (mSize - mPosition);
 }
 
-jint JavaStream_OnLoad(JNIEnv *env) {
-    // Skip the verbose logging on error for these, as they won't be subject
-    // to obfuscators or similar and are thus unlikely to ever fail
-    jclass inputStreamClazz = env->FindClass("java/io/InputStream");
-    if (!inputStreamClazz) {
-        return -1;
-    }
-    gInputStreamClassInfo.read = env->GetMethodID(inputStreamClazz, "read", "([BII)I");
-    gInputStreamClassInfo.reset = env->GetMethodID(inputStreamClazz, "reset", "()V");
-    if (!gInputStreamClassInfo.read || !gInputStreamClassInfo.reset) {
-        return -1;
-    }
-    return 0;
+size_t MmapStream::doRead(void *buffer, size_t size) {
+    size = min(size, mSize - mPosition);
+    memcpy(buffer, mBuffer + mPosition, size);
+    mPosition += size;
+    return size;
 }
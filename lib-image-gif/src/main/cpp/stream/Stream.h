@@ -17,7 +17,7 @@
 #ifndef RASTERMILL_STREAM_H
 #define RASTERMILL_STREAM_H
 
-#include <jni.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <sys/types.h>
 
@@ -29,7 +29,7 @@ public:
     size_t peek(void* buffer, size_t size);
     size_t read(void* buffer, size_t size);
     virtual uint8_t* getRawBufferAddr();
-    virtual jobject getRawBuffer();
+    virtual void* getRawBuffer();
     virtual int getRawBufferSize();
 
 protected:
@@ -41,14 +41,18 @@ private:
     size_t mPeekOffset;
 };
 
+/**
+ * buf is an opaque handle of the memory owned by the caller (e.g. a global
+ * reference to a Java ByteBuffer), NULL if the memory is only borrowed.
+ */
 class MemoryStream : public Stream {
 public:
-    MemoryStream(void* buffer, size_t size, jobject buf) :
+    MemoryStream(void* buffer, size_t size, void* buf) :
             mBuffer((uint8_t*)buffer),
             mRemaining(size),
             mRawBuffer(buf) {}
     virtual uint8_t* getRawBufferAddr();
-    virtual jobject getRawBuffer();
+    virtual void* getRawBuffer();
     virtual int getRawBufferSize();
 
 protected:
@@ -57,7 +61,7 @@ protected:
 private:
     uint8_t* mBuffer;
     size_t mRemaining;
-    jobject mRawBuffer;
+    void* mRawBuffer;
 };
 
 class FileStream : public Stream {
@@ -71,24 +75,26 @@ private:
     FILE* mFd;
 };
 
-class JavaInputStream : public Stream {
+/**
+ * Maps a whole file read-only, so it is read in place from the page cache
+ * instead of being copied through stdio buffers. getRawBufferAddr() returns
+ * NULL if the file could not be mapped (missing, empty, not a regular file
+ * or too large).
+ */
+class MmapStream : public Stream {
 public:
-    JavaInputStream(JNIEnv* env, jobject inputStream, jbyteArray byteArray) :
-            mEnv(env),
-            mInputStream(inputStream),
-            mByteArray(byteArray),
-            mByteArrayLength(env->GetArrayLength(byteArray)) {}
+    MmapStream(const char* path);
+    virtual ~MmapStream();
+    virtual uint8_t* getRawBufferAddr();
+    virtual int getRawBufferSize();
 
 protected:
     virtual size_t doRead(void* buffer, size_t size);
 
 private:
-    JNIEnv* mEnv;
-    const jobject mInputStream;
-    const jbyteArray mByteArray;
-    const size_t mByteArrayLength;
+    uint8_t* mBuffer;
+    size_t mSize;
+    size_t mPosition;
 };
 
-jint JavaStream_OnLoad(JNIEnv* env);
-
 #endif //RASTERMILL_STREAM_H
@@ -0,0 +1,50 @@
+#include "log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#endif
+
+static void defaultLogSink(int priority, const char *tag, const char *fmt, va_list args) {
+#ifdef __ANDROID__
+    __android_log_vprint(priority, tag, fmt, args);
+#else
+    static const char kPriorityChars[] = "??VDIWEF";
+    char priorityChar = priority >= 0 && priority < (int) sizeof(kPriorityChars) - 1
+                        ? kPriorityChars[priority] : '?';
+    fprintf(stderr, "%c/%s: ", priorityChar, tag ? tag : "");
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+#endif
+}
+
+static gif_log_sink_t gLogSink = defaultLogSink;
+
+void gif_set_log_sink(gif_log_sink_t sink) {
+    gLogSink = sink ? sink : defaultLogSink;
+}
+
+void gif_log_vprint(int priority, const char *tag, const char *fmt, va_list args) {
+    gLogSink(priority, tag, fmt, args);
+}
+
+void gif_log_print(int priority, const char *tag, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    gLogSink(priority, tag, fmt, args);
+    va_end(args);
+}
+
+void gif_log_assert(const char *cond, const char *tag, const char *fmt, ...) {
+    if (fmt) {
+        va_list args;
+        va_start(args, fmt);
+        gLogSink(GIF_LOG_FATAL, tag, fmt, args);
+        va_end(args);
+    } else {
+        gif_log_print(GIF_LOG_FATAL, tag, "Assertion failed: %s", cond ? cond : "");
+    }
+    abort();
+}
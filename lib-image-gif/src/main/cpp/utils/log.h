@@ -17,7 +17,7 @@
 #ifndef LOG_H_
 #define LOG_H_
 
-#include <android/log.h>
+#include <stdarg.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -25,6 +25,40 @@ extern "C" {
 
 // ---------------------------------------------------------------------
 
+/*
+ * Log priorities, same values as android_LogPriority.
+ */
+typedef enum {
+    GIF_LOG_VERBOSE = 2,
+    GIF_LOG_DEBUG,
+    GIF_LOG_INFO,
+    GIF_LOG_WARN,
+    GIF_LOG_ERROR,
+    GIF_LOG_FATAL,
+} gif_LogPriority;
+
+/*
+ * Every message goes through the installed sink. The default sink writes
+ * to logcat on Android and to stderr elsewhere. Passing NULL restores the
+ * default. Not thread safe, install the sink before decoding.
+ */
+typedef void (*gif_log_sink_t)(int priority, const char *tag, const char *fmt, va_list args);
+
+void gif_set_log_sink(gif_log_sink_t sink);
+
+void gif_log_print(int priority, const char *tag, const char *fmt, ...)
+        __attribute__((format(printf, 3, 4)));
+
+void gif_log_vprint(int priority, const char *tag, const char *fmt, va_list args);
+
+/*
+ * Logs a fatal message through the sink, then aborts.
+ */
+void gif_log_assert(const char *cond, const char *tag, const char *fmt, ...)
+        __attribute__((noreturn));
+
+// ---------------------------------------------------------------------
+
 /*
  * Normally we strip ALOGV (VERBOSE messages) from release builds.
  * You can modify this (for example with "#define LOG_NDEBUG 0"
@@ -240,7 +274,7 @@ extern "C" {
  */
 #ifndef ALOG
 #define ALOG(priority, tag, ...) \
-    LOG_PRI(ANDROID_##priority, tag, __VA_ARGS__)
+    LOG_PRI(GIF_##priority, tag, __VA_ARGS__)
 #endif
 
 /*
@@ -248,7 +282,7 @@ extern "C" {
  */
 #ifndef LOG_PRI
 #define LOG_PRI(priority, tag, ...) \
-    __android_log_print(priority, tag, __VA_ARGS__)
+    gif_log_print(priority, tag, __VA_ARGS__)
 #endif
 
 /*
@@ -256,15 +290,16 @@ extern "C" {
  */
 #ifndef LOG_PRI_VA
 #define LOG_PRI_VA(priority, tag, fmt, args) \
-    __android_log_vprint(priority, NULL, tag, fmt, args)
+    gif_log_vprint(priority, tag, fmt, args)
 #endif
 
 /*
- * Conditional given a desired logging priority and tag.
+ * Conditional given a desired logging priority and tag. The sink decides
+ * what to keep, so every priority is enabled here.
  */
 #ifndef IF_ALOG
 #define IF_ALOG(priority, tag) \
-    if (__android_log_assert(ANDROID_##priority, tag))
+    if (GIF_##priority >= GIF_LOG_VERBOSE)
 #endif
 
 /* Returns 2nd arg.  Used to substitute default value if caller's vararg list
@@ -278,7 +313,7 @@ extern "C" {
 #define __android_rest(first, ...)               , ## __VA_ARGS__
 
 #define android_printAssert(cond, tag, fmt...) \
-    __android_log_assert(cond, tag, \
+    gif_log_assert(cond, tag, \
         __android_second(0, ## fmt, NULL) __android_rest(fmt))
 
 #ifdef __cplusplus
@@ -53,10 +53,14 @@ public class FrameSequenceDrawable extends Drawable implements Animatable, Runna
      */
     private static final long MIN_DELAY_MS = 20;
     private static final long DEFAULT_DELAY_MS = 100;
+    /**
+     * How soon to look again when the prefetched frame is not composited yet.
+     */
+    private static final long PREFETCH_RETRY_MS = 4;
     private static final BitmapProvider DEFAULT_BITMAP_PROVIDER = new BitmapProvider() {
         @Override
-        public Bitmap acquireBitmap(int minWidth, int minHeight) {
-            return Bitmap.createBitmap(minWidth, minHeight, Bitmap.Config.ARGB_8888);
+        public Bitmap acquireBitmap(int minWidth, int minHeight, Bitmap.Config config) {
+            return Bitmap.createBitmap(minWidth, minHeight, config);
         }
 
         @Override
@@ -107,12 +111,13 @@ public class FrameSequenceDrawable extends Drawable implements Animatable, Runna
     }
 
     private static Bitmap acquireAndValidateBitmap(BitmapProvider bitmapProvider,
-                                                   int minWidth, int minHeight) {
-        Bitmap bitmap = bitmapProvider.acquireBitmap(minWidth, minHeight);
+                                                   int minWidth, int minHeight,
+                                                   Bitmap.Config config) {
+        Bitmap bitmap = bitmapProvider.acquireBitmap(minWidth, minHeight, config);
 
         if (bitmap.getWidth() < minWidth
                 || bitmap.getHeight() < minHeight
-                || bitmap.getConfig() != Bitmap.Config.ARGB_8888) {
+                || bitmap.getConfig() != config) {
             throw new IllegalArgumentException("Invalid bitmap provided");
         }
 
@@ -122,7 +127,11 @@ public class FrameSequenceDrawable extends Drawable implements Animatable, Runna
     // ///////////////////////////////////////////////  Object define //////////////////////////////////////////////////////
 
     private final GifDecoder mDecoder;
+    // 0 when frames are scaled to mOutputWidth x mOutputHeight with getScaledFrame
     private final int mInSampleSize;
+    private final int mOutputWidth;
+    private final int mOutputHeight;
+    private final Bitmap.Config mConfig;
 
     private final Paint mPaint;
     private BitmapShader mFrontBitmapShader;
@@ -147,9 +156,47 @@ public class FrameSequenceDrawable extends Drawable implements Animatable, Runna
     private long mNextSwap;
     private int mNextFrameToDecode;
     private OnFinishedListener mOnFinishedListener;
+    private int mPrefetchFrameCount;
+    // Whether the running playback takes frames from the decoder's prefetch
+    private boolean mPrefetching;
+    // Only used on the decoding thread
+    private final long[] mTakenDelayMs = new long[1];
 
     private final RectF mTempRectF = new RectF();
 
+    /**
+     * Runs on decoding thread, starts the decoder's prefetch for a new playback
+     */
+    private final Runnable mStartPrefetchRunnable = new Runnable() {
+        @Override
+        public void run() {
+            int frameCount;
+            synchronized (mLock) {
+                if (mDestroyed || !mPrefetching) {
+                    return;
+                }
+                frameCount = mPrefetchFrameCount;
+            }
+            if (!mDecoder.startPrefetch(frameCount, 0, mInSampleSize, mOutputWidth,
+                    mOutputHeight, mConfig)) {
+                Log.e(TAG, "failed to start prefetch, decoding frames one at a time");
+                synchronized (mLock) {
+                    mPrefetching = false;
+                }
+            }
+        }
+    };
+
+    /**
+     * Runs on decoding thread, so stopping never waits on the UI thread
+     */
+    private final Runnable mStopPrefetchRunnable = new Runnable() {
+        @Override
+        public void run() {
+            mDecoder.stopPrefetch();
+        }
+    };
+
     /**
      * Runs on decoding thread, only modifies mBackBitmap's pixels
      */
@@ -158,6 +205,8 @@ public class FrameSequenceDrawable extends Drawable implements Animatable, Runna
         public void run() {
             int nextFrame;
             Bitmap bitmap;
+            boolean prefetching;
+            int prefetchFrameCount;
             synchronized (mLock) {
                 if (mDestroyed) {
                     return;
@@ -167,45 +216,115 @@ public class FrameSequenceDrawable extends Drawable implements Animatable, Runna
                     return;
                 }
                 bitmap = mBackBitmap;
+                prefetching = mPrefetching;
+                prefetchFrameCount = mPrefetchFrameCount;
                 mState = STATE_DECODING;
             }
+            if (prefetching) {
+                // progressive decoder: the worker never reads the stream, read here as far as it
+                // may composite ahead
+                while (!mDecoder.isComplete()
+                        && nextFrame + prefetchFrameCount >= mDecoder.getFrameCount()) {
+                    if (mDecoder.decodeMoreFrames(1) < 0) {
+                        break;
+                    }
+                }
+                takePrefetchedFrame(bitmap);
+                return;
+            }
+            if (nextFrame >= mDecoder.getFrameCount()) {
+                // progressive decoder: read on until the frame arrives, wrap if the gif ends first
+                while (nextFrame >= mDecoder.getFrameCount() && !mDecoder.isComplete()) {
+                    if (mDecoder.decodeMoreFrames(1) < 0) {
+                        break;
+                    }
+                }
+                if (nextFrame >= mDecoder.getFrameCount()) {
+                    nextFrame = 0;
+                    synchronized (mLock) {
+                        if (mNextFrameToDecode >= 0) {
+                            mNextFrameToDecode = nextFrame;
+                        }
+                    }
+                }
+            }
             int lastFrame = nextFrame - 2;
             boolean exceptionDuringDecode = false;
             long invalidateTimeMs = 0;
             try {
-                invalidateTimeMs = mDecoder.getFrame(nextFrame, bitmap, lastFrame, mInSampleSize);
+                invalidateTimeMs = drawFrame(nextFrame, bitmap, lastFrame);
             } catch (Exception e) {
                 // Exception during decode: continue, but delay next frame indefinitely.
                 Log.e(TAG, "exception during decode: " + e);
                 exceptionDuringDecode = true;
             }
 
-            if (invalidateTimeMs < MIN_DELAY_MS) {
-                invalidateTimeMs = DEFAULT_DELAY_MS;
-            }
+            finishDecode(invalidateTimeMs, exceptionDuringDecode);
+        }
+    };
 
-            boolean schedule = false;
-            Bitmap bitmapToRelease = null;
+    /**
+     * Runs on decoding thread: copies the next frame composited ahead by the decoder into
+     * bitmap, or looks again shortly if it is not ready, keeping the current frame on screen.
+     */
+    private void takePrefetchedFrame(Bitmap bitmap) {
+        int frameNr = mDecoder.takeNextFrame(bitmap, mTakenDelayMs);
+        if (frameNr < 0) {
+            boolean retry = false;
             synchronized (mLock) {
-                if (mDestroyed) {
-                    bitmapToRelease = mBackBitmap;
-                    mBackBitmap = null;
-                } else if (mNextFrameToDecode >= 0 && mState == STATE_DECODING) {
-                    schedule = true;
-                    mNextSwap = exceptionDuringDecode ? Long.MAX_VALUE : invalidateTimeMs + mLastSwap;
-                    mState = STATE_WAITING_TO_SWAP;
+                if (!mDestroyed && mNextFrameToDecode >= 0 && mState == STATE_DECODING) {
+                    // destroy() releases the back bitmap while no decode is in progress
+                    mState = STATE_SCHEDULED;
+                    retry = true;
                 }
             }
-            if (schedule) {
-                scheduleSelf(FrameSequenceDrawable.this, mNextSwap);
+            if (retry) {
+                sDecodingThreadHandler.postDelayed(mDecodeRunnable, PREFETCH_RETRY_MS);
+            } else {
+                // stopped, or destroyed while decoding: releases the back bitmap
+                finishDecode(0, false);
+            }
+            return;
+        }
+        bitmap.setHasAlpha(!mDecoder.isFrameOpaque(frameNr));
+        synchronized (mLock) {
+            if (mNextFrameToDecode >= 0) {
+                // frames come in playback order, the loop is counted from the frame taken
+                mNextFrameToDecode = frameNr;
             }
-            if (bitmapToRelease != null) {
-                // destroy the bitmap here, since there's no safe way to get back to
-                // drawable thread - drawable is likely detached, so schedule is noop.
-                mBitmapProvider.releaseBitmap(bitmapToRelease);
+        }
+        finishDecode(mTakenDelayMs[0], false);
+    }
+
+    /**
+     * Runs on decoding thread once mBackBitmap holds the next frame
+     */
+    private void finishDecode(long invalidateTimeMs, boolean exceptionDuringDecode) {
+        if (invalidateTimeMs < MIN_DELAY_MS) {
+            invalidateTimeMs = DEFAULT_DELAY_MS;
+        }
+
+        boolean schedule = false;
+        Bitmap bitmapToRelease = null;
+        synchronized (mLock) {
+            if (mDestroyed) {
+                bitmapToRelease = mBackBitmap;
+                mBackBitmap = null;
+            } else if (mNextFrameToDecode >= 0 && mState == STATE_DECODING) {
+                schedule = true;
+                mNextSwap = exceptionDuringDecode ? Long.MAX_VALUE : invalidateTimeMs + mLastSwap;
+                mState = STATE_WAITING_TO_SWAP;
             }
         }
-    };
+        if (schedule) {
+            scheduleSelf(FrameSequenceDrawable.this, mNextSwap);
+        }
+        if (bitmapToRelease != null) {
+            // destroy the bitmap here, since there's no safe way to get back to
+            // drawable thread - drawable is likely detached, so schedule is noop.
+            mBitmapProvider.releaseBitmap(bitmapToRelease);
+        }
+    }
 
     private final Runnable mFinishedCallbackRunnable = new Runnable() {
         @Override
@@ -225,16 +344,39 @@ public class FrameSequenceDrawable extends Drawable implements Animatable, Runna
     }
 
     public FrameSequenceDrawable(GifDecoder decoder, BitmapProvider bitmapProvider, int inSampleSize) {
+        this(decoder, bitmapProvider, inSampleSize, 0, 0);
+    }
+
+    /**
+     * Play frames scaled to {@code width} x {@code height} pixels, not limited to a whole divisor
+     * of the gif size. The intrinsic size stays the gif size.
+     */
+    public FrameSequenceDrawable(GifDecoder decoder, BitmapProvider bitmapProvider, int width,
+                                 int height) {
+        this(decoder, bitmapProvider, 0, width, height);
+    }
+
+    private FrameSequenceDrawable(GifDecoder decoder, BitmapProvider bitmapProvider,
+                                  int inSampleSize, int width, int height) {
         if (decoder == null || bitmapProvider == null) {
             throw new IllegalArgumentException();
         }
+        if (inSampleSize > 0) {
+            width = decoder.getWidth() / inSampleSize;
+            height = decoder.getHeight() / inSampleSize;
+        } else if (width <= 0 || height <= 0) {
+            throw new IllegalArgumentException();
+        }
         mDecoder = decoder;
         mInSampleSize = inSampleSize;
+        mOutputWidth = width;
+        mOutputHeight = height;
         mBitmapProvider = bitmapProvider;
-        final int width = decoder.getWidth() / inSampleSize;
-        final int height = decoder.getHeight() / inSampleSize;
-        mFrontBitmap = acquireAndValidateBitmap(bitmapProvider, width, height);
-        mBackBitmap = acquireAndValidateBitmap(bitmapProvider, width, height);
+        // RGB_565 when no frame has transparent pixels
+        Bitmap.Config config = decoder.getPreferredConfig();
+        mConfig = config;
+        mFrontBitmap = acquireAndValidateBitmap(bitmapProvider, width, height, config);
+        mBackBitmap = acquireAndValidateBitmap(bitmapProvider, width, height, config);
         mSrcRect = new Rect(0, 0, width, height);
         mPaint = new Paint();
         mPaint.setFilterBitmap(true);
@@ -247,10 +389,23 @@ public class FrameSequenceDrawable extends Drawable implements Animatable, Runna
         mLastSwap = 0;
 
         mNextFrameToDecode = -1;
-        mDecoder.getFrame(0, mFrontBitmap, -1, mInSampleSize);
+        drawFrame(0, mFrontBitmap, -1);
         initializeDecodingThread();
     }
 
+    private long drawFrame(int frameNr, Bitmap bitmap, int previousFrameNr) {
+        long delayMs;
+        if (mInSampleSize == 0) {
+            delayMs = mDecoder.getScaledFrame(frameNr, bitmap, previousFrameNr, mOutputWidth,
+                    mOutputHeight, null);
+        } else {
+            delayMs = mDecoder.getFrame(frameNr, bitmap, previousFrameNr, mInSampleSize);
+        }
+        // Lets the canvas draw frames without transparent pixels without blending
+        bitmap.setHasAlpha(!mDecoder.isFrameOpaque(frameNr));
+        return delayMs;
+    }
+
     /**
      * Define looping behavior of frame sequence.
      * <p>
@@ -277,6 +432,19 @@ public class FrameSequenceDrawable extends Drawable implements Animatable, Runna
     }
 
 
+    /**
+     * Keep up to {@code count} frames composited ahead of playback by a native worker of the
+     * decoder (see {@link GifDecoder#startPrefetch}), so a frame that takes longer than its delay
+     * to composite does not stall the animation; the decoding thread only copies ready frames.
+     * Each frame kept takes a bitmap's worth of native memory. 0, the default, composites one
+     * frame ahead on the decoding thread. Takes effect at the next {@link #start}.
+     */
+    public void setPrefetchFrameCount(int count) {
+        synchronized (mLock) {
+            mPrefetchFrameCount = Math.max(count, 0);
+        }
+    }
+
     /**
      * Pass true to mask the shape of the animated drawing content to a circle.
      *
@@ -321,9 +489,13 @@ public class FrameSequenceDrawable extends Drawable implements Animatable, Runna
 
         Bitmap bitmapToReleaseA;
         Bitmap bitmapToReleaseB = null;
+        boolean prefetching;
         synchronized (mLock) {
             checkDestroyedLocked();
 
+            prefetching = mPrefetching;
+            mPrefetching = false;
+
             bitmapToReleaseA = mFrontBitmap;
             mFrontBitmap = null;
 
@@ -334,6 +506,11 @@ public class FrameSequenceDrawable extends Drawable implements Animatable, Runna
 
             mDestroyed = true;
         }
+        if (prefetching) {
+            // not posted: the owner may destroy the decoder right after this returns. Waits for
+            // at most the frame being composited, and frees the frames composited ahead
+            mDecoder.stopPrefetch();
+        }
 
         // For simplicity and safety, we don't destroy the state object here
         mBitmapProvider.releaseBitmap(bitmapToReleaseA);
@@ -370,7 +547,7 @@ public class FrameSequenceDrawable extends Drawable implements Animatable, Runna
                 mLastSwap = SystemClock.uptimeMillis();
 
                 boolean continueLooping = true;
-                if (mNextFrameToDecode == mDecoder.getFrameCount() - 1) {
+                if (mNextFrameToDecode == mDecoder.getFrameCount() - 1 && mDecoder.isComplete()) {
                     mCurrentLoop++;
                     if ((mLoopBehavior == LOOP_FINITE && mCurrentLoop == mLoopCount) ||
                             (mLoopBehavior == LOOP_DEFAULT && mCurrentLoop == mDecoder.getLooperCount())) {
@@ -472,12 +649,18 @@ public class FrameSequenceDrawable extends Drawable implements Animatable, Runna
 
     @Override
     public int getOpacity() {
-        return mDecoder.isOpaque() ? PixelFormat.OPAQUE : PixelFormat.TRANSPARENT;
+        return mDecoder.isAnimationOpaque() && !mCircleMaskEnabled
+                ? PixelFormat.OPAQUE : PixelFormat.TRANSPARENT;
     }
 
     private void scheduleDecodeLocked() {
         mState = STATE_SCHEDULED;
-        mNextFrameToDecode = (mNextFrameToDecode + 1) % mDecoder.getFrameCount();
+        int nextFrame = mNextFrameToDecode + 1;
+        // frames past the end may still be read by a progressive decoder
+        if (nextFrame >= mDecoder.getFrameCount() && mDecoder.isComplete()) {
+            nextFrame = 0;
+        }
+        mNextFrameToDecode = nextFrame;
         sDecodingThreadHandler.post(mDecodeRunnable);
     }
 
@@ -509,6 +692,11 @@ public class FrameSequenceDrawable extends Drawable implements Animatable, Runna
                     return; // already scheduled
                 }
                 mCurrentLoop = 0;
+                // posted before the first decode, so the prefetch starts from frame 0 with it
+                mPrefetching = mPrefetchFrameCount > 0;
+                if (mPrefetching) {
+                    sDecodingThreadHandler.post(mStartPrefetchRunnable);
+                }
                 scheduleDecodeLocked();
             }
         }
@@ -518,6 +706,14 @@ public class FrameSequenceDrawable extends Drawable implements Animatable, Runna
     public void stop() {
         if (isRunning()) {
             unscheduleSelf(this);
+            boolean prefetching;
+            synchronized (mLock) {
+                prefetching = mPrefetching;
+                mPrefetching = false;
+            }
+            if (prefetching) {
+                sDecodingThreadHandler.post(mStopPrefetchRunnable);
+            }
         }
     }
 
@@ -554,9 +750,11 @@ public class FrameSequenceDrawable extends Drawable implements Animatable, Runna
 
     public interface BitmapProvider {
         /**
-         * Called by FrameSequenceDrawable to aquire an 8888 Bitmap with minimum dimensions.
+         * Called by FrameSequenceDrawable to aquire a Bitmap with minimum dimensions and the
+         * given config: {@link Bitmap.Config#RGB_565} for gifs without transparent pixels,
+         * {@link Bitmap.Config#ARGB_8888} otherwise.
          */
-        Bitmap acquireBitmap(int minWidth, int minHeight);
+        Bitmap acquireBitmap(int minWidth, int minHeight, Bitmap.Config config);
 
         /**
          * Called by FrameSequenceDrawable to release a Bitmap it no longer needs. The Bitmap
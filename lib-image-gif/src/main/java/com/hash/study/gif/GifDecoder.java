@@ -1,6 +1,7 @@
 package com.hash.study.gif;
 
 import android.graphics.Bitmap;
+import android.graphics.Rect;
 import android.util.Log;
 
 import androidx.annotation.Nullable;
@@ -22,7 +23,19 @@ public final class GifDecoder {
      */
     @Nullable
     public static GifDecoder decodeFilePath(String filePath) {
-        return nativeDecodeFile(filePath);
+        return decodeFilePath(filePath, null);
+    }
+
+    /**
+     * Get an instance of GifDecoder
+     *
+     * @param filePath a gif file path.
+     * @param options  decode options, null means default.
+     * @return an instance of GifDecoder, if decode failed will return null.
+     */
+    @Nullable
+    public static GifDecoder decodeFilePath(String filePath, @Nullable Options options) {
+        return nativeDecodeFile(filePath, options);
     }
 
     /**
@@ -33,12 +46,24 @@ public final class GifDecoder {
      */
     @Nullable
     public static GifDecoder decodeStream(InputStream stream) {
+        return decodeStream(stream, null);
+    }
+
+    /**
+     * Get an instance of GifDecoder
+     *
+     * @param stream  a gif stream
+     * @param options decode options, null means default.
+     * @return an instance of GifDecoder, if decode failed will return null.
+     */
+    @Nullable
+    public static GifDecoder decodeStream(InputStream stream, @Nullable Options options) {
         if (stream == null) {
             throw new IllegalArgumentException();
         }
         // use buffer pool
         byte[] tempStorage = new byte[16 * 1024];
-        return nativeDecodeStream(stream, tempStorage);
+        return nativeDecodeStream(stream, tempStorage, options);
     }
 
     /**
@@ -60,13 +85,25 @@ public final class GifDecoder {
      */
     @Nullable
     public static GifDecoder decodeByteArray(byte[] data, int offset, int length) {
+        return decodeByteArray(data, offset, length, null);
+    }
+
+    /**
+     * Get an instance of GifDecoder
+     *
+     * @param data    a gif byte array.
+     * @param options decode options, null means default.
+     * @return an instance of GifDecoder, if decode failed will return null.
+     */
+    @Nullable
+    public static GifDecoder decodeByteArray(byte[] data, int offset, int length, @Nullable Options options) {
         if (data == null) {
             throw new IllegalArgumentException();
         }
         if (offset < 0 || length < 0 || (offset + length > data.length)) {
             throw new IllegalArgumentException("invalid offset/length parameters");
         }
-        return nativeDecodeByteArray(data, offset, length);
+        return nativeDecodeByteArray(data, offset, length, options);
     }
 
     /**
@@ -77,26 +114,282 @@ public final class GifDecoder {
      */
     @Nullable
     public static GifDecoder decodeByteBuffer(ByteBuffer buffer) {
+        return decodeByteBuffer(buffer, null);
+    }
+
+    /**
+     * Get an instance of GifDecoder
+     *
+     * @param buffer  a gif native buffer.
+     * @param options decode options, null means default.
+     * @return an instance of GifDecoder, if decode failed will return null.
+     */
+    @Nullable
+    public static GifDecoder decodeByteBuffer(ByteBuffer buffer, @Nullable Options options) {
         if (buffer == null) {
             throw new IllegalArgumentException();
         }
         if (!buffer.isDirect()) {
             if (buffer.hasArray()) {
                 byte[] byteArray = buffer.array();
-                return decodeByteArray(byteArray, buffer.position(), buffer.remaining());
+                return decodeByteArray(byteArray, buffer.position(), buffer.remaining(), options);
             } else {
                 throw new IllegalArgumentException("Cannot have non-direct ByteBuffer with no byte array");
             }
         }
-        return nativeDecodeByteBuffer(buffer, buffer.position(), buffer.remaining());
+        return nativeDecodeByteBuffer(buffer, buffer.position(), buffer.remaining(), options);
+    }
+
+    // /////////////////////////////////////////// Options. //////////////////////////////////////////////////
+
+    /**
+     * Decode options, fields are read at native when the gif is opened.
+     */
+    public static final class Options {
+
+        /**
+         * If true, only the gif structure is scanned when opened, and the pixels of a frame
+         * are decompressed when {@link #getFrame} needs it. Saves open time and memory for
+         * gifs with many frames.
+         */
+        public boolean lazyDecode;
+
+        /**
+         * Max decompressed frames kept in memory when {@link #lazyDecode} is true,
+         * 0 means only the frame being drawn.
+         */
+        public int rasterCacheSize;
+
+        /**
+         * If true, only the frame index is built and no gif data is kept: width, height,
+         * frame count, looper count and duration are available, but {@link #getFrame}
+         * draws nothing and returns -1. Cheap enough for list thumbnails.
+         */
+        public boolean justDecodeInfo;
+
+        /**
+         * If greater than 0, a copy of the composited canvas is kept every this many frames,
+         * so seeking with {@link #getFrame} only composites from the nearest kept frame
+         * instead of from frame 0. Defaults to 0 (disabled).
+         */
+        public int keyframeInterval;
+
+        /**
+         * Upper bound in bytes for the canvases kept by {@link #keyframeInterval}; the least
+         * recently used ones are dropped beyond it.
+         */
+        public long keyframeCacheBytes = 8 * 1024 * 1024;
+
+        /**
+         * If true, {@link #decodeStream} returns as soon as the first frame is read, and the
+         * remaining frames are read from the stream by {@link #decodeMoreFrames}, so playback can
+         * start before the whole gif is downloaded. The stream is kept open and read from the
+         * thread calling {@link #decodeMoreFrames} until {@link #isComplete} returns true.
+         * Ignored for other sources, and when {@link #lazyDecode} or {@link #justDecodeInfo}
+         * is true.
+         */
+        public boolean progressive;
+
+        /**
+         * If true, only the compressed LZW data of each frame is kept, typically 5 to 20 times
+         * smaller than the decompressed pixels, and a frame is decompressed into the cache sized
+         * by {@link #rasterCacheSize} when {@link #getFrame} draws it. Unlike
+         * {@link #lazyDecode} the gif source is released once opened. Ignored when
+         * {@link #lazyDecode}, {@link #justDecodeInfo} or {@link #progressive} applies.
+         */
+        public boolean compressedFrames;
+
+        /**
+         * If true, a frame drawn with an inSampleSize greater than 1 averages each
+         * inSampleSize x inSampleSize block of pixels instead of taking one pixel of it, so
+         * small thumbnails do not shimmer or alias. Costs reading every pixel of the frame.
+         */
+        public boolean boxFilter;
+
+        /**
+         * If greater than 0, the native memory in bytes the decoder should stay within. When
+         * decoding every frame up front would exceed it, the gif is opened with
+         * {@link #compressedFrames}, or {@link #lazyDecode} for a mapped file, instead and
+         * {@link #rasterCacheSize} and
+         * {@link #keyframeCacheBytes} are lowered to fit. Decided once when the gif is opened;
+         * ignored with {@link #progressive} or {@link #justDecodeInfo}. Defaults to 0 (no limit).
+         */
+        public long memoryBudgetBytes;
+
+        /**
+         * Threads, including the calling one, that composite horizontal bands of a frame in
+         * parallel in {@link #getFrame}. 0 uses one per CPU core, 1 (the default) composites on
+         * the calling thread only. Areas below about 512 x 512 pixels are always composited on
+         * the calling thread, as handing them out costs more than it saves.
+         */
+        public int compositeThreads = 1;
+
+        /**
+         * Threads, including the calling one, that decompress frames in parallel when the whole
+         * GIF is decoded on open. 0 uses one per CPU core, 1 (the default) decodes frames one
+         * after another. Ignored when frames are not all decoded up front: {@link #lazyDecode},
+         * {@link #justDecodeInfo}, {@link #progressive} and {@link #compressedFrames}.
+         */
+        public int decodeThreads = 1;
+    }
+
+    /**
+     * Native memory held by one decoder, see {@link #getMemoryUsage}.
+     */
+    public static final class MemoryUsage {
+        /**
+         * Decompressed frame pixels: every frame, or the cached ones with
+         * {@link Options#lazyDecode}.
+         */
+        public final long rasters;
+        /**
+         * Copy of the gif data kept by {@link Options#lazyDecode} for streams and byte arrays.
+         */
+        public final long sourceCopy;
+        /**
+         * Compressed data kept by {@link Options#compressedFrames}.
+         */
+        public final long compressedFrames;
+        /**
+         * Read-only mapping of a gif file, backed by the page cache and reclaimable by the
+         * system, so not part of {@link #getTotalBytes}.
+         */
+        public final long mappedSource;
+        /**
+         * Canvas kept for frames disposed to the previous frame.
+         */
+        public final long preserveBuffer;
+        /**
+         * Canvases kept by {@link Options#keyframeInterval}.
+         */
+        public final long keyframes;
+        /**
+         * Color lookup tables built for the palettes drawn so far.
+         */
+        public final long paletteLuts;
+        /**
+         * Color maps, extension blocks, frame index and per-frame information.
+         */
+        public final long metadata;
+        /**
+         * Intermediate canvas and filter tables kept by {@link GifDecoder#getScaledFrame}.
+         */
+        public final long scaledCanvas;
+        /**
+         * Frames composited ahead and the canvas they are composited on, see
+         * {@link GifDecoder#startPrefetch}.
+         */
+        public final long prefetch;
+
+        private MemoryUsage(long[] values) {
+            rasters = values[0];
+            sourceCopy = values[1];
+            compressedFrames = values[2];
+            mappedSource = values[3];
+            preserveBuffer = values[4];
+            keyframes = values[5];
+            paletteLuts = values[6];
+            metadata = values[7];
+            scaledCanvas = values[8];
+            prefetch = values[9];
+        }
+
+        /**
+         * Get the bytes allocated by the decoder, all categories but {@link #mappedSource}.
+         */
+        public long getTotalBytes() {
+            return rasters + sourceCopy + compressedFrames + preserveBuffer + keyframes
+                    + paletteLuts + metadata + scaledCanvas + prefetch;
+        }
+
+        @Override
+        public String toString() {
+            return "MemoryUsage{" +
+                    "Total=" + getTotalBytes() + "B, " +
+                    "Rasters=" + rasters + "B, " +
+                    "SourceCopy=" + sourceCopy + "B, " +
+                    "CompressedFrames=" + compressedFrames + "B, " +
+                    "MappedSource=" + mappedSource + "B, " +
+                    "PreserveBuffer=" + preserveBuffer + "B, " +
+                    "Keyframes=" + keyframes + "B, " +
+                    "PaletteLuts=" + paletteLuts + "B, " +
+                    "Metadata=" + metadata + "B, " +
+                    "ScaledCanvas=" + scaledCanvas + "B, " +
+                    "Prefetch=" + prefetch + "B" +
+                    '}';
+        }
+    }
+
+    /**
+     * Counters of the memory pool shared by all decoders, see {@link #getPoolStats}.
+     */
+    public static final class PoolStats {
+        /**
+         * Giflib decoder states (LZW tables and frame arrays) allocated, and taken from the pool.
+         */
+        public final long stateAllocs, stateReuses;
+        /**
+         * Frame pixel and canvas buffers allocated, and taken from the pool.
+         */
+        public final long bufferAllocs, bufferReuses;
+        /**
+         * Bytes currently kept by the pool.
+         */
+        public final long retainedBytes;
+
+        private PoolStats(long[] values) {
+            stateAllocs = values[0];
+            stateReuses = values[1];
+            bufferAllocs = values[2];
+            bufferReuses = values[3];
+            retainedBytes = values[4];
+        }
+
+        @Override
+        public String toString() {
+            return "PoolStats{" +
+                    "States=" + stateReuses + "/" + (stateAllocs + stateReuses) + " reused, " +
+                    "Buffers=" + bufferReuses + "/" + (bufferAllocs + bufferReuses) + " reused, " +
+                    "Retained=" + retainedBytes + "B" +
+                    '}';
+        }
+    }
+
+    /**
+     * Set how much memory destroyed decoders leave for the next ones: decoder states and
+     * pixel buffers are reused instead of being allocated again, which helps when many gifs
+     * are opened and closed in a short time, e.g. in a scrolling list. Defaults to 4 states
+     * and 4MB of buffers, 0 disables the reuse.
+     *
+     * @param maxStates      max giflib decoder states kept, each about 50KB.
+     * @param maxBufferBytes max bytes of pixel buffers kept.
+     */
+    public static void setPoolLimits(int maxStates, long maxBufferBytes) {
+        nativeSetPoolLimits(maxStates, maxBufferBytes);
+    }
+
+    /**
+     * Free all memory kept by the pool, e.g. from {@code onTrimMemory}.
+     */
+    public static void trimPool() {
+        nativeTrimPool();
+    }
+
+    /**
+     * Get the counters of the pool since the process started.
+     */
+    public static PoolStats getPoolStats() {
+        return new PoolStats(nativeGetPoolStats());
     }
 
     // /////////////////////////////////////////// Inner Method. //////////////////////////////////////////////////
 
     private long mNativePtr;
-    private final int mWidth, mHeight, mFrameCount, mLooperCount;
+    private final int mWidth, mHeight, mLooperCount;
     private final boolean mIsOpaque;
-    private final long mDuration;
+    // grow while a progressive decoder reads more frames
+    private volatile int mFrameCount;
+    private volatile long mDuration;
 
     // invoke at native
     private GifDecoder(long nativePtr, int width, int height, boolean isOpaque, int frameCount, int looperCount, long duration) {
@@ -131,10 +424,199 @@ public final class GifDecoder {
      * @param output          in and out args, will fill pixels at native.
      * @param previousFrameNr previous frame number, u can pass -1.
      * @param inSampleSize    do sample size, is power of 2.
-     * @return next frame duration. Unit is ms
+     * @return next frame duration. Unit is ms, -1 if decoded with {@link Options#justDecodeInfo}.
      */
     public long getFrame(int frameNr, Bitmap output, int previousFrameNr, int inSampleSize) {
-        return nativeGetFrame(mNativePtr, frameNr, output, previousFrameNr, inSampleSize);
+        return getFrame(frameNr, output, previousFrameNr, inSampleSize, null);
+    }
+
+    /**
+     * Get Bitmap at require frame, and report which pixels of {@code output} were changed.
+     *
+     * @param frameNr         the frame that u wanted.
+     * @param output          in and out args, will fill pixels at native. Should hold
+     *                        {@code previousFrameNr} when it is not -1. May be
+     *                        {@link Bitmap.Config#ARGB_8888}, {@link Bitmap.Config#RGB_565}
+     *                        (drops alpha, see {@link #getPreferredConfig}) or
+     *                        {@link Bitmap.Config#ALPHA_8} (keeps only alpha, for masks).
+     * @param previousFrameNr previous frame number, u can pass -1.
+     * @param inSampleSize    do sample size, is power of 2.
+     * @param outDirtyRect    if not null, set to the area of {@code output} changed by this call,
+     *                        in sampled pixels. Only this area needs to be uploaded or invalidated.
+     *                        Empty if nothing changed.
+     * @return next frame duration. Unit is ms, -1 if decoded with {@link Options#justDecodeInfo}.
+     */
+    public long getFrame(int frameNr, Bitmap output, int previousFrameNr, int inSampleSize,
+                         @Nullable Rect outDirtyRect) {
+        return nativeGetFrame(mNativePtr, frameNr, output, previousFrameNr, inSampleSize,
+                outDirtyRect);
+    }
+
+    /**
+     * Get Bitmap at require frame, scaled to any size instead of a whole divisor of the gif size.
+     * The frame is composited with the largest inSampleSize that does not go below the target,
+     * then filtered down (or up) to {@code outputWidth} x {@code outputHeight} from a canvas
+     * kept by the decoder, so only the changed area is filtered again for the next frame.
+     *
+     * @param frameNr         the frame that u wanted.
+     * @param output          in and out args, at least {@code outputWidth} x {@code outputHeight}.
+     *                        Should hold {@code previousFrameNr} at the same size when it is not -1.
+     *                        Same configs as {@link #getFrame}.
+     * @param previousFrameNr previous frame number, u can pass -1.
+     * @param outputWidth     width to scale the gif to.
+     * @param outputHeight    height to scale the gif to.
+     * @param outDirtyRect    if not null, set to the area of {@code output} changed by this call.
+     * @return next frame duration. Unit is ms, -1 if decoded with {@link Options#justDecodeInfo}.
+     */
+    public long getScaledFrame(int frameNr, Bitmap output, int previousFrameNr, int outputWidth,
+                               int outputHeight, @Nullable Rect outDirtyRect) {
+        return nativeGetScaledFrame(mNativePtr, frameNr, output, previousFrameNr, outputWidth,
+                outputHeight, outDirtyRect);
+    }
+
+    /**
+     * Start compositing frames ahead of playback on a native worker thread owned by the decoder.
+     * Frames are composited in playback order from {@code firstFrame}, looping forever, each on
+     * top of the one before, so disposal works as in sequential playback. Up to
+     * {@code frameCount} composited frames are kept until taken with {@link #takeNextFrame}, and
+     * the worker waits while all of them are there. A prefetch already running is stopped first.
+     * Other calls still work meanwhile but wait for the frame being composited. The worker never
+     * reads the stream: with {@link Options#progressive} keep calling {@link #decodeMoreFrames},
+     * the worker waits for the frames it reads.
+     *
+     * @param frameCount   frames to keep ready, each takes a bitmap's worth of native memory.
+     * @param firstFrame   the frame to start from.
+     * @param inSampleSize as {@link #getFrame}, or 0 to scale to {@code outputWidth} x
+     *                     {@code outputHeight} as {@link #getScaledFrame}.
+     * @param outputWidth  width to scale the gif to when {@code inSampleSize} is 0.
+     * @param outputHeight height to scale the gif to when {@code inSampleSize} is 0.
+     * @param config       config of the bitmaps the frames will be taken into.
+     * @return false if the arguments are invalid or the gif cannot be drawn.
+     */
+    public boolean startPrefetch(int frameCount, int firstFrame, int inSampleSize,
+                                 int outputWidth, int outputHeight, Bitmap.Config config) {
+        return nativeStartPrefetch(mNativePtr, frameCount, firstFrame, inSampleSize, outputWidth,
+                outputHeight, toNativeFormat(config));
+    }
+
+    /**
+     * Stop compositing ahead and free the frames kept. Waits for the frame being composited.
+     */
+    public void stopPrefetch() {
+        nativeStopPrefetch(mNativePtr);
+    }
+
+    /**
+     * Copy the next frame composited by {@link #startPrefetch} into {@code output}. Never waits
+     * for compositing: returns -1 at once when the frame is not ready yet.
+     *
+     * @param output     at least the prefetched size, with the config given to
+     *                   {@link #startPrefetch}.
+     * @param outDelayMs if not null, {@code outDelayMs[0]} is set to the frame duration in ms.
+     * @return the frame number copied, -1 if no frame is ready, the prefetch is not running or
+     * {@code output} does not match it.
+     */
+    public int takeNextFrame(Bitmap output, @Nullable long[] outDelayMs) {
+        return nativeTakeNextFrame(mNativePtr, output, outDelayMs);
+    }
+
+    /**
+     * Whether a frame can be drawn without any earlier frame: frame 0, an opaque frame covering
+     * the whole gif, or a frame following one that clears the whole gif. {@link #getFrame}
+     * starts compositing from the nearest such frame instead of frame 0.
+     *
+     * @param frameNr frame number.
+     * @return true if the frame is independent.
+     */
+    public boolean isIndependentFrame(int frameNr) {
+        return nativeIsIndependentFrame(mNativePtr, frameNr);
+    }
+
+    /**
+     * Read more frames of a gif decoded with {@link Options#progressive}. Blocks on the stream,
+     * so call it from a worker thread; it may run while another thread calls {@link #getFrame}.
+     *
+     * @param maxFrames max frames to read.
+     * @return frames read, 0 if already complete, -1 if the stream failed or the gif is broken.
+     * Frames read before a failure can still be drawn.
+     */
+    public int decodeMoreFrames(int maxFrames) {
+        int count = nativeDecodeMoreFrames(mNativePtr, maxFrames);
+        mFrameCount = nativeGetFrameCount(mNativePtr);
+        mDuration = nativeGetDuration(mNativePtr);
+        return count;
+    }
+
+    /**
+     * Whether all frames are read. Always true unless decoded with {@link Options#progressive};
+     * until then {@link #getFrameCount} and {@link #getDuration} only cover the frames read.
+     */
+    public boolean isComplete() {
+        return nativeIsComplete(mNativePtr);
+    }
+
+    /**
+     * Whether every pixel of the gif is opaque once {@code frameNr} is drawn, whatever was drawn
+     * before. Worked out when the frame is read from transparent colors, disposal modes and
+     * frame rectangles, and from the pixels unless decoded with {@link Options#lazyDecode} or
+     * {@link Options#compressedFrames}. Such frames can be drawn without blending.
+     *
+     * @param frameNr frame number.
+     * @return true if the frame is opaque, false if it may have transparent pixels.
+     */
+    public boolean isFrameOpaque(int frameNr) {
+        return nativeIsFrameOpaque(mNativePtr, frameNr);
+    }
+
+    /**
+     * Whether every pixel of every frame is opaque, see {@link #isFrameOpaque}, so frames can be
+     * drawn into {@link Bitmap.Config#RGB_565} without losing anything. Unlike {@link #isOpaque}
+     * this does not depend on the background color. Decided from the frames read so far: always
+     * false until {@link #isComplete}.
+     */
+    public boolean isAnimationOpaque() {
+        return nativeIsAnimationOpaque(mNativePtr);
+    }
+
+    /**
+     * The bitmap config to draw frames into: {@link Bitmap.Config#RGB_565} when
+     * {@link #isAnimationOpaque}, which halves the bitmap memory and upload bandwidth,
+     * {@link Bitmap.Config#ARGB_8888} otherwise.
+     */
+    public Bitmap.Config getPreferredConfig() {
+        return isAnimationOpaque() ? Bitmap.Config.RGB_565 : Bitmap.Config.ARGB_8888;
+    }
+
+    /**
+     * The native PixelFormat of a bitmap config, -1 if frames cannot be drawn into it.
+     */
+    private static int toNativeFormat(Bitmap.Config config) {
+        if (config == Bitmap.Config.ARGB_8888) {
+            return 0;
+        } else if (config == Bitmap.Config.RGB_565) {
+            return 1;
+        } else if (config == Bitmap.Config.ALPHA_8) {
+            return 2;
+        }
+        return -1;
+    }
+
+    /**
+     * Get the delay of every frame, parsed once when the frames are read. Lets a caller plan the
+     * whole playback without drawing; with {@link Options#progressive} only the frames read so
+     * far are included.
+     *
+     * @return delay in milliseconds per frame number.
+     */
+    public int[] getFrameDelays() {
+        return nativeGetFrameDelays(mNativePtr);
+    }
+
+    /**
+     * Get the native memory currently held by this decoder, by category.
+     */
+    public MemoryUsage getMemoryUsage() {
+        return new MemoryUsage(nativeGetMemoryUsage(mNativePtr));
     }
 
     /**
@@ -213,15 +695,47 @@ public final class GifDecoder {
         System.loadLibrary("giftool");
     }
 
-    private static native GifDecoder nativeDecodeFile(String filePath);
+    private static native GifDecoder nativeDecodeFile(String filePath, Options options);
+
+    private static native GifDecoder nativeDecodeStream(InputStream stream, byte[] tempStorage, Options options);
+
+    private static native GifDecoder nativeDecodeByteArray(byte[] data, int offset, int length, Options options);
+
+    private static native GifDecoder nativeDecodeByteBuffer(ByteBuffer buffer, int position, int remaining, Options options);
+
+    private static native long nativeGetFrame(long decoder, int frameNr, Bitmap output, int previousFrameNr, int inSampleSize, Rect outDirtyRect);
+
+    private static native long nativeGetScaledFrame(long decoder, int frameNr, Bitmap output, int previousFrameNr, int outputWidth, int outputHeight, Rect outDirtyRect);
+
+    private static native boolean nativeStartPrefetch(long nativePtr, int frameCount, int firstFrame, int inSampleSize, int outputWidth, int outputHeight, int format);
+
+    private static native void nativeStopPrefetch(long nativePtr);
+
+    private static native int nativeTakeNextFrame(long nativePtr, Bitmap output, long[] outDelayMs);
+
+    private static native boolean nativeIsIndependentFrame(long nativePtr, int frameNr);
+
+    private static native int nativeDecodeMoreFrames(long nativePtr, int maxFrames);
+
+    private static native boolean nativeIsComplete(long nativePtr);
+
+    private static native boolean nativeIsFrameOpaque(long nativePtr, int frameNr);
+
+    private static native boolean nativeIsAnimationOpaque(long nativePtr);
+
+    private static native int nativeGetFrameCount(long nativePtr);
+
+    private static native long nativeGetDuration(long nativePtr);
+
+    private static native int[] nativeGetFrameDelays(long nativePtr);
 
-    private static native GifDecoder nativeDecodeStream(InputStream stream, byte[] tempStorage);
+    private static native long[] nativeGetMemoryUsage(long nativePtr);
 
-    private static native GifDecoder nativeDecodeByteArray(byte[] data, int offset, int length);
+    private static native void nativeSetPoolLimits(int maxStates, long maxBufferBytes);
 
-    private static native GifDecoder nativeDecodeByteBuffer(ByteBuffer buffer, int position, int remaining);
+    private static native void nativeTrimPool();
 
-    private static native long nativeGetFrame(long decoder, int frameNr, Bitmap output, int previousFrameNr, int inSampleSize);
+    private static native long[] nativeGetPoolStats();
 
     private static native void nativeDestroy(long nativePtr);
 }
@@ -0,0 +1,241 @@
+/**
+ * Compositor 各实现 (SSE4.1 / AVX2 / NEON) 与标量实现逐字节对比, 当前 CPU 不支持的实现跳过.
+ */
+
+#include <stdint.h>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+#include "Compositor.h"
+
+namespace {
+
+    // 覆盖 SIMD 主循环、尾部以及多于一个向量宽度的各种余数
+    const int MAX_WIDTH = 130;
+    const int SAMPLE_SIZES[] = {1, 2, 3, 4, 7};
+    // dst 之后不应被写入的像素数
+    const int GUARD = 16;
+
+    struct Palette {
+        Color8888 colors[256];
+        Color565 colors565[256];
+    };
+
+    // 部分索引为 TRANSPARENT, 其余为不透明颜色, 与 GifDecoder 的查找表相同
+    Palette makePalette(std::mt19937 &random) {
+        Palette palette;
+        for (int i = 0; i < 256; i++) {
+            palette.colors[i] = i % 7 == 3 ? TRANSPARENT
+                                           : COLOR_8888_ALPHA_MASK | (random() & 0xffffff);
+            palette.colors565[i] = color8888To565(palette.colors[i]);
+        }
+        return palette;
+    }
+
+    // 预乘的 ARGB, 与合成后的画布相同
+    Color8888 randomPremultiplied(std::mt19937 &random) {
+        const uint32_t alpha = random() % 4 == 0 ? 0 : random() & 0xff;
+        Color8888 color = alpha << 24;
+        for (int c = 0; c < 3; c++) {
+            color |= (alpha ? random() % (alpha + 1) : 0) << (c * 8);
+        }
+        return color;
+    }
+
+    std::vector<uint8_t> randomBytes(std::mt19937 &random, size_t size) {
+        std::vector<uint8_t> bytes(size);
+        for (size_t i = 0; i < size; i++) {
+            bytes[i] = (uint8_t) random();
+        }
+        return bytes;
+    }
+
+    // 每个输出像素 taps 个非负权重, 和为 1 << SCALE_WEIGHT_BITS, 与 FrameScaler 的权重相同
+    std::vector<int16_t> randomWeights(std::mt19937 &random, int taps, int count) {
+        std::vector<int16_t> weights((size_t) taps * count);
+        for (int x = 0; x < count; x++) {
+            int remaining = 1 << SCALE_WEIGHT_BITS;
+            for (int t = 0; t < taps - 1; t++) {
+                const int weight = (int) (random() % (remaining + 1));
+                weights[x * taps + t] = (int16_t) weight;
+                remaining -= weight;
+            }
+            weights[x * taps + taps - 1] = (int16_t) remaining;
+        }
+        return weights;
+    }
+
+    class CompositorTest : public ::testing::TestWithParam<CompositeKernel> {
+    protected:
+        void SetUp() override {
+            mSavedKernel = getCompositeKernel();
+            if (!setCompositeKernel(GetParam())) {
+                GTEST_SKIP() << "kernel not supported on this CPU";
+            }
+        }
+
+        void TearDown() override {
+            setCompositeKernel(mSavedKernel);
+        }
+
+        // 以标量实现执行 task, 之后恢复为被测实现
+        template<typename Task>
+        void runScalar(Task task) {
+            setCompositeKernel(COMPOSITE_SCALAR);
+            task();
+            setCompositeKernel(GetParam());
+        }
+
+        CompositeKernel mSavedKernel = COMPOSITE_SCALAR;
+        std::mt19937 mRandom{20240601};
+    };
+
+    TEST_P(CompositorTest, CompositeLineMatchesScalar) {
+        const Palette palette = makePalette(mRandom);
+        for (int width = 1; width <= MAX_WIDTH; width++) {
+            for (int sampleSize : SAMPLE_SIZES) {
+                const std::vector<uint8_t> src = randomBytes(mRandom, (size_t) width * sampleSize);
+                std::vector<Color8888> expected(width + GUARD);
+                for (size_t i = 0; i < expected.size(); i++) {
+                    expected[i] = (Color8888) mRandom();
+                }
+                std::vector<Color8888> actual = expected;
+                runScalar([&] {
+                    compositeLine(expected.data(), src.data(), palette.colors, width, sampleSize);
+                });
+                compositeLine(actual.data(), src.data(), palette.colors, width, sampleSize);
+                ASSERT_EQ(expected, actual) << "width " << width << " sampleSize " << sampleSize;
+            }
+        }
+    }
+
+    TEST_P(CompositorTest, CompositeLine565MatchesScalar) {
+        const Palette palette = makePalette(mRandom);
+        for (int width = 1; width <= MAX_WIDTH; width++) {
+            for (int sampleSize : SAMPLE_SIZES) {
+                const std::vector<uint8_t> src = randomBytes(mRandom, (size_t) width * sampleSize);
+                std::vector<Color565> expected(width + GUARD);
+                for (size_t i = 0; i < expected.size(); i++) {
+                    expected[i] = (Color565) mRandom();
+                }
+                std::vector<Color565> actual = expected;
+                runScalar([&] {
+                    compositeLine565(expected.data(), src.data(), palette.colors,
+                                     palette.colors565, width, sampleSize);
+                });
+                compositeLine565(actual.data(), src.data(), palette.colors, palette.colors565,
+                                 width, sampleSize);
+                ASSERT_EQ(expected, actual) << "width " << width << " sampleSize " << sampleSize;
+            }
+        }
+    }
+
+    TEST_P(CompositorTest, CompositeLineA8MatchesScalar) {
+        const Palette palette = makePalette(mRandom);
+        for (int width = 1; width <= MAX_WIDTH; width++) {
+            for (int sampleSize : SAMPLE_SIZES) {
+                const std::vector<uint8_t> src = randomBytes(mRandom, (size_t) width * sampleSize);
+                std::vector<uint8_t> expected = randomBytes(mRandom, width + GUARD);
+                std::vector<uint8_t> actual = expected;
+                runScalar([&] {
+                    compositeLineA8(expected.data(), src.data(), palette.colors, width, sampleSize);
+                });
+                compositeLineA8(actual.data(), src.data(), palette.colors, width, sampleSize);
+                ASSERT_EQ(expected, actual) << "width " << width << " sampleSize " << sampleSize;
+            }
+        }
+    }
+
+    TEST_P(CompositorTest, CompositeBoxLineMatchesScalar) {
+        const Palette palette = makePalette(mRandom);
+        for (int srcWidth = 1; srcWidth <= MAX_WIDTH; srcWidth++) {
+            for (int sampleSize : SAMPLE_SIZES) {
+                // 最后一行块和最后一列块可能不完整
+                const int width = (srcWidth + sampleSize - 1) / sampleSize;
+                const int rows = 1 + (int) (mRandom() % sampleSize);
+                const std::vector<uint8_t> src = randomBytes(mRandom, (size_t) srcWidth * rows);
+                std::vector<uint32_t> sums((size_t) srcWidth * 4);
+                std::vector<Color8888> expected(width + GUARD);
+                for (size_t i = 0; i < expected.size(); i++) {
+                    expected[i] = randomPremultiplied(mRandom);
+                }
+                std::vector<Color8888> actual = expected;
+                runScalar([&] {
+                    compositeBoxLine(expected.data(), src.data(), srcWidth, rows, palette.colors,
+                                     width, srcWidth, sampleSize, sums.data());
+                });
+                compositeBoxLine(actual.data(), src.data(), srcWidth, rows, palette.colors,
+                                 width, srcWidth, sampleSize, sums.data());
+                ASSERT_EQ(expected, actual) << "srcWidth " << srcWidth << " sampleSize "
+                                            << sampleSize << " rows " << rows;
+            }
+        }
+    }
+
+    TEST_P(CompositorTest, ScaleLineMatchesScalar) {
+        for (int width = 1; width <= MAX_WIDTH; width++) {
+            // 1 到 4 个抽头有专门的实现, 更多时走通用路径
+            for (int taps = 1; taps <= 6; taps++) {
+                const int srcWidth = width + taps;
+                std::vector<Color8888> src(srcWidth);
+                for (int i = 0; i < srcWidth; i++) {
+                    src[i] = randomPremultiplied(mRandom);
+                }
+                std::vector<int> starts(width);
+                for (int x = 0; x < width; x++) {
+                    starts[x] = (int) (mRandom() % (srcWidth - taps + 1));
+                }
+                const std::vector<int16_t> weights = randomWeights(mRandom, taps, width);
+                std::vector<Color8888> expected(width + GUARD, 0x12345678);
+                std::vector<Color8888> actual = expected;
+                runScalar([&] {
+                    scaleLine(expected.data(), src.data(), starts.data(), weights.data(), taps,
+                              width);
+                });
+                scaleLine(actual.data(), src.data(), starts.data(), weights.data(), taps, width);
+                ASSERT_EQ(expected, actual) << "width " << width << " taps " << taps;
+            }
+        }
+    }
+
+    TEST_P(CompositorTest, BlendLinesMatchesScalar) {
+        for (int width = 1; width <= MAX_WIDTH; width++) {
+            for (int taps = 1; taps <= 6; taps++) {
+                std::vector<std::vector<Color8888>> lines(taps, std::vector<Color8888>(width));
+                std::vector<const Color8888 *> rows(taps);
+                for (int t = 0; t < taps; t++) {
+                    for (int x = 0; x < width; x++) {
+                        lines[t][x] = randomPremultiplied(mRandom);
+                    }
+                    rows[t] = lines[t].data();
+                }
+                // 同一行的所有像素使用同一组权重
+                const std::vector<int16_t> weights = randomWeights(mRandom, taps, 1);
+                std::vector<Color8888> expected(width + GUARD, 0x12345678);
+                std::vector<Color8888> actual = expected;
+                runScalar([&] {
+                    blendLines(expected.data(), rows.data(), weights.data(), taps, width);
+                });
+                blendLines(actual.data(), rows.data(), weights.data(), taps, width);
+                ASSERT_EQ(expected, actual) << "width " << width << " taps " << taps;
+            }
+        }
+    }
+
+    TEST_P(CompositorTest, FillLineMatchesScalar) {
+        for (int width = 1; width <= MAX_WIDTH; width++) {
+            const Color8888 color = (Color8888) mRandom();
+            std::vector<Color8888> expected(width + GUARD, 0x12345678);
+            std::vector<Color8888> actual = expected;
+            runScalar([&] {
+                fillLine(expected.data(), color, width);
+            });
+            fillLine(actual.data(), color, width);
+            ASSERT_EQ(expected, actual) << "width " << width;
+        }
+    }
+
+    INSTANTIATE_TEST_SUITE_P(Kernels, CompositorTest,
+                             ::testing::Values(COMPOSITE_SSE41, COMPOSITE_AVX2, COMPOSITE_NEON));
+
+}
@@ -0,0 +1,172 @@
+/**
+ * 预取取出的帧与顺序播放 drawFrame 的结果相同, 渐进解码时预取线程不读取数据源.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <gtest/gtest.h>
+#include "TestGifs.h"
+
+namespace {
+
+    // 与 JavaInputStream 相同, 只能在创建它的线程上读取, 其他线程读到的是数据结束
+    class ThreadBoundStream : public Stream {
+    public:
+        explicit ThreadBoundStream(const std::vector<uint8_t> &data)
+                : mData(data), mThread(std::this_thread::get_id()) {}
+
+    protected:
+        size_t doRead(void *buffer, size_t size) override {
+            if (std::this_thread::get_id() != mThread) {
+                return 0;
+            }
+            size = std::min(size, mData.size() - mOffset);
+            memcpy(buffer, mData.data() + mOffset, size);
+            mOffset += size;
+            return size;
+        }
+
+    private:
+        const std::vector<uint8_t> &mData;
+        const std::thread::id mThread;
+        size_t mOffset = 0;
+    };
+
+    // 各种处置方式和透明色, 合成结果依赖之前的帧
+    std::vector<uint8_t> makeDisposalGif(int width, int height) {
+        const int disposals[] = {DISPOSE_DO_NOT, DISPOSE_BACKGROUND, DISPOSE_PREVIOUS,
+                                 DISPOSE_DO_NOT, DISPOSE_PREVIOUS, DISPOSE_BACKGROUND};
+        std::vector<TestFrame> frames;
+        for (int i = 0; i < 6; i++) {
+            const int left = i == 0 ? 0 : i % 3;
+            const int top = i == 0 ? 0 : i % 2;
+            const int frameWidth = width - left - (i % 2);
+            const int frameHeight = height - top;
+            std::vector<uint8_t> raster((size_t) frameWidth * frameHeight);
+            for (size_t p = 0; p < raster.size(); p++) {
+                raster[p] = (uint8_t) ((p * 7 + i * 3) % 8);
+            }
+            frames.push_back({left, top, frameWidth, frameHeight, i == 0 ? NO_TRANSPARENT_COLOR : 5,
+                              disposals[i], raster, i == 3});
+        }
+        return encodeTestGif(width, height, 8, 0, frames);
+    }
+
+    // 取出 count 帧, 没有合成好时 idle 之后重试; 返回每一帧的帧号和像素
+    template<typename Idle>
+    bool takeFrames(GifDecoder &decoder, int count, int width, int height,
+                    std::vector<int> *frameNrs, std::vector<Color8888> *pixels, Idle idle) {
+        std::vector<Color8888> frame((size_t) width * height);
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while ((int) frameNrs->size() < count) {
+            const int frameNr = decoder.takeNextFrame(frame.data(), PIXEL_FORMAT_8888, width,
+                                                      width, height, NULL);
+            if (frameNr < 0) {
+                if (std::chrono::steady_clock::now() > deadline) {
+                    return false;
+                }
+                idle();
+                continue;
+            }
+            frameNrs->push_back(frameNr);
+            pixels->insert(pixels->end(), frame.begin(), frame.end());
+        }
+        return true;
+    }
+
+    void sleepBriefly() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // 两轮播放: 按播放顺序循环, 回到第 0 帧时从头合成
+    TEST(FramePrefetcherTest, TakenFramesMatchSequentialPlayback) {
+        const int width = 9;
+        const int height = 7;
+        const std::vector<uint8_t> data = makeDisposalGif(width, height);
+        ASSERT_FALSE(data.empty());
+        for (const DecodeMode &mode : getDecodeModes()) {
+            std::unique_ptr<GifDecoder> reference(openTestDecoder(data, mode));
+            ASSERT_TRUE(reference->hasInit()) << mode.name;
+            const int frameCount = reference->getFrameCount();
+            const std::vector<Color8888> expected = drawAllFrames(*reference, 1);
+
+            std::unique_ptr<GifDecoder> decoder(openTestDecoder(data, mode));
+            PrefetchOptions options = {3, 0, PIXEL_FORMAT_8888, 1, 0, 0};
+            ASSERT_TRUE(decoder->startPrefetch(options)) << mode.name;
+            std::vector<int> frameNrs;
+            std::vector<Color8888> pixels;
+            ASSERT_TRUE(takeFrames(*decoder, 2 * frameCount, width, height, &frameNrs, &pixels,
+                                   sleepBriefly)) << mode.name;
+            decoder->stopPrefetch();
+            for (int i = 0; i < 2 * frameCount; i++) {
+                const int frameNr = i % frameCount;
+                ASSERT_EQ(frameNr, frameNrs[i]) << mode.name;
+                const size_t frameSize = (size_t) width * height;
+                EXPECT_TRUE(std::equal(&pixels[i * frameSize], &pixels[(i + 1) * frameSize],
+                                       &expected[frameNr * frameSize]))
+                                    << mode.name << " frame " << frameNr;
+            }
+        }
+    }
+
+    // 渐进解码时预取线程等待调用方读出的帧, 自己不读取, 只能在调用方线程读取的数据源也能播完
+    TEST(FramePrefetcherTest, ProgressiveWaitsForFramesReadByCaller) {
+        const int width = 9;
+        const int height = 7;
+        const std::vector<uint8_t> data = makeDisposalGif(width, height);
+        ASSERT_FALSE(data.empty());
+        std::unique_ptr<GifDecoder> reference(openTestDecoder(data, getDecodeModes()[0]));
+        const int frameCount = reference->getFrameCount();
+        const std::vector<Color8888> expected = drawAllFrames(*reference, 1);
+
+        DecodeOptions options;
+        options.progressive = true;
+        std::unique_ptr<GifDecoder> decoder(new GifDecoder(new ThreadBoundStream(data), options));
+        ASSERT_TRUE(decoder->hasInit());
+        ASSERT_FALSE(decoder->isComplete());
+        PrefetchOptions prefetch = {2, 0, PIXEL_FORMAT_8888, 1, 0, 0};
+        ASSERT_TRUE(decoder->startPrefetch(prefetch));
+        std::vector<int> frameNrs;
+        std::vector<Color8888> pixels;
+        // 先不读取: 预取线程合成完第 0 帧后需要第 1 帧, 只能等待
+        ASSERT_TRUE(takeFrames(*decoder, 1, width, height, &frameNrs, &pixels, sleepBriefly));
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ASSERT_FALSE(decoder->isComplete());
+        GifDecoder *progressive = decoder.get();
+        ASSERT_TRUE(takeFrames(*decoder, 2 * frameCount, width, height, &frameNrs, &pixels, [&] {
+            // 与 FrameSequenceDrawable 相同, 在自己的线程上继续读取
+            if (progressive->isComplete() || progressive->decodeMoreFrames(1) < 0) {
+                sleepBriefly();
+            }
+        }));
+        decoder->stopPrefetch();
+        // 读完时数据源已被释放
+        ASSERT_TRUE(decoder->isComplete());
+        EXPECT_EQ(frameCount, decoder->getFrameCount());
+        for (int i = 0; i < 2 * frameCount; i++) {
+            const int frameNr = i % frameCount;
+            ASSERT_EQ(frameNr, frameNrs[i]);
+            const size_t frameSize = (size_t) width * height;
+            EXPECT_TRUE(std::equal(&pixels[i * frameSize], &pixels[(i + 1) * frameSize],
+                                   &expected[frameNr * frameSize])) << "frame " << frameNr;
+        }
+    }
+
+    // 预取期间析构解码器
+    TEST(FramePrefetcherTest, DestroyWhilePrefetching) {
+        const std::vector<uint8_t> data = makeDisposalGif(9, 7);
+        ASSERT_FALSE(data.empty());
+        DecodeOptions options;
+        options.progressive = true;
+        std::unique_ptr<GifDecoder> decoder(new GifDecoder(new ThreadBoundStream(data), options));
+        PrefetchOptions prefetch = {2, 0, PIXEL_FORMAT_8888, 1, 0, 0};
+        ASSERT_TRUE(decoder->startPrefetch(prefetch));
+        // 预取线程在第 0 帧之后等待读取, 析构时停止等待
+        sleepBriefly();
+        decoder.reset();
+    }
+
+}
@@ -0,0 +1,451 @@
+/**
+ * GifDecoder 在各种打开方式下的合成结果, 以及透明度等逐帧信息.
+ */
+
+#include <algorithm>
+#include <memory>
+#include <gtest/gtest.h>
+#include "BenchCorpus.h"
+#include "FrameScaler.h"
+#include "TestGifs.h"
+
+namespace {
+
+    std::vector<uint8_t> filledRaster(int width, int height, uint8_t index) {
+        return std::vector<uint8_t>((size_t) width * height, index);
+    }
+
+    const int MIXED_WIDTH = 12;
+    const int MIXED_HEIGHT = 10;
+    const int MIXED_FRAME_COUNT = 9;
+
+    // 各种处置方式混合的 GIF: 第 4 帧为独立帧, 其余为局部帧, 含 DISPOSE_PREVIOUS 和 DISPOSE_BACKGROUND
+    std::vector<uint8_t> encodeMixedDisposalGif() {
+        std::vector<TestFrame> frames;
+        frames.push_back({0, 0, MIXED_WIDTH, MIXED_HEIGHT, NO_TRANSPARENT_COLOR, DISPOSE_DO_NOT,
+                          filledRaster(MIXED_WIDTH, MIXED_HEIGHT, 1), false});
+        frames.push_back({1, 1, 4, 3, NO_TRANSPARENT_COLOR, DISPOSE_PREVIOUS,
+                          filledRaster(4, 3, 2), false});
+        frames.push_back({6, 2, 3, 4, NO_TRANSPARENT_COLOR, DISPOSE_BACKGROUND,
+                          filledRaster(3, 4, 3), false});
+        std::vector<uint8_t> raster = filledRaster(5, 5, 2);
+        raster[6] = 0;
+        frames.push_back({4, 4, 5, 5, 0, DISPOSE_DO_NOT, raster, false});
+        // 覆盖整个画布的不透明帧为独立帧
+        frames.push_back({0, 0, MIXED_WIDTH, MIXED_HEIGHT, NO_TRANSPARENT_COLOR, DISPOSE_DO_NOT,
+                          filledRaster(MIXED_WIDTH, MIXED_HEIGHT, 3), false});
+        frames.push_back({2, 5, 3, 3, NO_TRANSPARENT_COLOR, DISPOSE_PREVIOUS,
+                          filledRaster(3, 3, 1), false});
+        frames.push_back({7, 1, 4, 4, NO_TRANSPARENT_COLOR, DISPOSE_PREVIOUS,
+                          filledRaster(4, 4, 2), false});
+        frames.push_back({8, 6, 3, 3, NO_TRANSPARENT_COLOR, DISPOSE_BACKGROUND,
+                          filledRaster(3, 3, 0), false});
+        frames.push_back({0, 8, 4, 2, NO_TRANSPARENT_COLOR, DISPOSE_DO_NOT,
+                          filledRaster(4, 2, 1), false});
+        return encodeTestGif(MIXED_WIDTH, MIXED_HEIGHT, 4, 0, frames);
+    }
+
+    class DecodeModeTest : public ::testing::TestWithParam<DecodeMode> {
+    };
+
+    // 第 0 帧的透明色与背景色索引相同时, 背景为透明, 第 0 帧没有覆盖的像素也透明
+    TEST_P(DecodeModeTest, TransparentBackgroundIndexStaysTransparent) {
+        const int width = 8;
+        const int height = 4;
+        const int background = 1;
+        std::vector<TestFrame> frames;
+        // 第 0 帧不覆盖最右一列, 且左上角使用透明色
+        std::vector<uint8_t> raster = filledRaster(width - 1, height, 0);
+        raster[0] = background;
+        frames.push_back({0, 0, width - 1, height, background, DISPOSE_DO_NOT, raster, false});
+        frames.push_back({2, 1, 2, 2, NO_TRANSPARENT_COLOR, DISPOSE_DO_NOT,
+                          filledRaster(2, 2, 2), false});
+        const std::vector<uint8_t> data = encodeTestGif(width, height, 4, background, frames);
+        ASSERT_FALSE(data.empty());
+
+        std::unique_ptr<GifDecoder> decoder(openTestDecoder(data, GetParam()));
+        ASSERT_TRUE(decoder->hasInit());
+        ASSERT_EQ(2, decoder->getFrameCount());
+        EXPECT_FALSE(decoder->isOpaque());
+        EXPECT_FALSE(decoder->isFrameOpaque(0));
+        EXPECT_FALSE(decoder->isFrameOpaque(1));
+        EXPECT_FALSE(decoder->isAnimationOpaque());
+
+        const std::vector<Color8888> pixels = drawAllFrames(*decoder, 1);
+        for (int frame = 0; frame < 2; frame++) {
+            const Color8888 *canvas = &pixels[(size_t) frame * width * height];
+            EXPECT_EQ(TRANSPARENT, canvas[0]) << "frame " << frame;
+            for (int y = 0; y < height; y++) {
+                EXPECT_EQ(TRANSPARENT, canvas[y * width + width - 1])
+                                    << "frame " << frame << " row " << y;
+            }
+            EXPECT_NE(TRANSPARENT, canvas[1]) << "frame " << frame;
+        }
+    }
+
+    // 越界索引保留之前的画布, 覆盖整个画布的不透明帧含有越界索引时不是独立帧, 跳帧与顺序播放相同
+    TEST_P(DecodeModeTest, OutOfRangeIndicesKeepPreviousCanvasWhenSeeking) {
+        const int width = 8;
+        const int height = 6;
+        std::vector<TestFrame> frames;
+        frames.push_back({0, 0, width, height, NO_TRANSPARENT_COLOR, DISPOSE_DO_NOT,
+                          filledRaster(width, height, 1), false});
+        frames.push_back({0, 0, width, height, NO_TRANSPARENT_COLOR, DISPOSE_DO_NOT,
+                          filledRaster(width, height, 2), false});
+        std::vector<uint8_t> raster = filledRaster(width, height, 3);
+        for (int x = 0; x < width; x++) {
+            raster[2 * width + x] = 200;
+        }
+        frames.push_back({0, 0, width, height, NO_TRANSPARENT_COLOR, DISPOSE_DO_NOT, raster,
+                          false});
+        // 覆盖整个画布的 DISPOSE_BACKGROUND 帧之后, 同样覆盖整个画布且含有越界索引的不透明帧:
+        // 顺序播放跳过上一帧的处置, 第 3 行保留第 3 帧的颜色
+        frames.push_back({0, 0, width, height, NO_TRANSPARENT_COLOR, DISPOSE_BACKGROUND,
+                          filledRaster(width, height, 1), false});
+        raster = filledRaster(width, height, 2);
+        for (int x = 0; x < width; x++) {
+            raster[3 * width + x] = 200;
+        }
+        frames.push_back({0, 0, width, height, NO_TRANSPARENT_COLOR, DISPOSE_DO_NOT, raster,
+                          false});
+        // 色表缩小为 4 色后 200 为越界索引
+        const std::vector<uint8_t> data = shrinkGlobalColorMap(
+                encodeTestGif(width, height, 256, 0, frames), 2);
+        ASSERT_FALSE(data.empty());
+
+        std::unique_ptr<GifDecoder> decoder(openTestDecoder(data, GetParam()));
+        ASSERT_TRUE(decoder->hasInit());
+        ASSERT_EQ(5, decoder->getFrameCount());
+        EXPECT_FALSE(decoder->isIndependentFrame(2));
+        EXPECT_FALSE(decoder->isIndependentFrame(4));
+
+        const std::vector<Color8888> sequential = drawAllFrames(*decoder, 1);
+        const size_t frameSize = (size_t) width * height;
+        // 第 2 帧的第 2 行保留第 1 帧的颜色, 第 4 帧的第 3 行保留第 3 帧的颜色
+        EXPECT_EQ(sequential[frameSize + 2 * width], sequential[2 * frameSize + 2 * width]);
+        EXPECT_EQ(sequential[3 * frameSize + 3 * width], sequential[4 * frameSize + 3 * width]);
+
+        for (int frameNr : {2, 4}) {
+            std::unique_ptr<GifDecoder> seeking(openTestDecoder(data, GetParam()));
+            std::vector<Color8888> canvas(frameSize, 0x12345678);
+            seeking->drawFrame(frameNr, canvas.data(), width, -1, 1);
+            EXPECT_TRUE(std::equal(canvas.begin(), canvas.end(), &sequential[frameNr * frameSize]))
+                                << "frame " << frameNr;
+        }
+    }
+
+    // 从任意之前的帧推进到第 n 帧: 结果与顺序播放相同, 改动过的像素都在 dirtyRect 之内.
+    // 覆盖独立帧、关键帧、DISPOSE_PREVIOUS 的恢复和双缓冲 (previousFrameNr = n - 2)
+    TEST_P(DecodeModeTest, DirtyRectCoversChangedPixels) {
+        const int width = MIXED_WIDTH;
+        const int height = MIXED_HEIGHT;
+        const std::vector<uint8_t> data = encodeMixedDisposalGif();
+        const int frameCount = MIXED_FRAME_COUNT;
+        ASSERT_FALSE(data.empty());
+
+        for (int sampleSize = 1; sampleSize <= 2; sampleSize++) {
+            std::unique_ptr<GifDecoder> reference(openTestDecoder(data, GetParam()));
+            ASSERT_TRUE(reference->hasInit());
+            ASSERT_EQ(frameCount, reference->getFrameCount());
+            EXPECT_TRUE(reference->isIndependentFrame(4));
+            const std::vector<Color8888> sequential = drawAllFrames(*reference, sampleSize);
+            const int canvasWidth = width / sampleSize;
+            const int canvasHeight = height / sampleSize;
+            const size_t frameSize = (size_t) canvasWidth * canvasHeight;
+
+            // 先顺序播放一遍, keyframes 模式下保存关键帧
+            std::unique_ptr<GifDecoder> decoder(openTestDecoder(data, GetParam()));
+            drawAllFrames(*decoder, sampleSize);
+            for (int frameNr = 0; frameNr < frameCount; frameNr++) {
+                for (int previous = -1; previous < frameNr; previous++) {
+                    std::vector<Color8888> canvas(frameSize, 0x12345678);
+                    if (previous >= 0) {
+                        std::copy(&sequential[previous * frameSize],
+                                  &sequential[(previous + 1) * frameSize], canvas.begin());
+                    }
+                    const std::vector<Color8888> before = canvas;
+                    DirtyRect rect;
+                    decoder->drawFrame(frameNr, canvas.data(), canvasWidth, previous, sampleSize,
+                                       &rect);
+                    ASSERT_TRUE(std::equal(canvas.begin(), canvas.end(),
+                                           &sequential[frameNr * frameSize]))
+                                        << "frame " << frameNr << " from " << previous
+                                        << " sampleSize " << sampleSize;
+                    for (int y = 0; y < canvasHeight; y++) {
+                        for (int x = 0; x < canvasWidth; x++) {
+                            const size_t p = (size_t) y * canvasWidth + x;
+                            if (before[p] != canvas[p]) {
+                                EXPECT_TRUE(x >= rect.left && x < rect.right
+                                            && y >= rect.top && y < rect.bottom)
+                                                    << "frame " << frameNr << " from " << previous
+                                                    << " sampleSize " << sampleSize
+                                                    << " pixel " << x << "," << y;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // drawScaledFrame 增量更新的输出与整帧 drawFrame 再完整缩放的结果相同: 顺序播放、
+    // 双缓冲 (previousFrameNr = n - 2, 需加上一次改动的区域) 以及倒退时从头合成
+    TEST_P(DecodeModeTest, ScaledFrameMatchesFullRescale) {
+        const std::vector<uint8_t> data = encodeMixedDisposalGif();
+        ASSERT_FALSE(data.empty());
+        // 9x7 以 inSampleSize 1 合成后缩放, 5x4 以 inSampleSize 2 合成后缩放
+        const int sizes[][3] = {{9, 7, 1}, {5, 4, 2}};
+        for (const auto &size : sizes) {
+            const int outputWidth = size[0];
+            const int outputHeight = size[1];
+            const int sampleSize = size[2];
+            const int canvasWidth = MIXED_WIDTH / sampleSize;
+            const int canvasHeight = MIXED_HEIGHT / sampleSize;
+            const size_t outputSize = (size_t) outputWidth * outputHeight;
+
+            std::unique_ptr<GifDecoder> reference(openTestDecoder(data, GetParam()));
+            ASSERT_TRUE(reference->hasInit());
+            const std::vector<Color8888> sequential = drawAllFrames(*reference, sampleSize);
+            FrameScaler scaler;
+            scaler.setSize(canvasWidth, canvasHeight, outputWidth, outputHeight);
+            std::vector<Color8888> expected(outputSize * MIXED_FRAME_COUNT);
+            for (int frame = 0; frame < MIXED_FRAME_COUNT; frame++) {
+                scaler.scale(&sequential[(size_t) frame * canvasWidth * canvasHeight],
+                             canvasWidth, &expected[frame * outputSize], PIXEL_FORMAT_8888,
+                             outputWidth, 0, 0, outputWidth, outputHeight);
+            }
+
+            // 双缓冲播放到最后一帧, 倒退到第 2 帧后继续双缓冲, 最后单缓冲顺序播放
+            std::vector<int> order;
+            for (int frame = 0; frame < MIXED_FRAME_COUNT; frame++) {
+                order.push_back(frame);
+            }
+            for (int frame = 2; frame < MIXED_FRAME_COUNT; frame++) {
+                order.push_back(frame);
+            }
+            std::unique_ptr<GifDecoder> decoder(openTestDecoder(data, GetParam()));
+            std::vector<Color8888> buffers[2] = {
+                    std::vector<Color8888>(outputSize, 0x12345678),
+                    std::vector<Color8888>(outputSize, 0x12345678)};
+            int held[2] = {-1, -1};
+            for (size_t step = 0; step < order.size() + MIXED_FRAME_COUNT; step++) {
+                const bool doubleBuffered = step < order.size();
+                const int frameNr = doubleBuffered ? order[step]
+                                                   : (int) (step - order.size());
+                const int target = doubleBuffered ? (int) (step % 2) : 0;
+                std::vector<Color8888> &output = buffers[target];
+                const std::vector<Color8888> before = output;
+                DirtyRect rect;
+                decoder->drawScaledFrame(frameNr, output.data(), outputWidth, outputWidth,
+                                         outputHeight, held[target], &rect);
+                held[target] = frameNr;
+                ASSERT_TRUE(std::equal(output.begin(), output.end(),
+                                       &expected[frameNr * outputSize]))
+                                    << "step " << step << " frame " << frameNr << " size "
+                                    << outputWidth << "x" << outputHeight;
+                for (int y = 0; y < outputHeight; y++) {
+                    for (int x = 0; x < outputWidth; x++) {
+                        const size_t p = (size_t) y * outputWidth + x;
+                        if (before[p] != output[p]) {
+                            EXPECT_TRUE(x >= rect.left && x < rect.right
+                                        && y >= rect.top && y < rect.bottom)
+                                                << "step " << step << " pixel " << x << "," << y;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // 按 format 合成的画布是否等于 ARGB_8888 画布的转换
+    ::testing::AssertionResult matchesConverted(const std::vector<uint8_t> &canvas,
+                                                PixelFormat format, const Color8888 *expected,
+                                                size_t pixelCount) {
+        for (size_t p = 0; p < pixelCount; p++) {
+            const uint32_t actual = format == PIXEL_FORMAT_565
+                                    ? ((const Color565 *) canvas.data())[p] : canvas[p];
+            const uint32_t converted = format == PIXEL_FORMAT_565
+                                       ? color8888To565(expected[p]) : expected[p] >> 24;
+            if (actual != converted) {
+                return ::testing::AssertionFailure() << "format " << format << " pixel " << p
+                                                     << ": " << actual << " != " << converted;
+            }
+        }
+        return ::testing::AssertionSuccess();
+    }
+
+    // RGB_565 和 ALPHA_8 的合成结果等于 ARGB_8888 结果的转换. 同一解码器交替使用格式时
+    // 保留缓冲和关键帧按格式区分; 开启块平均时经过 unpackLine/packLine
+    TEST_P(DecodeModeTest, FormatsMatchConverted8888) {
+        const std::vector<uint8_t> data = encodeMixedDisposalGif();
+        ASSERT_FALSE(data.empty());
+        const PixelFormat formats[] = {PIXEL_FORMAT_565, PIXEL_FORMAT_A8};
+        for (bool boxFilter : {false, true}) {
+            DecodeMode mode = GetParam();
+            mode.options.boxFilter = boxFilter;
+            for (int sampleSize = 1; sampleSize <= 2; sampleSize++) {
+                const int canvasWidth = MIXED_WIDTH / sampleSize;
+                const size_t frameSize = (size_t) canvasWidth * (MIXED_HEIGHT / sampleSize);
+                std::unique_ptr<GifDecoder> decoder(openTestDecoder(data, mode));
+                ASSERT_TRUE(decoder->hasInit());
+                // keyframes 模式下保存 ARGB_8888 的关键帧
+                const std::vector<Color8888> sequential = drawAllFrames(*decoder, sampleSize);
+
+                // 每种格式先从头合成每一帧, 不能恢复其他格式的关键帧; 再顺序播放
+                for (PixelFormat format : formats) {
+                    std::vector<uint8_t> canvas(frameSize * getBytesPerPixel(format));
+                    for (int pass = 0; pass < 2; pass++) {
+                        for (int frameNr = 0; frameNr < MIXED_FRAME_COUNT; frameNr++) {
+                            decoder->drawFrame(frameNr, canvas.data(), format, canvasWidth,
+                                               pass == 0 ? -1 : frameNr - 1, sampleSize);
+                            ASSERT_TRUE(matchesConverted(canvas, format,
+                                                         &sequential[frameNr * frameSize],
+                                                         frameSize))
+                                                << "frame " << frameNr << " pass " << pass
+                                                << " boxFilter " << boxFilter
+                                                << " sampleSize " << sampleSize;
+                        }
+                    }
+                }
+
+                // 三种格式逐帧交替顺序播放, 每次恢复时保留缓冲都是其他格式保存的
+                std::vector<Color8888> canvas8888(frameSize);
+                std::vector<uint8_t> canvases[2];
+                for (int f = 0; f < 2; f++) {
+                    canvases[f].resize(frameSize * getBytesPerPixel(formats[f]));
+                }
+                for (int frameNr = 0; frameNr < MIXED_FRAME_COUNT; frameNr++) {
+                    decoder->drawFrame(frameNr, canvas8888.data(), canvasWidth, frameNr - 1,
+                                       sampleSize);
+                    ASSERT_TRUE(std::equal(canvas8888.begin(), canvas8888.end(),
+                                           &sequential[frameNr * frameSize]))
+                                        << "frame " << frameNr << " boxFilter " << boxFilter
+                                        << " sampleSize " << sampleSize;
+                    for (int f = 0; f < 2; f++) {
+                        decoder->drawFrame(frameNr, canvases[f].data(), formats[f], canvasWidth,
+                                           frameNr - 1, sampleSize);
+                        ASSERT_TRUE(matchesConverted(canvases[f], formats[f],
+                                                     &sequential[frameNr * frameSize], frameSize))
+                                            << "interleaved frame " << frameNr
+                                            << " boxFilter " << boxFilter
+                                            << " sampleSize " << sampleSize;
+                    }
+                }
+            }
+        }
+    }
+
+    // 所有打开方式顺序播放的结果与默认的完整解压相同
+    TEST_P(DecodeModeTest, MatchesDecodedOnCorpus) {
+        for (const CorpusSpec &spec : getCorpusSpecs()) {
+            const CorpusEntry entry = generateCorpusEntry(spec);
+            ASSERT_FALSE(entry.data.empty()) << spec.name;
+            std::unique_ptr<GifDecoder> reference(
+                    openTestDecoder(entry.data, getDecodeModes()[0]));
+            std::unique_ptr<GifDecoder> decoder(openTestDecoder(entry.data, GetParam()));
+            ASSERT_TRUE(decoder->hasInit()) << spec.name;
+            ASSERT_EQ(reference->getFrameCount(), decoder->getFrameCount()) << spec.name;
+            for (int sampleSize = 1; sampleSize <= 3; sampleSize += 2) {
+                EXPECT_TRUE(drawAllFrames(*reference, sampleSize)
+                            == drawAllFrames(*decoder, sampleSize))
+                                    << spec.name << " sampleSize " << sampleSize;
+            }
+            for (int i = 0; i < decoder->getFrameCount(); i++) {
+                EXPECT_EQ(reference->isFrameOpaque(i), decoder->isFrameOpaque(i))
+                                    << spec.name << " frame " << i;
+                // 语料的索引都在色表之内, 没有解压的帧按 LZW 码长同样可以确认
+                EXPECT_EQ(reference->isIndependentFrame(i), decoder->isIndependentFrame(i))
+                                    << spec.name << " frame " << i;
+            }
+        }
+    }
+
+    // 预算足够完整解压时, 透明度与不设预算时一样按像素判断
+    TEST(GifDecoderTest, BudgetDecodedFramesUsePixelOpacity) {
+        const int width = 6;
+        const int height = 5;
+        std::vector<TestFrame> frames;
+        // 声明了透明色但没有使用
+        frames.push_back({0, 0, width, height, 3, DISPOSE_DO_NOT,
+                          filledRaster(width, height, 1), false});
+        const std::vector<uint8_t> data = encodeTestGif(width, height, 4, 0, frames);
+        ASSERT_FALSE(data.empty());
+
+        DecodeMode decoded = getDecodeModes()[0];
+        DecodeMode budget = decoded;
+        budget.options.memoryBudgetBytes = 64 * 1024 * 1024;
+        for (const DecodeMode &mode : {decoded, budget}) {
+            std::unique_ptr<GifDecoder> decoder(openTestDecoder(data, mode));
+            ASSERT_TRUE(decoder->hasInit()) << mode.name;
+            EXPECT_TRUE(decoder->isFrameOpaque(0)) << mode.name;
+            EXPECT_TRUE(decoder->isAnimationOpaque()) << mode.name;
+        }
+    }
+
+    // keyframeCacheBytes 为负值时与 0 相同, 不保存关键帧, 跳帧结果不变
+    TEST(GifDecoderTest, NegativeKeyframeCacheKeepsNoKeyframes) {
+        const int width = 8;
+        const int height = 8;
+        std::vector<TestFrame> frames;
+        frames.push_back({0, 0, width, height, NO_TRANSPARENT_COLOR, DISPOSE_DO_NOT,
+                          filledRaster(width, height, 0), false});
+        // 每帧只改动一个像素, 都不是独立帧
+        for (int i = 1; i < 8; i++) {
+            frames.push_back({i, i, 1, 1, NO_TRANSPARENT_COLOR, DISPOSE_DO_NOT,
+                              filledRaster(1, 1, (uint8_t) (i % 4)), false});
+        }
+        const std::vector<uint8_t> data = encodeTestGif(width, height, 4, 0, frames);
+        ASSERT_FALSE(data.empty());
+
+        DecodeMode mode = getDecodeModes()[0];
+        mode.options.keyframeInterval = 2;
+        mode.options.keyframeCacheBytes = -1;
+        std::unique_ptr<GifDecoder> decoder(openTestDecoder(data, mode));
+        ASSERT_TRUE(decoder->hasInit());
+        const std::vector<Color8888> sequential = drawAllFrames(*decoder, 1);
+        EXPECT_EQ(0u, decoder->getMemoryUsage().keyframes);
+
+        const size_t frameSize = (size_t) width * height;
+        std::vector<Color8888> canvas(frameSize);
+        decoder->drawFrame(7, canvas.data(), width, -1, 1);
+        EXPECT_EQ(0u, decoder->getMemoryUsage().keyframes);
+        EXPECT_TRUE(std::equal(canvas.begin(), canvas.end(), &sequential[7 * frameSize]));
+    }
+
+    // 交错帧经由同一块中间缓冲解压, 完整解压之后归还, 不再计入内存占用
+    TEST(GifDecoderTest, InterlacedScratchReleasedAfterDecode) {
+        const int width = 9;
+        const int height = 11;
+        std::vector<TestFrame> frames;
+        for (int i = 0; i < 3; i++) {
+            std::vector<uint8_t> raster((size_t) width * height);
+            for (size_t p = 0; p < raster.size(); p++) {
+                raster[p] = (uint8_t) ((p / width + i) % 4);
+            }
+            frames.push_back({0, 0, width, height - i, NO_TRANSPARENT_COLOR, DISPOSE_DO_NOT,
+                              raster, true});
+        }
+        const std::vector<uint8_t> data = encodeTestGif(width, height, 4, 0, frames);
+        ASSERT_FALSE(data.empty());
+
+        std::unique_ptr<GifDecoder> decoder(openTestDecoder(data, getDecodeModes()[0]));
+        ASSERT_TRUE(decoder->hasInit());
+        const size_t frameBytes = (size_t) width * (height + height - 1 + height - 2);
+        EXPECT_EQ(frameBytes, decoder->getMemoryUsage().rasters);
+
+        const std::vector<Color8888> pixels = drawAllFrames(*decoder, 1);
+        for (int frame = 0; frame < 3; frame++) {
+            for (int y = 0; y < height - frame; y++) {
+                const Color8888 *row = &pixels[((size_t) frame * height + y) * width];
+                EXPECT_EQ(row[0], pixels[(size_t) ((y + frame) % 4) * width])
+                                    << "frame " << frame << " row " << y;
+            }
+        }
+    }
+
+    INSTANTIATE_TEST_SUITE_P(Modes, DecodeModeTest, ::testing::ValuesIn(getDecodeModes()),
+                             [](const ::testing::TestParamInfo<DecodeMode> &info) {
+                                 return info.param.name;
+                             });
+
+}
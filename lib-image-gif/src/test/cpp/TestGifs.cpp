@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <string.h>
+#include "TestGifs.h"
+
+namespace {
+
+    // 析构时关闭文件, progressive 模式下由解码器释放
+    class ClosingFileStream : public FileStream {
+    public:
+        explicit ClosingFileStream(FILE *file) : FileStream(file), mFile(file) {}
+
+        ~ClosingFileStream() override {
+            fclose(mFile);
+        }
+
+    private:
+        FILE *mFile;
+    };
+
+    int writeToVector(GifFileType *gif, const GifByteType *buffer, int size) {
+        std::vector<uint8_t> *out = (std::vector<uint8_t> *) gif->UserData;
+        out->insert(out->end(), buffer, buffer + size);
+        return size;
+    }
+
+    bool writeFrames(GifFileType *gif, int width, int height, int colorCount,
+                     int backgroundColor, const std::vector<TestFrame> &frames) {
+        GifColorType colors[256];
+        for (int i = 0; i < colorCount; i++) {
+            colors[i].Red = (GifByteType) (i * 37 + 11);
+            colors[i].Green = (GifByteType) (i * 59 + 23);
+            colors[i].Blue = (GifByteType) (i * 83 + 47);
+        }
+        ColorMapObject *colorMap = GifMakeMapObject(colorCount, colors);
+        if (!colorMap) {
+            return false;
+        }
+        bool ok = EGifPutScreenDesc(gif, width, height, colorMap->BitsPerPixel,
+                                    backgroundColor, colorMap) != GIF_ERROR;
+        GifFreeMapObject(colorMap);
+
+        for (size_t i = 0; ok && i < frames.size(); i++) {
+            const TestFrame &frame = frames[i];
+            GraphicsControlBlock gcb;
+            gcb.DisposalMode = frame.disposalMode;
+            gcb.UserInputFlag = false;
+            gcb.DelayTime = 5;
+            gcb.TransparentColor = frame.transparentColor;
+            GifByteType extension[4];
+            size_t extensionLength = EGifGCBToExtension(&gcb, extension);
+            ok = EGifPutExtension(gif, GRAPHICS_EXT_FUNC_CODE, (int) extensionLength,
+                                  extension) != GIF_ERROR
+                 && EGifPutImageDesc(gif, frame.left, frame.top, frame.width, frame.height,
+                                     frame.interlaced, NULL) != GIF_ERROR;
+            std::vector<GifPixelType> line((size_t) frame.width);
+            // 交错图像按 giflib 的写入顺序逐行输出
+            static const int kStarts[] = {0, 4, 2, 1};
+            static const int kSteps[] = {8, 8, 4, 2};
+            const int passes = frame.interlaced ? 4 : 1;
+            for (int pass = 0; ok && pass < passes; pass++) {
+                const int step = frame.interlaced ? kSteps[pass] : 1;
+                for (int y = frame.interlaced ? kStarts[pass] : 0; ok && y < frame.height;
+                     y += step) {
+                    memcpy(line.data(), &frame.raster[(size_t) y * frame.width], line.size());
+                    ok = EGifPutLine(gif, line.data(), frame.width) != GIF_ERROR;
+                }
+            }
+        }
+        return ok;
+    }
+
+}
+
+std::vector<uint8_t> encodeTestGif(int width, int height, int colorCount, int backgroundColor,
+                                   const std::vector<TestFrame> &frames) {
+    std::vector<uint8_t> data;
+    int error;
+    GifFileType *gif = EGifOpen(&data, writeToVector, &error);
+    if (!gif) {
+        return std::vector<uint8_t>();
+    }
+    bool ok = writeFrames(gif, width, height, colorCount, backgroundColor, frames);
+    if (EGifCloseFile(gif, &error) == GIF_ERROR || !ok) {
+        data.clear();
+    }
+    return data;
+}
+
+std::vector<uint8_t> shrinkGlobalColorMap(const std::vector<uint8_t> &data, int bits) {
+    // 6 字节签名 + 7 字节逻辑屏幕描述, 之后是全局色表; packed 字段的低 3 位为色表大小
+    const size_t screenEnd = 13;
+    if (data.size() < screenEnd + 256 * 3 || (data[10] & 0x87) != 0x87) {
+        return std::vector<uint8_t>();
+    }
+    std::vector<uint8_t> shrunk(data.begin(), data.begin() + screenEnd);
+    shrunk[10] = (uint8_t) ((data[10] & ~0x07) | (bits - 1));
+    shrunk.insert(shrunk.end(), data.begin() + screenEnd,
+                  data.begin() + screenEnd + (3 << bits));
+    shrunk.insert(shrunk.end(), data.begin() + screenEnd + 256 * 3, data.end());
+    return shrunk;
+}
+
+const std::vector<DecodeMode> &getDecodeModes() {
+    static const std::vector<DecodeMode> modes = [] {
+        std::vector<DecodeMode> result;
+        DecodeOptions options;
+        result.push_back({"decoded", options, false});
+        result.push_back({"decoded_file", options, true});
+        DecodeOptions classic;
+        classic.lzwEngine = GIF_LZW_CLASSIC;
+        result.push_back({"classic_lzw", classic, false});
+        DecodeOptions noArena;
+        noArena.arena = false;
+        result.push_back({"no_arena", noArena, false});
+        DecodeOptions lazy;
+        lazy.lazyDecode = true;
+        result.push_back({"lazy", lazy, false});
+        DecodeOptions lazyCache = lazy;
+        lazyCache.rasterCacheSize = 3;
+        result.push_back({"lazy_cache", lazyCache, true});
+        DecodeOptions lazyDirect = lazy;
+        lazyDirect.directComposite = true;
+        result.push_back({"lazy_direct", lazyDirect, false});
+        DecodeOptions compressed;
+        compressed.compressedFrames = true;
+        result.push_back({"compressed", compressed, false});
+        DecodeOptions compressedDirect = compressed;
+        compressedDirect.directComposite = true;
+        result.push_back({"compressed_direct", compressedDirect, true});
+        DecodeOptions keyframes;
+        keyframes.keyframeInterval = 3;
+        result.push_back({"keyframes", keyframes, false});
+        DecodeOptions progressive;
+        progressive.progressive = true;
+        result.push_back({"progressive", progressive, false});
+        result.push_back({"progressive_file", progressive, true});
+        DecodeOptions budget;
+        budget.memoryBudgetBytes = 1;
+        result.push_back({"budget", budget, false});
+        DecodeOptions budgetDecoded;
+        budgetDecoded.memoryBudgetBytes = 64 * 1024 * 1024;
+        result.push_back({"budget_decoded", budgetDecoded, false});
+        DecodeOptions threads;
+        threads.decodeThreads = 3;
+        threads.compositeThreads = 3;
+        result.push_back({"threads", threads, false});
+        result.push_back({"threads_file", threads, true});
+        return result;
+    }();
+    return modes;
+}
+
+GifDecoder *openTestDecoder(const std::vector<uint8_t> &data, const DecodeMode &mode,
+                            bool readAll) {
+    void *buffer = (void *) data.data();
+    Stream *stream;
+    if (mode.fileStream) {
+        stream = new ClosingFileStream(fmemopen(buffer, data.size(), "rb"));
+    } else {
+        stream = new MemoryStream(buffer, data.size(), NULL);
+    }
+    GifDecoder *decoder = new GifDecoder(stream, mode.options);
+    if (!mode.options.progressive) {
+        // progressive 模式下由解码器释放 stream
+        delete stream;
+    }
+    while (readAll && decoder->hasInit() && !decoder->isComplete()) {
+        if (decoder->decodeMoreFrames(4) < 0) {
+            break;
+        }
+    }
+    return decoder;
+}
+
+std::vector<Color8888> drawAllFrames(GifDecoder &decoder, int inSampleSize) {
+    const int width = decoder.getWidth() / inSampleSize;
+    const int height = decoder.getHeight() / inSampleSize;
+    std::vector<Color8888> canvas((size_t) width * height);
+    std::vector<Color8888> result;
+    for (int i = 0; i < decoder.getFrameCount(); i++) {
+        decoder.drawFrame(i, canvas.data(), width, i - 1, inSampleSize);
+        result.insert(result.end(), canvas.begin(), canvas.end());
+    }
+    return result;
+}
@@ -0,0 +1,66 @@
+/**
+ * 测试用的 GIF 构造和解码辅助: 按帧描述由 egif_lib 编码, 以各种 DecodeOptions 组合打开并逐帧合成.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "GifDecoder.h"
+
+// 一帧的描述, raster 为 width x height 个索引像素
+struct TestFrame {
+    int left;
+    int top;
+    int width;
+    int height;
+    // NO_TRANSPARENT_COLOR 表示没有透明色
+    int transparentColor;
+    int disposalMode;
+    std::vector<uint8_t> raster;
+    bool interlaced;
+};
+
+/**
+ * 编码一个 GIF, 全局色表为 colorCount 种不透明颜色; 失败时返回空
+ * @param colorCount 2 的幂, 1 到 256
+ */
+std::vector<uint8_t> encodeTestGif(int width, int height, int colorCount, int backgroundColor,
+                                   const std::vector<TestFrame> &frames);
+
+/**
+ * 将全局色表缩小到 2^bits 项, 保留图像数据的 LZW 码长; 之后大于色表的索引即为越界索引
+ * @param data encodeTestGif 的结果, 原色表为 256 项
+ */
+std::vector<uint8_t> shrinkGlobalColorMap(const std::vector<uint8_t> &data, int bits);
+
+// 一种打开方式: DecodeOptions 以及数据源
+struct DecodeMode {
+    std::string name;
+    DecodeOptions options;
+    // 以 FileStream 代替 MemoryStream 打开, 数据源不在内存中
+    bool fileStream;
+};
+
+// 测试失败时 GoogleTest 输出打开方式的名称
+inline void PrintTo(const DecodeMode &mode, std::ostream *os) {
+    *os << mode.name;
+}
+
+// 覆盖各条解码路径的打开方式, 第一项为默认的完整解压
+const std::vector<DecodeMode> &getDecodeModes();
+
+/**
+ * 以 mode 打开 data; data 在解码器析构之前需保持有效
+ * @param readAll progressive 模式下是否读完所有帧, 否则只有打开时读出的第一帧
+ */
+GifDecoder *openTestDecoder(const std::vector<uint8_t> &data, const DecodeMode &mode,
+                            bool readAll = true);
+
+/**
+ * 从第 0 帧开始顺序合成所有帧, 每一帧的画布依次追加到结果中
+ * @return 每帧 (width / inSampleSize) x (height / inSampleSize) 个像素
+ */
+std::vector<Color8888> drawAllFrames(GifDecoder &decoder, int inSampleSize);